@@ -0,0 +1,103 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "rasterizer.h"
+#include "world.h"
+
+/**
+ * Render a field of (second argument, default 50) x 50 instances of one monkey polygon, seen from its edge, and report the average frame time.
+ * Every instance is a thing sharing the polygon with its own transformer; most of them are out of view, the others shrink with the distance.
+ * Frames are rendered with flat shading by both backends, without and with the scene BVH (SceneBuildBVH), then with the polygon BVH too,
+ * then with levels of detail (PolygonBuildLOD) drawn within one pixel of error.
+ */
+
+double _BenchmarkNow() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+int main(int argc, char *argv[]) {
+  const int w = 1000;
+  const int h = 1000;
+  const int frames = argc > 1 ? atoi(argv[1]) : 10;
+  const int n = argc > 2 ? atoi(argv[2]) : 50;
+
+  const Material material = (Material){V(0.8274, 0.2196, 0.1098), 1, 1, 1, 30, false};
+  Polygon *monkeyPolygon = PolygonReadSTL("models/monkey.stl");
+  if (monkeyPolygon == NULL) {
+    return 1;
+  }
+  PolygonCalculateVertexNormals(monkeyPolygon);
+
+  Transformer **transformers = (Transformer **)malloc(n * n * sizeof(Transformer *));
+  Thing **things = (Thing **)malloc(n * n * sizeof(Thing *));
+  Light light = LightCreatePointLight(V(1, 1, 1), V(1, 1, 1), V(10, 10, 10));
+  RenderStatistics statistics;
+  Scene *scene = SceneCreateEmpty();
+  SceneSetStatistics(scene, &statistics);
+  SceneAppendLight(scene, &light);
+  for (int i = 0; i < n * n; ++i) {
+    transformers[i] = TransformerCreate(V((i % n) * 3, 0, (i / n) * 3), V(0, RADIAN(i * 37 % 360), 0), V(1, 1, 1));
+    things[i] = ThingCreate(monkeyPolygon, transformers[i], &material);
+    SceneAppendThing(scene, things[i]);
+  }
+  // the center of projection is -eye, so the camera looks from (-5, 4, -5) towards (n, 0, n / 2)
+  Camera *camera = CameraPerspectiveProjection(V(5, -4, 5), V(-n, 0, -n * 0.5), V(0, 1, 0), w, h, 0.1, 1000, 60);
+  SceneSetCamera(scene, camera);
+  printf("%d instances of %" PRIu64 " triangles\n", n * n, monkeyPolygon->triangle);
+
+  Bitmap *bmp = BitmapNewImage(w, h);
+  ZBuffer *zbuffer = ZBufferCreate(w, h, Float32DepthFormat);
+  const char *bvhNames[] = {"", "scene BVH", "all BVHs", "LOD"};
+  for (int bvh = 0; bvh < 4; ++bvh) {
+    if (bvh == 1) {
+      const double start = _BenchmarkNow();
+      SceneBuildBVH(scene);
+      printf("scene BVH built in %.3f ms\n", _BenchmarkNow() - start);
+    } else if (bvh == 2) {
+      PolygonBuildBVH(monkeyPolygon);
+      SceneBuildBVH(scene);
+    } else if (bvh == 3) {
+      const double start = _BenchmarkNow();
+      PolygonBuildLOD(monkeyPolygon, 8, 0.5);
+      printf("levels of detail built in %.3f ms:", _BenchmarkNow() - start);
+      for (const Polygon *level = monkeyPolygon; level != NULL; level = level->lod) {
+        printf(" %" PRIu64 " (%.4f)", level->triangle, (double)level->lodError);
+      }
+      printf("\n");
+      SceneSetLODThreshold(scene, 1);
+    }
+    for (int tiled = 0; tiled < 2; ++tiled) {
+      SceneSetRenderBackend(scene, tiled ? TiledRenderBackend : SerialRenderBackend);
+      double elapsed = 0;
+      for (int i = 0; i < frames; ++i) {
+        BitmapClear(bmp, NULL);
+        ZBufferClear(zbuffer);
+        const double start = _BenchmarkNow();
+        SceneRender(scene, bmp, zbuffer, WorldRender, FlatShading, BlinnPhongReflectionModel);
+        elapsed += _BenchmarkNow() - start;
+      }
+      printf("%-6s %-9s %10.3f ms/frame\n", tiled ? "tiled" : "serial", bvhNames[bvh], elapsed / frames);
+    }
+    printf("things %" PRIu64 " (%" PRIu64 " culled, %" PRIu64 " occluded), triangles %" PRIu64 " (%" PRIu64 " simplified, %" PRIu64 " frustum culled, %" PRIu64
+           " back-face culled, %" PRIu64 " rasterized)\n",
+           statistics.things, statistics.thingsCulled, statistics.thingsOccluded, statistics.triangles, statistics.trianglesSimplified, statistics.trianglesFrustumCulled,
+           statistics.trianglesBackfaceCulled, statistics.trianglesRasterized);
+  }
+  ZBufferDestroy(zbuffer);
+  BitmapDestroy(bmp);
+
+  SceneDestroy(scene);
+  CameraDestroy(camera);
+  for (int i = 0; i < n * n; ++i) {
+    ThingDestroy(things[i]);
+    TransformerDestroy(transformers[i]);
+  }
+  free(things);
+  free(transformers);
+  PolygonDestroy(monkeyPolygon);
+  return 0;
+}
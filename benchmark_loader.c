@@ -0,0 +1,227 @@
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "polygon.h"
+
+/**
+ * Load the STL files of models/ and synthetic binary and ASCII files, and report the average load time and throughput.
+ * The synthetic files are a grid of (argument, default 1) million triangles, written to the working directory and removed afterwards.
+ * The binary files are also converted to the native mesh format, which PolygonReadMesh maps without parsing.
+ * The average cache miss ratio (ACMR) of every model is reported before and after vertex cache and vertex fetch optimization,
+ * and the vertex memory and largest errors of quantization.
+ * The BVH of every model is reported with its build time, size and the rate of random rays cast through it.
+ * ASCII files are parsed by all OpenMP threads, set OMP_NUM_THREADS to compare.
+ */
+
+double _BenchmarkNow() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+/**
+ * Write a grid of 2 * n * n triangles on a wavy surface
+ */
+bool _BenchmarkWriteGrid(const char *filename, uint32_t n, bool ascii) {
+  FILE *fp = fopen(filename, "wb");
+  if (fp == NULL) {
+    return false;
+  }
+  const uint32_t triangle = 2 * n * n;
+  if (ascii) {
+    fprintf(fp, "solid grid\n");
+  } else {
+    const char header[80] = "grid";
+    fwrite(header, sizeof(header), 1, fp);
+    fwrite(&triangle, sizeof(triangle), 1, fp);
+  }
+  for (uint32_t y = 0; y < n; ++y) {
+    for (uint32_t x = 0; x < n; ++x) {
+      float corners[4][3];
+      for (int i = 0; i < 4; ++i) {
+        corners[i][0] = (float)(x + (i & 1)) / n;
+        corners[i][1] = (float)(y + (i >> 1)) / n;
+        corners[i][2] = 0.05f * sinf(corners[i][0] * 20) * cosf(corners[i][1] * 20);
+      }
+      const int faces[2][3] = {{0, 1, 2}, {1, 3, 2}};
+      for (int face = 0; face < 2; ++face) {
+        STLTriangle t = {{0, 0, 1}, {{0}}, 0};
+        for (int vertexIndex = 0; vertexIndex < 3; ++vertexIndex) {
+          memcpy(t.vertexes[vertexIndex], corners[faces[face][vertexIndex]], sizeof(corners[0]));
+        }
+        if (ascii) {
+          fprintf(fp, "  facet normal %e %e %e\n    outer loop\n", t.surfaceNormal[0], t.surfaceNormal[1], t.surfaceNormal[2]);
+          for (int vertexIndex = 0; vertexIndex < 3; ++vertexIndex) {
+            fprintf(fp, "      vertex %e %e %e\n", t.vertexes[vertexIndex][0], t.vertexes[vertexIndex][1], t.vertexes[vertexIndex][2]);
+          }
+          fprintf(fp, "    endloop\n  endfacet\n");
+        } else {
+          fwrite(&t, sizeof(t), 1, fp);
+        }
+      }
+    }
+  }
+  if (ascii) {
+    fprintf(fp, "endsolid grid\n");
+  }
+  fclose(fp);
+  return true;
+}
+
+void _BenchmarkLoad(const char *filename, int runs, Polygon *(*read)(const char *)) {
+  FILE *fp = fopen(filename, "rb");
+  if (fp == NULL) {
+    fprintf(stderr, "can't open %s\n", filename);
+    return;
+  }
+  fseek(fp, 0, SEEK_END);
+  const long size = ftell(fp);
+  fclose(fp);
+
+  double elapsed = 0;
+  uint64_t triangle = 0, vertex = 0;
+  for (int i = 0; i < runs; ++i) {
+    const double start = _BenchmarkNow();
+    Polygon *polygon = read(filename);
+    elapsed += _BenchmarkNow() - start;
+    if (polygon == NULL) {
+      return;
+    }
+    triangle = polygon->triangle;
+    vertex = polygon->vertex;
+    PolygonDestroy(polygon);
+  }
+  printf("%-28s %10.2f MB %10" PRIu64 " triangles %10" PRIu64 " vertexes %10.3f ms %10.2f MB/s %8.2f Mtriangles/s\n", filename, size / 1e6, triangle, vertex, elapsed / runs,
+         size / 1e3 / (elapsed / runs), triangle / 1e3 / (elapsed / runs));
+}
+
+void _BenchmarkConvert(const char *filename, const char *meshName) {
+  Polygon *polygon = PolygonReadSTL(filename);
+  if (polygon == NULL) {
+    return;
+  }
+  const double start = _BenchmarkNow();
+  PolygonCalculateVertexNormals(polygon);
+  printf("%-28s vertex normals %.3f ms\n", filename, _BenchmarkNow() - start);
+  PolygonWriteMesh(polygon, meshName);
+  PolygonDestroy(polygon);
+}
+
+void _BenchmarkOptimize(const char *filename) {
+  Polygon *polygon = PolygonReadSTL(filename);
+  if (polygon == NULL) {
+    return;
+  }
+  const double before[2] = {PolygonVertexCacheMissRatio(polygon, 16), PolygonVertexCacheMissRatio(polygon, 32)};
+  const double start = _BenchmarkNow();
+  PolygonOptimizeVertexCache(polygon);
+  PolygonOptimizeVertexFetch(polygon);
+  const double elapsed = _BenchmarkNow() - start;
+  printf("%-28s ACMR (FIFO 16 / 32) %.3f / %.3f -> %.3f / %.3f, optimized in %.3f ms\n", filename, before[0], before[1], PolygonVertexCacheMissRatio(polygon, 16),
+         PolygonVertexCacheMissRatio(polygon, 32), elapsed);
+  PolygonDestroy(polygon);
+}
+
+void _BenchmarkQuantize(const char *filename) {
+  Polygon *polygon = PolygonReadSTL(filename);
+  if (polygon == NULL) {
+    return;
+  }
+  PolygonCalculateWeightedVertexNormals(polygon, AngleNormalWeighting);
+  const double triangleBytes = polygon->triangle * 3 * (sizeof(uint32_t) + sizeof(float));
+  const double before = polygon->vertex * 6 * sizeof(float), after = polygon->vertex * (3 * sizeof(uint16_t) + 2 * sizeof(int16_t));
+  Real positionError = 0, normalError = 0;
+  const double start = _BenchmarkNow();
+  PolygonQuantize(polygon, &positionError, &normalError);
+  const double elapsed = _BenchmarkNow() - start;
+  printf("%-28s quantized vertexes %.1f -> %.1f kB (%.2fx, %.2fx with triangles), position error %.3g (%.3g of the radius), normal error %.5f degrees, %.3f ms\n", filename, before / 1e3,
+         after / 1e3, before / after, (before + triangleBytes) / (after + triangleBytes), (double)positionError, (double)(positionError / polygon->boundingRadius),
+         (double)normalError * 180 / 3.14159265358979323846, elapsed);
+  PolygonDestroy(polygon);
+}
+
+/**
+ * Cast rays from a sphere twice as large as the bounding sphere through its inner half, return the elapsed ms
+ */
+double _BenchmarkRays(const Polygon *polygon, int rays, int *hits) {
+  const Real radius = polygon->boundingRadius;
+  *hits = 0;
+  srand(1);
+  const double start = _BenchmarkNow();
+  for (int i = 0; i < rays; ++i) {
+    Vector points[2];
+    for (int j = 0; j < 2; ++j) {
+      const Vector random = V((Real)rand() / RAND_MAX - 0.5, (Real)rand() / RAND_MAX - 0.5, (Real)rand() / RAND_MAX - 0.5);
+      points[j] = VectorAddition(polygon->boundingCenter, VectorScalarMultiplication(j == 0 ? VectorL2Normalization(random) : random, j == 0 ? 2 * radius : radius));
+    }
+    Real distance = REAL_MAX;
+    uint64_t triangleIndex;
+    *hits += PolygonRaycast(polygon, points[0], VectorSubtraction(points[1], points[0]), &distance, &triangleIndex);
+  }
+  return _BenchmarkNow() - start;
+}
+
+void _BenchmarkBVH(const char *filename) {
+  Polygon *polygon = PolygonReadSTL(filename);
+  if (polygon == NULL) {
+    return;
+  }
+  PolygonCalculateBoundingSphere(polygon);
+  const int rays = 100000;
+  int hits, bruteHits = 0;
+  const double bruteElapsed = polygon->triangle < 100000 ? _BenchmarkRays(polygon, rays, &bruteHits) : 0;
+  const double start = _BenchmarkNow();
+  PolygonBuildBVH(polygon);
+  const double elapsed = _BenchmarkNow() - start;
+  const double rayElapsed = _BenchmarkRays(polygon, rays, &hits);
+  const uint64_t bytes = BVHMemorySize(polygon->bvh);
+  printf("%-28s BVH %u nodes, depth %u, %.1f kB (%.1f bytes per triangle), built in %.3f ms, %.2f M rays/s (%d%% hit", filename, polygon->bvh->node, BVHDepth(polygon->bvh), bytes / 1e3,
+         (double)bytes / polygon->triangle, elapsed, rays / rayElapsed / 1e3, hits * 100 / rays);
+  if (bruteElapsed > 0) {
+    printf(", %.2f M rays/s without BVH", rays / bruteElapsed / 1e3);
+  }
+  printf(")\n");
+  PolygonDestroy(polygon);
+}
+
+int main(int argc, char *argv[]) {
+  const double millions = argc > 1 ? atof(argv[1]) : 1;
+  const char *models[] = {"models/ball.stl", "models/box.stl", "models/cone.stl", "models/cube.stl", "models/monkey.stl", "models/plane.stl"};
+  const char *meshName = "benchmark_loader.mesh";
+  for (size_t i = 0; i < sizeof(models) / sizeof(models[0]); ++i) {
+    _BenchmarkLoad(models[i], 100, PolygonReadSTL);
+  }
+  for (size_t i = 0; i < sizeof(models) / sizeof(models[0]); ++i) {
+    _BenchmarkOptimize(models[i]);
+  }
+  for (size_t i = 0; i < sizeof(models) / sizeof(models[0]); ++i) {
+    _BenchmarkQuantize(models[i]);
+  }
+  for (size_t i = 0; i < sizeof(models) / sizeof(models[0]); ++i) {
+    _BenchmarkBVH(models[i]);
+  }
+  _BenchmarkConvert(models[4], meshName);
+  _BenchmarkLoad(meshName, 100, PolygonReadMesh);
+
+  const uint32_t n = (uint32_t)ceil(sqrt(millions * 1e6 / 2));
+  const char *binaryName = "benchmark_loader_binary.stl";
+  const char *asciiName = "benchmark_loader_ascii.stl";
+  if (!_BenchmarkWriteGrid(binaryName, n, false) || !_BenchmarkWriteGrid(asciiName, n, true)) {
+    fprintf(stderr, "can't write synthetic files\n");
+    return 1;
+  }
+  _BenchmarkLoad(binaryName, 3, PolygonReadSTL);
+  _BenchmarkLoad(asciiName, 3, PolygonReadSTL);
+  _BenchmarkOptimize(binaryName);
+  _BenchmarkQuantize(binaryName);
+  _BenchmarkBVH(binaryName);
+  _BenchmarkConvert(binaryName, meshName);
+  _BenchmarkLoad(meshName, 3, PolygonReadMesh);
+  remove(meshName);
+  remove(asciiName);
+  remove(binaryName);
+  return 0;
+}
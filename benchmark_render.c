@@ -0,0 +1,168 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "rasterizer.h"
+#include "world.h"
+
+/**
+ * Render the scene of example_render_world with every shading type and report the average frame time.
+ * The close-up camera makes the frame fill-rate bound (few, large triangles).
+ * The inside camera is placed within the red monkey, so that many triangles cross the near plane.
+ * Every frame is rendered by the serial backend with each supported pixel kernel, then with the default kernel by the tiled backend (all OpenMP threads) and by both backends with depth prepass.
+ * Pixel rate is the number of visible pixels per second, overdraw is the number of shaded fragments per visible pixel. Culling statistics of the last frame are printed per camera.
+ * The second argument "bvh" builds the BVHs of the polygons and of the scene, which cull nodes of triangles instead of whole things.
+ * Build with -DRENDER_REAL=float|double|long_double to compare precisions.
+ */
+
+#if defined(RENDER_REAL_FLOAT)
+#define REAL_NAME "float"
+#elif defined(RENDER_REAL_DOUBLE)
+#define REAL_NAME "double"
+#else
+#define REAL_NAME "long double"
+#endif
+
+double _BenchmarkNow() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+int main(int argc, char *argv[]) {
+  const int w = 1000;
+  const int h = 1000;
+  const int frames = argc > 1 ? atoi(argv[1]) : 10;
+  const bool bvh = argc > 2 && strcmp(argv[2], "bvh") == 0;
+
+  printf("Real: %s (%zu bytes), Vector: %zu bytes, Triangle: %zu bytes\n", REAL_NAME, sizeof(Real), sizeof(Vector), sizeof(Triangle));
+
+  const Material monkeyRedMaterial = (Material){V(0.8274, 0.2196, 0.1098), 1, 1, 1, 30, false};
+  const Material monkeyPurpleMaterial = (Material){V(0.4156, 0.2039, 0.5333), 0.5, 0.5, 0.5, 60, false};
+  const Material ballMaterial = (Material){V(1, 1, 1), 1, 1, 1, 90, false};
+
+  Polygon *monkeyPolygon = PolygonReadSTL("models/monkey.stl");
+  Polygon *ballPolygon = PolygonReadSTL("models/ball.stl");
+  PolygonCalculateVertexNormals(monkeyPolygon);
+  PolygonCalculateVertexNormals(ballPolygon);
+
+  Transformer *monkeyRedPos = TransformerCreate(V(0, 0.5, -0.4), V(RADIAN(-45), RADIAN(45), 0), V(0.5, 0.5, 0.5));
+  Transformer *monkeyPurplePos = TransformerCreate(V(0, -0.5, 0.4), V(RADIAN(45), RADIAN(-45), 0), V(0.5, 0.5, 0.5));
+  Transformer *topBallPos = TransformerCreate(V(0, 0.5, 0.4), V(RADIAN(45), RADIAN(-45), 0), V(0.2, 0.2, 0.2));
+  Transformer *bottomBallPos = TransformerCreate(V(0, -0.5, -0.4), V(0, 0, 0), V(0.2, 0.2, 0.2));
+
+  Thing *monkeyRed = ThingCreate(monkeyPolygon, monkeyRedPos, &monkeyRedMaterial);
+  Thing *monkeyPurple = ThingCreate(monkeyPolygon, monkeyPurplePos, &monkeyPurpleMaterial);
+  Thing *topBall = ThingCreate(ballPolygon, topBallPos, &ballMaterial);
+  Thing *bottomBall = ThingCreate(ballPolygon, bottomBallPos, &ballMaterial);
+
+  Camera *cameras[] = {CameraPerspectiveProjection(V(2, 0, 0), V(0, 0, 0), V(0, 1, 0), w, h, 0.1, 1000, 60),
+                       CameraPerspectiveProjection(V(1.0, 0.55, -0.3), V(0, 0.5, -0.4), V(0, 1, 0), w, h, 0.1, 1000, 60),
+                       CameraPerspectiveProjection(V(-0.3, -0.45, 0.35), V(-1.3, -0.5, 0.33), V(0, 1, 0), w, h, 0.1, 1000, 60)};
+  const char *cameraNames[] = {"far", "close-up", "inside"};
+  Light light = LightCreatePointLight(V(1, 1, 1), V(1, 1, 1), V(10, 10, 10));
+
+  RenderStatistics statistics;
+  Scene *scene = SceneCreateEmpty();
+  SceneSetStatistics(scene, &statistics);
+  SceneAppendLight(scene, &light);
+  SceneAppendThing(scene, monkeyRed);
+  SceneAppendThing(scene, monkeyPurple);
+  SceneAppendThing(scene, topBall);
+  SceneAppendThing(scene, bottomBall);
+  if (bvh) {
+    const double start = _BenchmarkNow();
+    PolygonBuildBVH(monkeyPolygon);
+    PolygonBuildBVH(ballPolygon);
+    SceneBuildBVH(scene);
+    printf("BVH built in %.3f ms, %" PRIu64 " bytes\n", _BenchmarkNow() - start, BVHMemorySize(monkeyPolygon->bvh) + BVHMemorySize(ballPolygon->bvh) + BVHMemorySize(scene->bvh));
+  }
+
+  const char *shadingNames[] = {"NullShading", "FlatShading", "GouraudShading", "PhongShading"};
+  const ShadingType shadingTypes[] = {NullShading, FlatShading, GouraudShading, PhongShading};
+  const char *kernelNames[] = {"scalar", "sse4.1", "avx2"};
+  const RasterizerKernelType defaultKernel = RasterizerGetKernel();
+
+  // frame buffers are allocated once and cleared for every frame, compare with allocating them
+  Bitmap *bmp = BitmapNewImage(w, h);
+  ZBuffer *zbuffer = ZBufferCreate(w, h, Float32DepthFormat);
+  double clearElapsed = 0, createElapsed = 0;
+  for (int i = 0; i < frames; ++i) {
+    double start = _BenchmarkNow();
+    BitmapClear(bmp, NULL);
+    ZBufferClear(zbuffer);
+    clearElapsed += _BenchmarkNow() - start;
+
+    start = _BenchmarkNow();
+    Bitmap *newBmp = BitmapNewImage(w, h);
+    ZBuffer *newZBuffer = ZBufferCreate(w, h, Float32DepthFormat);
+    createElapsed += _BenchmarkNow() - start;
+    ZBufferDestroy(newZBuffer);
+    BitmapDestroy(newBmp);
+  }
+  printf("frame buffers: clear %.3f ms/frame, create %.3f ms/frame\n", clearElapsed / frames, createElapsed / frames);
+
+  for (int cameraIndex = 0; cameraIndex < 3; ++cameraIndex) {
+    SceneSetCamera(scene, cameras[cameraIndex]);
+    for (int shadingIndex = 0; shadingIndex < 4; ++shadingIndex) {
+      // serial backend with each kernel, then tiled backend and depth prepass with the default kernel
+      for (int variant = ScalarRasterizerKernel; variant <= AVX2RasterizerKernel + 3; ++variant) {
+        const bool tiled = variant == AVX2RasterizerKernel + 1 || variant == AVX2RasterizerKernel + 3;
+        const bool depthPrepass = variant > AVX2RasterizerKernel + 1;
+        const RasterizerKernelType kernel = variant > AVX2RasterizerKernel ? defaultKernel : (RasterizerKernelType)variant;
+        if (!RasterizerSetKernel(kernel)) {
+          continue;
+        }
+        SceneSetRenderBackend(scene, tiled ? TiledRenderBackend : SerialRenderBackend);
+        SceneSetDepthPrepass(scene, depthPrepass);
+        double elapsed = 0;
+        uint64_t pixels = 0, fragments = 0;
+        for (int i = 0; i < frames; ++i) {
+          BitmapClear(bmp, NULL);
+          ZBufferClear(zbuffer);
+
+          double start = _BenchmarkNow();
+          SceneRender(scene, bmp, zbuffer, WorldRender, shadingTypes[shadingIndex], BlinnPhongReflectionModel);
+          elapsed += _BenchmarkNow() - start;
+          fragments += statistics.fragmentsShaded;
+
+          for (uint16_t y = 0; y < h; ++y) {
+            for (uint16_t x = 0; x < w; ++x) {
+              pixels += ZBufferGetDepth(zbuffer, x, y) != REAL_MAX;
+            }
+          }
+        }
+        printf("%-8s %-16s %-6s %-6s %-7s %10.3f ms/frame %10.3f Mpixel/s %6.2f overdraw\n", cameraNames[cameraIndex], shadingNames[shadingIndex], tiled ? "tiled" : "serial",
+               kernelNames[kernel], depthPrepass ? "prepass" : "", elapsed / frames, pixels / elapsed / 1e3, (double)fragments / pixels);
+      }
+    }
+    printf("%-8s things %" PRIu64 " (%" PRIu64 " culled, %" PRIu64 " occluded), triangles %" PRIu64 " (%" PRIu64 " frustum culled, %" PRIu64 " back-face culled, %" PRIu64 " occluded, %" PRIu64
+           " split, %" PRIu64 " rasterized), vertexes shaded %" PRIu64 "\n",
+           cameraNames[cameraIndex], statistics.things, statistics.thingsCulled, statistics.thingsOccluded, statistics.triangles, statistics.trianglesFrustumCulled, statistics.trianglesBackfaceCulled,
+           statistics.trianglesOccluded, statistics.trianglesSplit, statistics.trianglesRasterized, statistics.vertexesShaded);
+  }
+  RasterizerSetKernel(defaultKernel);
+  ZBufferDestroy(zbuffer);
+  BitmapDestroy(bmp);
+
+  SceneDestroy(scene);
+  CameraDestroy(cameras[2]);
+  CameraDestroy(cameras[1]);
+  CameraDestroy(cameras[0]);
+
+  ThingDestroy(bottomBall);
+  ThingDestroy(topBall);
+  ThingDestroy(monkeyPurple);
+  ThingDestroy(monkeyRed);
+
+  TransformerDestroy(bottomBallPos);
+  TransformerDestroy(topBallPos);
+  TransformerDestroy(monkeyPurplePos);
+  TransformerDestroy(monkeyRedPos);
+
+  PolygonDestroy(ballPolygon);
+  PolygonDestroy(monkeyPolygon);
+
+  return 0;
+}
@@ -0,0 +1,122 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "rasterizer.h"
+#include "world.h"
+
+/**
+ * Render the scene of example_render_world into a z-buffer of each depth format and report its size, the average frame time and its precision.
+ * The distant camera looks at the scene from far away with a narrow field of view, so that the whole scene spans a tiny range of depth.
+ * Precision is measured against the RealDepthFormat render: the number of pixels whose color differs (wrong visible surface) and the maximum depth error.
+ * Only float32 formats use the SIMD depth test (with -DRENDER_REAL=float), unorm formats always run the scalar one.
+ */
+
+double _BenchmarkNow() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+int main(int argc, char *argv[]) {
+  const int w = 1000;
+  const int h = 1000;
+  const int frames = argc > 1 ? atoi(argv[1]) : 10;
+
+  const Material monkeyRedMaterial = (Material){V(0.8274, 0.2196, 0.1098), 1, 1, 1, 30, false};
+  const Material monkeyPurpleMaterial = (Material){V(0.4156, 0.2039, 0.5333), 0.5, 0.5, 0.5, 60, false};
+  const Material ballMaterial = (Material){V(1, 1, 1), 1, 1, 1, 90, false};
+
+  Polygon *monkeyPolygon = PolygonReadSTL("models/monkey.stl");
+  Polygon *ballPolygon = PolygonReadSTL("models/ball.stl");
+  PolygonCalculateVertexNormals(monkeyPolygon);
+  PolygonCalculateVertexNormals(ballPolygon);
+
+  Transformer *monkeyRedPos = TransformerCreate(V(0, 0.5, -0.4), V(RADIAN(-45), RADIAN(45), 0), V(0.5, 0.5, 0.5));
+  Transformer *monkeyPurplePos = TransformerCreate(V(0, -0.5, 0.4), V(RADIAN(45), RADIAN(-45), 0), V(0.5, 0.5, 0.5));
+  Transformer *topBallPos = TransformerCreate(V(0, 0.5, 0.4), V(RADIAN(45), RADIAN(-45), 0), V(0.2, 0.2, 0.2));
+  Transformer *bottomBallPos = TransformerCreate(V(0, -0.5, -0.4), V(0, 0, 0), V(0.2, 0.2, 0.2));
+
+  Thing *monkeyRed = ThingCreate(monkeyPolygon, monkeyRedPos, &monkeyRedMaterial);
+  Thing *monkeyPurple = ThingCreate(monkeyPolygon, monkeyPurplePos, &monkeyPurpleMaterial);
+  Thing *topBall = ThingCreate(ballPolygon, topBallPos, &ballMaterial);
+  Thing *bottomBall = ThingCreate(ballPolygon, bottomBallPos, &ballMaterial);
+
+  Camera *cameras[] = {CameraPerspectiveProjection(V(2, 0, 0), V(0, 0, 0), V(0, 1, 0), w, h, 0.1, 1000, 60),
+                       CameraPerspectiveProjection(V(60, 0, 0), V(0, 0, 0), V(0, 1, 0), w, h, 0.1, 1000, 2.2)};
+  const char *cameraNames[] = {"far", "distant"};
+  Light light = LightCreatePointLight(V(1, 1, 1), V(1, 1, 1), V(10, 10, 10));
+
+  Scene *scene = SceneCreateEmpty();
+  SceneAppendLight(scene, &light);
+  SceneAppendThing(scene, monkeyRed);
+  SceneAppendThing(scene, monkeyPurple);
+  SceneAppendThing(scene, topBall);
+  SceneAppendThing(scene, bottomBall);
+
+  const char *formatNames[] = {"real", "float32", "unorm24", "unorm16", "reversed float32"};
+
+  for (int cameraIndex = 0; cameraIndex < 2; ++cameraIndex) {
+    SceneSetCamera(scene, cameras[cameraIndex]);
+    Bitmap *reference = BitmapNewImage(w, h);
+    ZBuffer *referenceZBuffer = ZBufferCreate(w, h, RealDepthFormat);
+    SceneRender(scene, reference, referenceZBuffer, WorldRender, FlatShading, BlinnPhongReflectionModel);
+
+    for (DepthFormat format = RealDepthFormat; format <= ReversedFloat32DepthFormat; ++format) {
+      double elapsed = 0;
+      uint64_t wrongPixels = 0;
+      Real maxDepthError = 0;
+      for (int i = 0; i < frames; ++i) {
+        Bitmap *bmp = BitmapNewImage(w, h);
+        ZBuffer *zbuffer = ZBufferCreate(w, h, format);
+
+        double start = _BenchmarkNow();
+        SceneRender(scene, bmp, zbuffer, WorldRender, FlatShading, BlinnPhongReflectionModel);
+        elapsed += _BenchmarkNow() - start;
+
+        if (i == 0) {
+          for (uint16_t y = 0; y < h; ++y) {
+            for (uint16_t x = 0; x < w; ++x) {
+              RGBTRIPLE color, referenceColor;
+              BitmapGetPixelColor(bmp, x, y, &color);
+              BitmapGetPixelColor(reference, x, y, &referenceColor);
+              wrongPixels += memcmp(&color, &referenceColor, sizeof(RGBTRIPLE)) != 0;
+              const Real depth = ZBufferGetDepth(zbuffer, x, y), referenceDepth = ZBufferGetDepth(referenceZBuffer, x, y);
+              if (depth != REAL_MAX && referenceDepth != REAL_MAX) {
+                maxDepthError = FMAX(maxDepthError, FABS(depth - referenceDepth));
+              }
+            }
+          }
+        }
+        ZBufferDestroy(zbuffer);
+        BitmapDestroy(bmp);
+      }
+      const uint32_t depthSize = ZBufferDepthSize(format);
+      printf("%-8s %-17s %2u bytes/pixel %6.2f MB %10.3f ms/frame %8lu wrong pixels %12.3e max depth error\n", cameraNames[cameraIndex], formatNames[format], depthSize,
+             (double)depthSize * w * h / (1 << 20), elapsed / frames, (unsigned long)wrongPixels, (double)maxDepthError);
+    }
+    ZBufferDestroy(referenceZBuffer);
+    BitmapDestroy(reference);
+  }
+
+  SceneDestroy(scene);
+  CameraDestroy(cameras[1]);
+  CameraDestroy(cameras[0]);
+
+  ThingDestroy(bottomBall);
+  ThingDestroy(topBall);
+  ThingDestroy(monkeyPurple);
+  ThingDestroy(monkeyRed);
+
+  TransformerDestroy(bottomBallPos);
+  TransformerDestroy(topBallPos);
+  TransformerDestroy(monkeyPurplePos);
+  TransformerDestroy(monkeyRedPos);
+
+  PolygonDestroy(ballPolygon);
+  PolygonDestroy(monkeyPolygon);
+
+  return 0;
+}
@@ -1,8 +1,17 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "bitmap.h"
 
+/**
+ * Index into the tiled pixels of the pixel at column x of row (counted from the bottom, as in the file)
+ */
+uint32_t _BitmapPixelIndex(const Bitmap *bitmap, uint16_t x, uint16_t row) {
+  const uint32_t tile = x / BITMAP_TILE_SIZE + (uint32_t)bitmap->tileColumns * (row / BITMAP_TILE_SIZE);
+  return tile * BITMAP_TILE_SIZE * BITMAP_TILE_SIZE + row % BITMAP_TILE_SIZE * BITMAP_TILE_SIZE + x % BITMAP_TILE_SIZE;
+}
+
 Bitmap *BitmapNewImage(uint16_t width, uint16_t height) {
   Bitmap *bitmap;
 
@@ -18,7 +27,9 @@ Bitmap *BitmapNewImage(uint16_t width, uint16_t height) {
 
   bitmap->fileHeader = (BITMAPFILEHEADER){BMP_MAGIC, headerSize + size, 0, 0, headerSize};
   bitmap->dibHeader = (BITMAPCOREHEADER){12, width, height, 1, 24};
-  bitmap->pixels = (RGBTRIPLE *)calloc(1, size);
+  bitmap->tileColumns = (width + BITMAP_TILE_SIZE - 1) / BITMAP_TILE_SIZE;
+  const uint32_t tileRows = (height + BITMAP_TILE_SIZE - 1) / BITMAP_TILE_SIZE;
+  bitmap->pixels = (RGBTRIPLE *)calloc((size_t)bitmap->tileColumns * tileRows * BITMAP_TILE_SIZE * BITMAP_TILE_SIZE + 1, sizeof(RGBTRIPLE));
 
   return bitmap;
 }
@@ -35,15 +46,61 @@ bool BitmapDestroy(Bitmap *bitmap) {
   return true; // TODO: implement error handler
 }
 
+/**
+ * Fill every pixel with color (black if NULL) in place, so that a sequence of frames can reuse one bitmap
+ */
+bool BitmapClear(Bitmap *bitmap, const RGBTRIPLE *color) {
+  if (bitmap == NULL) {
+#ifndef NDEBUG
+    fprintf(stderr, "%s: trying to clear null pointer, ignored.\n", __FUNCTION_NAME__);
+#endif
+    return false;
+  }
+  const uint32_t tileRows = (bitmap->dibHeader.bcHeight + BITMAP_TILE_SIZE - 1) / BITMAP_TILE_SIZE;
+  const size_t count = (size_t)bitmap->tileColumns * tileRows * BITMAP_TILE_SIZE * BITMAP_TILE_SIZE;
+  if (color == NULL || (color->rgbtBlue == color->rgbtGreen && color->rgbtGreen == color->rgbtRed)) {
+    memset(bitmap->pixels, color == NULL ? 0 : color->rgbtBlue, count * sizeof(RGBTRIPLE));
+    return true;
+  }
+  bitmap->pixels[0] = *color;
+  _FillRepeat(bitmap->pixels, sizeof(RGBTRIPLE), count);
+  return true;
+}
+
+/**
+ * Write the BMP file, resolving the tiles into bottom-up rows padded to 4 bytes
+ */
 bool BitmapWriteFile(const Bitmap *bitmap, const char *filename) {
   FILE *fp = fopen(filename, "w+");
   fwrite(&bitmap->fileHeader, sizeof(BITMAPFILEHEADER), 1, fp);
   fwrite(&bitmap->dibHeader, sizeof(BITMAPCOREHEADER), 1, fp);
-  fwrite(bitmap->pixels, bitmap->fileHeader.bfSize - bitmap->fileHeader.bfOffBits, 1, fp);
+  const uint16_t width = bitmap->dibHeader.bcWidth, height = bitmap->dibHeader.bcHeight;
+  const uint32_t rowSize = height > 0 ? (bitmap->fileHeader.bfSize - bitmap->fileHeader.bfOffBits) / height : 0;
+  uint8_t *rowBytes = (uint8_t *)calloc(rowSize + 1, 1);
+  for (uint16_t row = 0; row < height; ++row) {
+    RGBTRIPLE *resolved = (RGBTRIPLE *)rowBytes;
+    for (uint16_t x = 0; x < width; x += BITMAP_TILE_SIZE) {
+      const uint16_t columns = width - x < BITMAP_TILE_SIZE ? width - x : BITMAP_TILE_SIZE;
+      memcpy(&resolved[x], &bitmap->pixels[_BitmapPixelIndex(bitmap, x, row)], columns * sizeof(RGBTRIPLE));
+    }
+    fwrite(rowBytes, rowSize, 1, fp);
+  }
+  free(rowBytes);
   fclose(fp);
   return true; // TODO: implement error handler
 }
 
+bool BitmapGetPixelColor(const Bitmap *bitmap, uint16_t x, uint16_t y, RGBTRIPLE *color) {
+  if (bitmap->dibHeader.bcWidth <= x || bitmap->dibHeader.bcHeight <= y) {
+#ifndef NDEBUG
+    fprintf(stderr, "%s: Invalid pixel indices (x:%d<%d, y:%d<%d)\n", __FUNCTION_NAME__, x, bitmap->dibHeader.bcWidth, y, bitmap->dibHeader.bcHeight);
+#endif
+    return false;
+  }
+  *color = bitmap->pixels[_BitmapPixelIndex(bitmap, x, bitmap->dibHeader.bcHeight - y - 1)];
+  return true;
+}
+
 bool BitmapSetPixelColor(Bitmap *bitmap, uint16_t x, uint16_t y, const RGBTRIPLE *color) {
   if (bitmap->dibHeader.bcWidth <= x || bitmap->dibHeader.bcHeight <= y) {
 #ifndef NDEBUG
@@ -51,6 +108,6 @@ bool BitmapSetPixelColor(Bitmap *bitmap, uint16_t x, uint16_t y, const RGBTRIPLE
 #endif
     return false;
   }
-  bitmap->pixels[x + bitmap->dibHeader.bcWidth * (bitmap->dibHeader.bcHeight - y - 1)] = *color;
+  bitmap->pixels[_BitmapPixelIndex(bitmap, x, bitmap->dibHeader.bcHeight - y - 1)] = *color;
   return true;
 }
@@ -4,6 +4,7 @@
 #include "common.h"
 
 #define BMP_MAGIC 0x4d42
+#define BITMAP_TILE_SIZE 8 // pixels are stored in tiles of BITMAP_TILE_SIZE x BITMAP_TILE_SIZE, the block size of the rasterizer
 #define BMP_COLOR(r, g, b)                                                                                                                                                                             \
   &(RGBTRIPLE) { b, g, r }
 #define BMP_GRAY_SCALE(v)                                                                                                                                                                              \
@@ -34,15 +35,23 @@ typedef struct tagRGBTRIPLE {
 } RGBTRIPLE;
 #pragma pack(pop)
 
+/*
+ * Pixels are not stored in file order: the image is split into BITMAP_TILE_SIZE x BITMAP_TILE_SIZE tiles stored one after another (row-major, bottom-up),
+ * each holding its pixels row by row. A block of the rasterizer then touches a few contiguous cache lines instead of one line per row.
+ * BitmapWriteFile resolves the tiles into the bottom-up padded rows of the BMP file, use BitmapGetPixelColor / BitmapSetPixelColor to access pixels.
+ */
 typedef struct tagBitmap {
   BITMAPFILEHEADER fileHeader;
   BITMAPCOREHEADER dibHeader;
-  RGBTRIPLE *pixels; // bottom-up
+  uint16_t tileColumns; // tiles per row of tiles
+  RGBTRIPLE *pixels;    // tiled, see above
 } Bitmap;
 
 Bitmap *BitmapNewImage(uint16_t width, uint16_t height);
 bool BitmapDestroy(Bitmap *bitmap);
+bool BitmapClear(Bitmap *bitmap, const RGBTRIPLE *color);
 bool BitmapWriteFile(const Bitmap *bitmap, const char *filename);
+bool BitmapGetPixelColor(const Bitmap *bitmap, uint16_t x, uint16_t y, RGBTRIPLE *color);
 bool BitmapSetPixelColor(Bitmap *bitmap, uint16_t x, uint16_t y, const RGBTRIPLE *color);
 
 #endif // RENDER_BITMAP_H
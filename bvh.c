@@ -0,0 +1,449 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "bvh.h"
+
+#define BVH_PARALLEL_MINIMUM 65536 // primitives of a node binned by all threads
+#define BVH_MEDIAN_DEPTH (BVH_STACK_SIZE / 2 - 1) // deeper nodes are split in halves, which keeps the depth below BVH_STACK_SIZE
+
+typedef struct tagBVHBin {
+  float min[3];
+  float max[3];
+  uint32_t count;
+} BVHBin;
+
+typedef struct tagBVHTask {
+  uint32_t node;
+  uint32_t first;
+  uint32_t count;
+  uint32_t depth;
+} BVHTask;
+
+FORCE_INLINE void _BVHBinReset(BVHBin *bin) {
+  for (int axis = 0; axis < 3; ++axis) {
+    bin->min[axis] = FLT_MAX;
+    bin->max[axis] = -FLT_MAX;
+  }
+  bin->count = 0;
+}
+
+FORCE_INLINE void _BVHBinGrow(BVHBin *bin, const float *min, const float *max) {
+  for (int axis = 0; axis < 3; ++axis) {
+    bin->min[axis] = min[axis] < bin->min[axis] ? min[axis] : bin->min[axis];
+    bin->max[axis] = max[axis] > bin->max[axis] ? max[axis] : bin->max[axis];
+  }
+}
+
+FORCE_INLINE float _BVHBinArea(const BVHBin *bin) {
+  if (bin->count == 0) {
+    return 0;
+  }
+  const float x = bin->max[0] - bin->min[0], y = bin->max[1] - bin->min[1], z = bin->max[2] - bin->min[2];
+  return x * y + y * z + z * x;
+}
+
+FORCE_INLINE uint32_t _BVHBinIndex(float centroid, float min, float binScale) {
+  const uint32_t index = (uint32_t)((centroid - min) * binScale);
+  return index < BVH_BINS ? index : BVH_BINS - 1;
+}
+
+/**
+ * Grow bounds by the boxes and centroidBounds by the centroids of primitives[first, last)
+ */
+FORCE_INLINE void _BVHBoundsSlice(const float *boxes, const float *centroids, const uint32_t *primitives, int64_t first, int64_t last, BVHBin *bounds, BVHBin *centroidBounds) {
+  for (int64_t i = first; i < last; ++i) {
+    const uint32_t primitive = primitives[i];
+    _BVHBinGrow(bounds, &boxes[primitive * 6], &boxes[primitive * 6 + 3]);
+    _BVHBinGrow(centroidBounds, &centroids[primitive * 3], &centroids[primitive * 3]);
+  }
+}
+
+/**
+ * Box of the primitives (bounds) and box of their centroids (centroidBounds) in range, min and max merge in any order so the result does not depend on the threads.
+ * Small ranges stay out of OpenMP, whose parallel regions cost more than binning a few primitives even when they are not forked.
+ */
+void _BVHRangeBounds(const float *boxes, const float *centroids, const uint32_t *primitives, uint32_t count, BVHBin *bounds, BVHBin *centroidBounds) {
+  _BVHBinReset(bounds);
+  _BVHBinReset(centroidBounds);
+  bounds->count = centroidBounds->count = count;
+#ifdef _OPENMP
+  if (count > BVH_PARALLEL_MINIMUM) {
+#pragma omp parallel
+    {
+      const int64_t threads = omp_get_num_threads(), thread = omp_get_thread_num();
+      BVHBin local, localCentroids;
+      _BVHBinReset(&local);
+      _BVHBinReset(&localCentroids);
+      _BVHBoundsSlice(boxes, centroids, primitives, count * thread / threads, count * (thread + 1) / threads, &local, &localCentroids);
+#pragma omp critical
+      {
+        _BVHBinGrow(bounds, local.min, local.max);
+        _BVHBinGrow(centroidBounds, localCentroids.min, localCentroids.max);
+      }
+    }
+    return;
+  }
+#endif
+  _BVHBoundsSlice(boxes, centroids, primitives, 0, count, bounds, centroidBounds);
+}
+
+/**
+ * Bin primitives[first, last) along every axis by their centroids
+ */
+FORCE_INLINE void _BVHBinSlice(const float *boxes, const float *centroids, const uint32_t *primitives, int64_t first, int64_t last, const BVHBin *centroidBounds, const float binScales[3],
+                               BVHBin bins[3][BVH_BINS]) {
+  for (int axis = 0; axis < 3; ++axis) {
+    for (int binIndex = 0; binIndex < BVH_BINS; ++binIndex) {
+      _BVHBinReset(&bins[axis][binIndex]);
+    }
+  }
+  for (int64_t i = first; i < last; ++i) {
+    const uint32_t primitive = primitives[i];
+    for (int axis = 0; axis < 3; ++axis) {
+      BVHBin *bin = &bins[axis][_BVHBinIndex(centroids[primitive * 3 + axis], centroidBounds->min[axis], binScales[axis])];
+      _BVHBinGrow(bin, &boxes[primitive * 6], &boxes[primitive * 6 + 3]);
+      ++bin->count;
+    }
+  }
+}
+
+/**
+ * Bin the primitives in range along every axis by their centroids
+ */
+void _BVHBinRange(const float *boxes, const float *centroids, const uint32_t *primitives, uint32_t count, const BVHBin *centroidBounds, BVHBin bins[3][BVH_BINS]) {
+  float binScales[3];
+  for (int axis = 0; axis < 3; ++axis) {
+    const float extent = centroidBounds->max[axis] - centroidBounds->min[axis];
+    binScales[axis] = extent > 0 ? BVH_BINS / extent : 0;
+  }
+#ifdef _OPENMP
+  if (count > BVH_PARALLEL_MINIMUM) {
+    for (int axis = 0; axis < 3; ++axis) {
+      for (int binIndex = 0; binIndex < BVH_BINS; ++binIndex) {
+        _BVHBinReset(&bins[axis][binIndex]);
+      }
+    }
+#pragma omp parallel
+    {
+      const int64_t threads = omp_get_num_threads(), thread = omp_get_thread_num();
+      BVHBin local[3][BVH_BINS];
+      _BVHBinSlice(boxes, centroids, primitives, count * thread / threads, count * (thread + 1) / threads, centroidBounds, binScales, local);
+#pragma omp critical
+      for (int axis = 0; axis < 3; ++axis) {
+        for (int binIndex = 0; binIndex < BVH_BINS; ++binIndex) {
+          _BVHBinGrow(&bins[axis][binIndex], local[axis][binIndex].min, local[axis][binIndex].max);
+          bins[axis][binIndex].count += local[axis][binIndex].count;
+        }
+      }
+    }
+    return;
+  }
+#endif
+  _BVHBinSlice(boxes, centroids, primitives, 0, count, centroidBounds, binScales, bins);
+}
+
+/**
+ * Find the cheapest split by SAH among the bin borders.
+ * @return false if the node should be a leaf
+ */
+bool _BVHFindSplit(const BVHBin bins[3][BVH_BINS], const BVHBin *bounds, const BVHBin *centroidBounds, int *splitAxis, uint32_t *splitBin) {
+  float bestCost = FLT_MAX;
+  for (int axis = 0; axis < 3; ++axis) {
+    if (!(centroidBounds->max[axis] > centroidBounds->min[axis])) {
+      continue;
+    }
+    // areas and counts left of each border, then sweep from the right
+    float leftCosts[BVH_BINS - 1];
+    BVHBin left;
+    _BVHBinReset(&left);
+    for (uint32_t border = 0; border < BVH_BINS - 1; ++border) {
+      _BVHBinGrow(&left, bins[axis][border].min, bins[axis][border].max);
+      left.count += bins[axis][border].count;
+      leftCosts[border] = _BVHBinArea(&left) * left.count;
+    }
+    BVHBin right;
+    _BVHBinReset(&right);
+    for (uint32_t border = BVH_BINS - 1; border > 0; --border) {
+      _BVHBinGrow(&right, bins[axis][border].min, bins[axis][border].max);
+      right.count += bins[axis][border].count;
+      const float cost = leftCosts[border - 1] + _BVHBinArea(&right) * right.count;
+      if (right.count > 0 && right.count < bounds->count && cost < bestCost) {
+        bestCost = cost;
+        *splitAxis = axis;
+        *splitBin = border;
+      }
+    }
+  }
+  if (bestCost == FLT_MAX) {
+    return false;
+  }
+  // a traversal step costs about one primitive test
+  const float area = _BVHBinArea(bounds);
+  return bounds->count > BVH_MAX_LEAF_SIZE || (area > 0 && 1 + bestCost / area < bounds->count);
+}
+
+/**
+ * Build a BVH over count primitives given by their boxes (min x, y, z then max x, y, z of each primitive).
+ * Nodes are split at the cheapest border of BVH_BINS bins of centroids per axis, or kept as leaves when that is cheaper and they hold at most BVH_MAX_LEAF_SIZE primitives.
+ * Nodes with many primitives are bounded and binned by all threads; the tree only depends on the boxes.
+ * @param boxes
+ * @param count
+ * @return
+ */
+BVH *BVHCreate(const float *boxes, uint32_t count) {
+  BVH *bvh = (BVH *)calloc(1, sizeof(BVH));
+  if (bvh == NULL) {
+    fprintf(stderr, "%s: failed to allocate memory\n", __FUNCTION_NAME__);
+    return NULL;
+  }
+  const uint32_t capacity = count > 0 ? 2 * count - 1 : 1;
+  bvh->nodes = (BVHNode *)malloc(capacity * sizeof(BVHNode));
+  bvh->primitives = (uint32_t *)malloc((count > 0 ? count : 1) * sizeof(uint32_t));
+  float *centroids = (float *)malloc((count > 0 ? count : 1) * 3 * sizeof(float));
+  if (bvh->nodes == NULL || bvh->primitives == NULL || centroids == NULL) {
+    fprintf(stderr, "%s: failed to allocate memory for %u primitives\n", __FUNCTION_NAME__, count);
+    free(centroids);
+    BVHDestroy(bvh);
+    return NULL;
+  }
+  bvh->primitive = count;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) if (count > BVH_PARALLEL_MINIMUM)
+#endif
+  for (int64_t i = 0; i < (int64_t)count; ++i) {
+    bvh->primitives[i] = (uint32_t)i;
+    for (int axis = 0; axis < 3; ++axis) {
+      centroids[i * 3 + axis] = boxes[i * 6 + axis] * 0.5f + boxes[i * 6 + 3 + axis] * 0.5f;
+    }
+  }
+
+  BVHTask stack[BVH_STACK_SIZE];
+  uint32_t stackSize = 0;
+  stack[stackSize++] = (BVHTask){0, 0, count, 0};
+  bvh->node = 1;
+  while (stackSize > 0) {
+    const BVHTask task = stack[--stackSize];
+    uint32_t *primitives = &bvh->primitives[task.first];
+    BVHBin bounds, centroidBounds;
+    _BVHRangeBounds(boxes, centroids, primitives, task.count, &bounds, &centroidBounds);
+    BVHNode *node = &bvh->nodes[task.node];
+    memcpy(node->min, bounds.min, sizeof(node->min));
+    memcpy(node->max, bounds.max, sizeof(node->max));
+    node->first = task.first;
+    node->count = task.count;
+    if (task.count <= 1) {
+      continue;
+    }
+
+    uint32_t leftCount = task.count / 2;
+    if (task.depth >= BVH_MEDIAN_DEPTH && task.count <= BVH_MAX_LEAF_SIZE) {
+      continue;
+    }
+    if (task.depth < BVH_MEDIAN_DEPTH) {
+      BVHBin bins[3][BVH_BINS];
+      int splitAxis = 0;
+      uint32_t splitBin = 0;
+      _BVHBinRange(boxes, centroids, primitives, task.count, &centroidBounds, bins);
+      if (_BVHFindSplit(bins, &bounds, &centroidBounds, &splitAxis, &splitBin)) {
+        const float binScale = BVH_BINS / (centroidBounds.max[splitAxis] - centroidBounds.min[splitAxis]);
+        uint32_t left = 0, right = task.count;
+        while (left < right) {
+          if (_BVHBinIndex(centroids[primitives[left] * 3 + splitAxis], centroidBounds.min[splitAxis], binScale) < splitBin) {
+            ++left;
+          } else {
+            const uint32_t swap = primitives[left];
+            primitives[left] = primitives[--right];
+            primitives[right] = swap;
+          }
+        }
+        leftCount = left;
+      } else if (task.count <= BVH_MAX_LEAF_SIZE) {
+        continue;
+      }
+    }
+
+    node->first = bvh->node;
+    node->count = 0;
+    bvh->node += 2;
+    stack[stackSize++] = (BVHTask){node->first + 1, task.first + leftCount, task.count - leftCount, task.depth + 1};
+    stack[stackSize++] = (BVHTask){node->first, task.first, leftCount, task.depth + 1};
+  }
+  if (count == 0) {
+    bvh->node = 1;
+  }
+  bvh->nodes = (BVHNode *)realloc(bvh->nodes, bvh->node * sizeof(BVHNode));
+  free(centroids);
+  return bvh;
+}
+
+bool BVHDestroy(BVH *bvh) {
+  if (bvh == NULL) {
+#ifndef NDEBUG
+    fprintf(stderr, "%s: trying to free null pointer, ignored.\n", __FUNCTION_NAME__);
+#endif
+    return false;
+  }
+  free(bvh->nodes);
+  free(bvh->primitives);
+  free(bvh);
+  return true;
+}
+
+/**
+ * Bytes held by the BVH
+ */
+uint64_t BVHMemorySize(const BVH *bvh) { return sizeof(BVH) + (uint64_t)bvh->node * sizeof(BVHNode) + (uint64_t)bvh->primitive * sizeof(uint32_t); }
+
+/**
+ * Number of levels of the BVH (1 for a single leaf)
+ */
+uint32_t BVHDepth(const BVH *bvh) {
+  uint32_t stack[BVH_STACK_SIZE][2], stackSize = 0, depth = 0;
+  stack[stackSize][0] = 0;
+  stack[stackSize++][1] = 1;
+  while (stackSize > 0) {
+    --stackSize;
+    const BVHNode *node = &bvh->nodes[stack[stackSize][0]];
+    const uint32_t level = stack[stackSize][1];
+    depth = level > depth ? level : depth;
+    if (node->count == 0 && bvh->primitive > 0) {
+      for (uint32_t child = 0; child < 2; ++child) {
+        stack[stackSize][0] = node->first + child;
+        stack[stackSize++][1] = level + 1;
+      }
+    }
+  }
+  return depth;
+}
+
+/**
+ * Range of BVH.primitives owned by a node (all the leaves below it)
+ */
+void BVHNodePrimitives(const BVH *bvh, uint32_t nodeIndex, uint32_t *first, uint32_t *count) {
+  const BVHNode *leftmost = &bvh->nodes[nodeIndex], *rightmost = leftmost;
+  while (leftmost->count == 0 && bvh->primitive > 0) {
+    leftmost = &bvh->nodes[leftmost->first];
+  }
+  while (rightmost->count == 0 && bvh->primitive > 0) {
+    rightmost = &bvh->nodes[rightmost->first + 1];
+  }
+  *first = leftmost->first;
+  *count = rightmost->first + rightmost->count - leftmost->first;
+}
+
+/**
+ * Distance along the ray to the box of a node, REAL_MAX if it is missed or farther than maxDistance
+ */
+FORCE_INLINE Real _BVHRayNode(const BVHNode *node, const Real origin[3], const Real inverse[3], Real maxDistance) {
+  Real near = 0, far = maxDistance;
+  for (int axis = 0; axis < 3; ++axis) {
+    if (isinf(inverse[axis])) { // parallel to the slab, (min - origin) * inverse would be NaN on its border
+      if (origin[axis] < node->min[axis] || origin[axis] > node->max[axis]) {
+        return REAL_MAX;
+      }
+      continue;
+    }
+    const Real t0 = (node->min[axis] - origin[axis]) * inverse[axis], t1 = (node->max[axis] - origin[axis]) * inverse[axis];
+    near = FMAX(near, FMIN(t0, t1));
+    far = FMIN(far, FMAX(t0, t1));
+  }
+  return near <= far ? near : REAL_MAX;
+}
+
+/**
+ * Find the nearest primitive hit by the ray origin + t * direction (0 <= t <= distance).
+ * Children are visited nearest first and skipped when their box is farther than the nearest hit.
+ * @param bvh
+ * @param origin
+ * @param direction
+ * @param intersect exact test of a primitive
+ * @param context passed to intersect
+ * @param distance [in, out] largest t, t of the nearest hit
+ * @param primitive [out] nearest primitive hit
+ * @return true if a primitive is hit
+ */
+bool BVHRaycast(const BVH *bvh, Vector origin, Vector direction, BVHRayFunction intersect, const void *context, Real *distance, uint32_t *primitive) {
+  if (bvh->primitive == 0) {
+    return false;
+  }
+  const Real rayOrigin[3] = {origin.x, origin.y, origin.z}, inverse[3] = {1 / direction.x, 1 / direction.y, 1 / direction.z};
+  bool hit = false;
+  uint32_t stack[BVH_STACK_SIZE], stackSize = 0;
+  if (_BVHRayNode(&bvh->nodes[0], rayOrigin, inverse, *distance) != REAL_MAX) {
+    stack[stackSize++] = 0;
+  }
+  while (stackSize > 0) {
+    const BVHNode *node = &bvh->nodes[stack[--stackSize]];
+    if (node->count > 0) {
+      for (uint32_t i = node->first; i < node->first + node->count; ++i) {
+        if (intersect(context, bvh->primitives[i], origin, direction, distance)) {
+          hit = true;
+          *primitive = bvh->primitives[i];
+        }
+      }
+      continue;
+    }
+    const Real near[2] = {_BVHRayNode(&bvh->nodes[node->first], rayOrigin, inverse, *distance), _BVHRayNode(&bvh->nodes[node->first + 1], rayOrigin, inverse, *distance)};
+    const uint32_t nearChild = near[1] < near[0];
+    if (near[1 - nearChild] != REAL_MAX) {
+      stack[stackSize++] = node->first + 1 - nearChild;
+    }
+    if (near[nearChild] != REAL_MAX) {
+      stack[stackSize++] = node->first + nearChild;
+    }
+  }
+  return hit;
+}
+
+/**
+ * Visit the primitives of the leaves whose box overlaps [min, max], a point query when min equals max.
+ * Leaves are visited in the order of BVH.primitives, visit does the exact test.
+ * @return number of primitives visited
+ */
+uint64_t BVHQueryBox(const BVH *bvh, Vector min, Vector max, BVHBoxFunction visit, void *context) {
+  if (bvh->primitive == 0) {
+    return 0;
+  }
+  const Real queryMin[3] = {min.x, min.y, min.z}, queryMax[3] = {max.x, max.y, max.z};
+  uint64_t visited = 0;
+  uint32_t stack[BVH_STACK_SIZE], stackSize = 0;
+  stack[stackSize++] = 0;
+  while (stackSize > 0) {
+    const BVHNode *node = &bvh->nodes[stack[--stackSize]];
+    bool overlap = true;
+    for (int axis = 0; axis < 3; ++axis) {
+      overlap = overlap && node->min[axis] <= queryMax[axis] && queryMin[axis] <= node->max[axis];
+    }
+    if (!overlap) {
+      continue;
+    }
+    if (node->count == 0) {
+      stack[stackSize++] = node->first + 1;
+      stack[stackSize++] = node->first;
+      continue;
+    }
+    for (uint32_t i = node->first; i < node->first + node->count; ++i) {
+      ++visited;
+      if (!visit(context, bvh->primitives[i])) {
+        return visited;
+      }
+    }
+  }
+  return visited;
+}
+
+/**
+ * Float box enclosing the box [min, max] of Real, rounded outward
+ */
+void BVHBoxFromReal(Vector min, Vector max, float box[6]) {
+  const Real values[6] = {min.x, min.y, min.z, max.x, max.y, max.z};
+  for (int i = 0; i < 6; ++i) {
+    const float value = (float)values[i];
+    box[i] = i < 3 ? (value > values[i] ? nextafterf(value, -FLT_MAX) : value) : (value < values[i] ? nextafterf(value, FLT_MAX) : value);
+  }
+}
@@ -0,0 +1,51 @@
+#ifndef RENDER_BVH_H
+#define RENDER_BVH_H
+
+#include "common.h"
+#include "vector.h"
+
+#define BVH_BINS 16          // SAH split candidates per axis are the borders of BVH_BINS bins
+#define BVH_MAX_LEAF_SIZE 8  // larger nodes are always split
+#define BVH_STACK_SIZE 64    // traversal stack, deeper than any tree of 2^32 primitives built by BVHCreate
+
+/*
+ * Bounding volume hierarchy of axis-aligned boxes, built top-down with binned SAH (surface area heuristic).
+ * The children of an inner node are adjacent and stored after it, and every node owns a contiguous range of BVH.primitives.
+ * Boxes are float and rounded outward, they enclose their primitives whatever the precision of Real.
+ */
+typedef struct tagBVHNode {
+  float min[3];
+  float max[3];
+  uint32_t first; // leaf: first primitive in BVH.primitives, inner node: index of the first child (the second one follows it)
+  uint32_t count; // leaf: number of primitives, inner node: 0
+} BVHNode;
+
+typedef struct tagBVH {
+  uint32_t node;
+  BVHNode *nodes; // nodes[0] is the root
+  uint32_t primitive;
+  uint32_t *primitives; // indices of the primitives, grouped by leaf
+} BVH;
+
+/**
+ * Intersect a primitive with the ray origin + t * direction.
+ * @return true and set distance (t) if it is hit closer than distance
+ */
+typedef bool (*BVHRayFunction)(const void *context, uint32_t primitive, Vector origin, Vector direction, Real *distance);
+
+/**
+ * Called for each primitive whose box overlaps the query box
+ * @return false to stop the query
+ */
+typedef bool (*BVHBoxFunction)(void *context, uint32_t primitive);
+
+BVH *BVHCreate(const float *boxes, uint32_t count);
+bool BVHDestroy(BVH *bvh);
+uint64_t BVHMemorySize(const BVH *bvh);
+uint32_t BVHDepth(const BVH *bvh);
+void BVHNodePrimitives(const BVH *bvh, uint32_t nodeIndex, uint32_t *first, uint32_t *count);
+bool BVHRaycast(const BVH *bvh, Vector origin, Vector direction, BVHRayFunction intersect, const void *context, Real *distance, uint32_t *primitive);
+uint64_t BVHQueryBox(const BVH *bvh, Vector min, Vector max, BVHBoxFunction visit, void *context);
+void BVHBoxFromReal(Vector min, Vector max, float box[6]);
+
+#endif // RENDER_BVH_H
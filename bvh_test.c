@@ -0,0 +1,164 @@
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bvh.h"
+
+/**
+ * Primitives of the tests are the boxes themselves
+ */
+bool _TestRayBox(const void *context, uint32_t primitive, Vector origin, Vector direction, Real *distance) {
+  const float *box = &((const float *)context)[primitive * 6];
+  const Real o[3] = {origin.x, origin.y, origin.z}, d[3] = {direction.x, direction.y, direction.z};
+  Real near = 0, far = *distance;
+  for (int axis = 0; axis < 3; ++axis) {
+    const Real t0 = (box[axis] - o[axis]) / d[axis], t1 = (box[axis + 3] - o[axis]) / d[axis];
+    near = FMAX(near, FMIN(t0, t1));
+    far = FMIN(far, FMAX(t0, t1));
+  }
+  if (near > far || near == *distance) {
+    return false;
+  }
+  *distance = near;
+  return true;
+}
+
+/**
+ * Only the primitive in context is hit
+ */
+bool _TestRayTarget(const void *context, uint32_t primitive, Vector origin, Vector direction, Real *distance) {
+  UNUSED(origin);
+  UNUSED(direction);
+  if (primitive != *(const uint32_t *)context) {
+    return false;
+  }
+  *distance = 0;
+  return true;
+}
+
+typedef struct tagTestBoxQuery {
+  const float *boxes;
+  Vector point;
+  uint32_t found;
+} TestBoxQuery;
+
+bool _TestVisitPoint(void *context, uint32_t primitive) {
+  TestBoxQuery *query = (TestBoxQuery *)context;
+  const float *box = &query->boxes[primitive * 6];
+  query->found += box[0] <= query->point.x && query->point.x <= box[3] && box[1] <= query->point.y && query->point.y <= box[4] && box[2] <= query->point.z && query->point.z <= box[5];
+  return true;
+}
+
+int main() {
+  {
+    // random boxes: every primitive is in one leaf, nodes enclose their children and primitives
+    const uint32_t count = 20000;
+    float *boxes = malloc(count * 6 * sizeof(float));
+    srand(1);
+    for (uint32_t i = 0; i < count; ++i) {
+      for (int axis = 0; axis < 3; ++axis) {
+        const float center = (float)rand() / RAND_MAX * 100, size = (float)rand() / RAND_MAX;
+        boxes[i * 6 + axis] = center - size;
+        boxes[i * 6 + 3 + axis] = center + size;
+      }
+    }
+    BVH *bvh = BVHCreate(boxes, count);
+    assert(bvh != NULL && bvh->primitive == count && bvh->node < 2 * count && BVHDepth(bvh) < BVH_STACK_SIZE);
+    uint8_t *seen = calloc(count, 1);
+    for (uint32_t n = 0; n < bvh->node; ++n) {
+      const BVHNode *node = &bvh->nodes[n];
+      uint32_t first, primitiveCount;
+      BVHNodePrimitives(bvh, n, &first, &primitiveCount);
+      assert(node->count == 0 || (node->first == first && node->count == primitiveCount && node->count <= BVH_MAX_LEAF_SIZE));
+      for (uint32_t i = first; i < first + primitiveCount; ++i) {
+        const float *box = &boxes[bvh->primitives[i] * 6];
+        for (int axis = 0; axis < 3; ++axis) {
+          assert(node->min[axis] <= box[axis] && box[axis + 3] <= node->max[axis]);
+        }
+        seen[bvh->primitives[i]] += node->count > 0;
+        UNUSED(box);
+      }
+      assert(node->count > 0 || (node->first > n && node->first + 1 < bvh->node));
+    }
+    for (uint32_t i = 0; i < count; ++i) {
+      assert(seen[i] == 1);
+    }
+
+    // ray and point queries agree with brute force
+    for (int query = 0; query < 200; ++query) {
+      const Vector origin = V(rand() % 100, rand() % 100, -10), direction = V((Real)rand() / RAND_MAX - 0.5, (Real)rand() / RAND_MAX - 0.5, 1);
+      Real distance = 1000, bruteDistance = 1000;
+      uint32_t primitive = UINT32_MAX, brutePrimitive = UINT32_MAX;
+      const bool hit = BVHRaycast(bvh, origin, direction, _TestRayBox, boxes, &distance, &primitive);
+      for (uint32_t i = 0; i < count; ++i) {
+        if (_TestRayBox(boxes, i, origin, direction, &bruteDistance)) {
+          brutePrimitive = i;
+        }
+      }
+      assert(hit == (brutePrimitive != UINT32_MAX) && distance == bruteDistance);
+      assert(!hit || primitive == brutePrimitive || FABS(distance - bruteDistance) == 0);
+      UNUSED(hit);
+      UNUSED(brutePrimitive);
+
+      TestBoxQuery pointQuery = {boxes, V(rand() % 100, rand() % 100, rand() % 100), 0};
+      BVHQueryBox(bvh, pointQuery.point, pointQuery.point, _TestVisitPoint, &pointQuery);
+      uint32_t bruteFound = 0;
+      for (uint32_t i = 0; i < count; ++i) {
+        const float *box = &boxes[i * 6];
+        bruteFound += box[0] <= pointQuery.point.x && pointQuery.point.x <= box[3] && box[1] <= pointQuery.point.y && pointQuery.point.y <= box[4] && box[2] <= pointQuery.point.z &&
+                      pointQuery.point.z <= box[5];
+      }
+      assert(pointQuery.found == bruteFound);
+      UNUSED(bruteFound);
+    }
+
+    // rays parallel to two axes, along the borders of the boxes
+    for (uint32_t i = 0; i < count; i += 101) {
+      const float *box = &boxes[i * 6];
+      const Vector origins[2] = {V(box[0], box[1], -10), V(box[3], -10, box[5])}, directions[2] = {V(0, 0, 1), V(0, 1, 0)};
+      for (int j = 0; j < 2; ++j) {
+        Real distance = 1000;
+        uint32_t primitive = UINT32_MAX;
+        const bool hit = BVHRaycast(bvh, origins[j], directions[j], _TestRayTarget, &i, &distance, &primitive);
+        assert(hit && primitive == i);
+        UNUSED(hit);
+      }
+    }
+    assert(BVHMemorySize(bvh) == sizeof(BVH) + bvh->node * sizeof(BVHNode) + count * sizeof(uint32_t));
+    free(seen);
+    BVHDestroy(bvh);
+    free(boxes);
+  }
+  {
+    // equal boxes can't be split by SAH, their depth is still bounded
+    const uint32_t count = 1000;
+    float *boxes = malloc(count * 6 * sizeof(float));
+    for (uint32_t i = 0; i < count * 6; ++i) {
+      boxes[i] = i % 6 < 3 ? 0 : 1;
+    }
+    BVH *bvh = BVHCreate(boxes, count);
+    assert(bvh != NULL && BVHDepth(bvh) < BVH_STACK_SIZE);
+    Real distance = 10;
+    uint32_t primitive;
+    const bool hit = BVHRaycast(bvh, V(0.5, 0.5, -1), V(0, 0, 1), _TestRayBox, boxes, &distance, &primitive);
+    assert(hit && distance == 1);
+    UNUSED(hit);
+    BVHDestroy(bvh);
+    free(boxes);
+  }
+  {
+    // empty tree, boxes rounded outward from Real
+    BVH *bvh = BVHCreate(NULL, 0);
+    Real distance = 10;
+    uint32_t primitive;
+    assert(bvh != NULL && bvh->node == 1 && !BVHRaycast(bvh, V0, V(0, 0, 1), _TestRayBox, NULL, &distance, &primitive));
+    assert(BVHQueryBox(bvh, V0, V1, _TestVisitPoint, NULL) == 0);
+    BVHDestroy(bvh);
+    float box[6];
+    BVHBoxFromReal(V(0.1, -0.1, 1), V(0.1, 0.3, 1), box);
+    assert(box[0] <= (Real)0.1 && box[1] <= (Real)-0.1 && box[2] == 1 && box[3] >= (Real)0.1 && box[4] >= (Real)0.3 && box[5] == 1);
+    UNUSED(primitive);
+  }
+  return 0;
+}
@@ -10,30 +10,27 @@ Camera *_CameraNew(Vector eye, Vector at, Vector up_v, uint16_t projection_width
   Vector y = VectorCrossProduct(z, x);
 
   Real ___world2camera[][4] = {{x.x, x.y, x.z, 0}, {y.x, y.y, y.z, 0}, {z.x, z.y, z.z, 0}, {-eye.x, -eye.y, -eye.z, 1}};
-  Matrix *__world2camera = MatrixFromArray(4, 4, ___world2camera);
-  Matrix *_world2camera = MatrixTranspose(__world2camera);
-  Matrix *world2camera = MatrixInverse(_world2camera);
-  MatrixDestroy(__world2camera);
-  MatrixDestroy(_world2camera);
+  Mat4 __world2camera = Mat4FromArray(___world2camera);
+  Mat4 _world2camera = Mat4Transpose(&__world2camera);
+  Mat4 world2camera = Mat4Inverse(&_world2camera);
 
   Camera *new = calloc(1, sizeof(Camera));
-  *new = (Camera){eye, at, up_v, projection_width, projection_height, 0, near, far, world2camera, NULL, NULL, NULL};
+  *new = (Camera){eye, at, up_v, projection_width, projection_height, 0, near, far, world2camera, Mat4Identity(), Mat4Identity(), Mat4Identity()};
   return new;
 }
 
 Camera *CameraPerspectiveProjection(Vector eye, Vector at, Vector up_v, uint16_t image_width, uint16_t image_height, Real near, Real far, Real fov) {
   Camera *c = _CameraNew(eye, at, up_v, image_width, image_height, near, far);
   c->fov = fov;
-  Real scale = 1 / tanl(c->fov * 0.5 * M_PI / 180);
+  Real scale = 1 / TAN(c->fov * 0.5 * M_PI / 180);
   Real aspect = (Real)c->image_width / c->image_height;
   Real range = c->far - c->near;
-  Real __camera2ndc[][4] = {{scale / aspect, 0, 0, 0}, {0, scale, 0, 0}, {0, 0, -c->far / range, -1}, {0, 0, -c->far * c->near / range, 0}};
-  Matrix *_camera2ndc = MatrixFromArray(4, 4, __camera2ndc);
-  Matrix *camera2ndc = MatrixTranspose(_camera2ndc);
-  MatrixDestroy(_camera2ndc);
-  c->camera2ndc = camera2ndc;
-  c->world2ndc = MatrixMultiplication(c->camera2ndc, c->world2camera);
-  c->ndc2world = MatrixInverse(c->world2ndc);
+  // depth (-z in NDC, not divided by w) runs linearly from 0 at the near plane to 1 at the far plane, as normalized z-buffer formats expect
+  Real __camera2ndc[][4] = {{scale / aspect, 0, 0, 0}, {0, scale, 0, 0}, {0, 0, -1 / range, -1}, {0, 0, c->near / range, 0}};
+  Mat4 _camera2ndc = Mat4FromArray(__camera2ndc);
+  c->camera2ndc = Mat4Transpose(&_camera2ndc);
+  c->world2ndc = Mat4Multiplication(&c->camera2ndc, &c->world2camera);
+  c->ndc2world = Mat4Inverse(&c->world2ndc);
   return c;
 }
 
@@ -44,12 +41,42 @@ bool CameraDestroy(Camera *camera) {
 #endif
     return false;
   }
-  MatrixDestroy(camera->world2camera);
-  MatrixDestroy(camera->camera2ndc);
-  MatrixDestroy(camera->world2ndc);
-  MatrixDestroy(camera->ndc2world);
   free(camera);
   return true;
 }
 
 Vector CameraGetDirection(const Camera *camera, const Vector position) { return VectorL2Normalization(VectorSubtraction(position, camera->eye)); }
+
+/**
+ * Center of projection in world space.
+ * It is derived from world2camera rather than taken from eye so that culling agrees with what WorldPos2NDCPos actually draws.
+ */
+Vector CameraGetCenterOfProjection(const Camera *camera) {
+  const Mat4 camera2world = Mat4Inverse(&camera->world2camera);
+  return V(camera2world.m[3], camera2world.m[7], camera2world.m[11]);
+}
+
+/**
+ * Test a sphere in world space against the view frustum.
+ * Points in front of the camera have a negative w in world2ndc (WorldPos2NDCPos divides by it with a flipped sign), so the side planes are extracted from the rows of world2ndc with
+ * -w and the near and far planes are taken at the camera space distances -w = near and -w = far.
+ * @return false if the sphere is entirely outside of one plane
+ */
+bool CameraSphereInFrustum(const Camera *camera, const Vector center, const Real radius) {
+  const Real *m = camera->world2ndc.m;
+  const Real planes[6][4] = {
+      {m[0] - m[12], m[1] - m[13], m[2] - m[14], m[3] - m[15]},     // left
+      {-m[0] - m[12], -m[1] - m[13], -m[2] - m[14], -m[3] - m[15]}, // right
+      {m[4] - m[12], m[5] - m[13], m[6] - m[14], m[7] - m[15]},     // bottom
+      {-m[4] - m[12], -m[5] - m[13], -m[6] - m[14], -m[7] - m[15]}, // top
+      {-m[12], -m[13], -m[14], -m[15] - camera->near},              // near
+      {m[12], m[13], m[14], m[15] + camera->far},                   // far
+  };
+  for (int i = 0; i < 6; ++i) {
+    const Real distance = planes[i][0] * center.x + planes[i][1] * center.y + planes[i][2] * center.z + planes[i][3];
+    if (distance < -radius * SQRT(planes[i][0] * planes[i][0] + planes[i][1] * planes[i][1] + planes[i][2] * planes[i][2])) {
+      return false;
+    }
+  }
+  return true;
+}
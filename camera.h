@@ -40,14 +40,16 @@ typedef struct tagCamera {
   Real fov; // perspective projection
   Real near, far;
 
-  Matrix *world2camera;
-  Matrix *camera2ndc;
-  Matrix *world2ndc;
-  Matrix *ndc2world;
+  Mat4 world2camera;
+  Mat4 camera2ndc;
+  Mat4 world2ndc;
+  Mat4 ndc2world;
 } Camera;
 
 Camera *CameraPerspectiveProjection(Vector eye, Vector at, Vector up_v, uint16_t image_width, uint16_t image_height, Real near, Real far, Real fov);
 bool CameraDestroy(Camera *camera);
 Vector CameraGetDirection(const Camera *camera, Vector position);
+Vector CameraGetCenterOfProjection(const Camera *camera);
+bool CameraSphereInFrustum(const Camera *camera, Vector center, Real radius);
 
 #endif // RENDER_CAMERA_H
@@ -14,7 +14,10 @@ typedef unsigned __int64 uint64_t;
 #include <stdint.h>
 #endif
 
+#include <float.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
 
 #ifndef __FUNCTION_NAME__
 #ifdef WIN32
@@ -28,11 +31,86 @@ typedef unsigned __int64 uint64_t;
 #define NULL 0
 #endif
 
-#define RADIAN(degree) degree * 3.14159265358979323846264338327950288 / 180
-#define CONFINE(value, min, max) fmaxl(fminl(value, max), min)
-
+/*
+ * Real is selected at build time (cmake -DRENDER_REAL=float|double|long_double).
+ * Use REAL_MAX / REAL_MIN as sentinels and the math macros below instead of the suffixed libm functions (sqrtl, sqrtf, ...),
+ * so every module follows the selected precision.
+ */
+#if defined(RENDER_REAL_FLOAT)
+typedef float Real;
+#define REAL_MAX FLT_MAX
+#define REAL_MIN FLT_MIN
+#define REAL_EPSILON FLT_EPSILON
+#define REAL_FORMAT "%f"
+#define REAL_FUNCTION(name) name##f
+#elif defined(RENDER_REAL_DOUBLE)
+typedef double Real;
+#define REAL_MAX DBL_MAX
+#define REAL_MIN DBL_MIN
+#define REAL_EPSILON DBL_EPSILON
+#define REAL_FORMAT "%f"
+#define REAL_FUNCTION(name) name
+#else
 typedef long double Real;
+#define REAL_MAX LDBL_MAX
+#define REAL_MIN LDBL_MIN
+#define REAL_EPSILON LDBL_EPSILON
+#define REAL_FORMAT "%Lf"
+#define REAL_FUNCTION(name) name##l
+#endif
+
+#define FABS(x) REAL_FUNCTION(fabs)(x)
+#define FMAX(x, y) REAL_FUNCTION(fmax)(x, y)
+#define FMIN(x, y) REAL_FUNCTION(fmin)(x, y)
+#define SQRT(x) REAL_FUNCTION(sqrt)(x)
+#define POW(x, y) REAL_FUNCTION(pow)(x, y)
+#define SIN(x) REAL_FUNCTION(sin)(x)
+#define COS(x) REAL_FUNCTION(cos)(x)
+#define TAN(x) REAL_FUNCTION(tan)(x)
+#define ATAN2(y, x) REAL_FUNCTION(atan2)(y, x)
+#define ROUND(x) REAL_FUNCTION(round)(x)
+#define FLOOR(x) REAL_FUNCTION(floor)(x)
+
+#define RADIAN(degree) degree * 3.14159265358979323846264338327950288 / 180
+#define CONFINE(value, min, max) FMAX(FMIN(value, max), min)
 
 #define UNUSED(x) (void)(x)
 
+#if defined(__GNUC__)
+#define FORCE_INLINE static inline __attribute__((always_inline))
+#elif defined(_MSC_VER)
+#define FORCE_INLINE static __forceinline
+#else
+#define FORCE_INLINE static inline
+#endif
+
+#if defined(__GNUC__)
+#define POPCOUNT(x) __builtin_popcount(x)
+#else
+FORCE_INLINE int _PopCount(uint32_t x) {
+  int count = 0;
+  for (; x != 0; x &= x - 1) {
+    ++count;
+  }
+  return count;
+}
+#define POPCOUNT(x) _PopCount(x)
+#endif
+
+/**
+ * Repeat the first element (size bytes) of buffer over count elements.
+ * The filled prefix is doubled with memcpy up to a few KiB, then copied from there in place, so any pattern is written at about memset speed.
+ */
+FORCE_INLINE void _FillRepeat(void *buffer, size_t size, size_t count) {
+  uint8_t *bytes = (uint8_t *)buffer;
+  const size_t total = size * count;
+  size_t filled = size, chunk = size;
+  while (filled < total) {
+    const size_t length = chunk < total - filled ? chunk : total - filled;
+    memcpy(bytes + filled, bytes, length);
+    filled += length;
+    chunk = filled <= 4096 ? filled : chunk;
+  }
+}
+
 #endif // RENDER_COMMON_H
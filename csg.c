@@ -122,7 +122,7 @@ void CSGPrimitiveCylinderReduce(CSGSets *sets, const CSGCylinder *cylinder) {
   Vector *tops = (Vector *)calloc(p, sizeof(Vector));
   for (uint64_t j = 0; j < p; ++j) {
     Real x = 2 * M_PI * j / p;
-    Real _sin = sinl(x) * r, _cos = cosl(x) * r;
+    Real _sin = SIN(x) * r, _cos = COS(x) * r;
     bottoms[j] = V(_sin, 0, _cos);
     tops[j] = V(_sin, h, _cos);
   }
@@ -146,7 +146,7 @@ void CSGPrimitiveTriangularReduce(CSGSets *sets, const CSGTriangular *triangular
   Vector *bottoms = (Vector *)calloc(p, sizeof(Vector));
   for (uint64_t j = 0; j < p; ++j) {
     Real x = 2 * M_PI * j / p;
-    Real _sin = sinl(x) * r, _cos = cosl(x) * r;
+    Real _sin = SIN(x) * r, _cos = COS(x) * r;
     bottoms[j] = V(_sin, 0, _cos);
   }
   for (uint64_t i = 0; i < p; ++i) {
@@ -173,16 +173,16 @@ void CSGPrimitiveBallReduce(CSGSets *sets, const CSGBall *ball) {
       rad = 2 * M_PI * roundIndex / p;
       radSurface = M_PI * hemisphereIndex / p;
 
-      x = sinl(rad) * sinl(radSurface) * r;
-      y = (cosl(radSurface) + 1) / 2 * h;
-      z = cosl(rad) * sinl(radSurface) * r;
+      x = SIN(rad) * SIN(radSurface) * r;
+      y = (COS(radSurface) + 1) / 2 * h;
+      z = COS(rad) * SIN(radSurface) * r;
       tops[roundIndex] = V(x, y, z);
 
       radSurface = M_PI * (Real)(hemisphereIndex + 1) / p;
 
-      x = sinl(rad) * sinl(radSurface) * r;
-      y = (cosl(radSurface) + 1) / 2 * h;
-      z = cosl(rad) * sinl(radSurface) * r;
+      x = SIN(rad) * SIN(radSurface) * r;
+      y = (COS(radSurface) + 1) / 2 * h;
+      z = COS(rad) * SIN(radSurface) * r;
       bottoms[roundIndex] = V(x, y, z);
     }
     for (roundIndex = 0; roundIndex < p; ++roundIndex) {
@@ -265,22 +265,27 @@ void CSGPrimitiveSetsReduce(CSGSets *sets) {
 
 Polygon *CSGPrimitiveSetsPolygon(const CSGSets *sets) {
   uint64_t triangle = sets->primitives->length;
-
-  Polygon *polygon = (Polygon *)calloc(1, sizeof(Polygon));
-  polygon->triangle = triangle;
-  polygon->triangles = (Triangle *)calloc(triangle, sizeof(Triangle));
+  STLTriangle *triangles = (STLTriangle *)calloc(triangle > 0 ? triangle : 1, sizeof(STLTriangle));
 
   uint64_t triangleIndex = 0;
   LinkedList *cur = sets->primitives;
   while (cur != NULL) {
     CSGTriangle *s = cur->ptr;
     assert(s->type == CSG_Triangle);
-    Triangle *d = &polygon->triangles[triangleIndex];
-    memcpy(d->vertexes, s->vertexes, sizeof(Vector) * 3);
-    d->surfaceNormal = s->surfaceNormal;
+    STLTriangle *d = &triangles[triangleIndex];
+    for (int vertexIndex = 0; vertexIndex < 3; ++vertexIndex) {
+      d->vertexes[vertexIndex][0] = (float)s->vertexes[vertexIndex].x;
+      d->vertexes[vertexIndex][1] = (float)s->vertexes[vertexIndex].y;
+      d->vertexes[vertexIndex][2] = (float)s->vertexes[vertexIndex].z;
+    }
+    d->surfaceNormal[0] = (float)s->surfaceNormal.x;
+    d->surfaceNormal[1] = (float)s->surfaceNormal.y;
+    d->surfaceNormal[2] = (float)s->surfaceNormal.z;
     ++triangleIndex;
     cur = cur->next;
   }
+  Polygon *polygon = PolygonCreateFromSTL(triangles, triangle);
+  free(triangles);
 
   return polygon;
-}
\ No newline at end of file
+}
@@ -19,9 +19,14 @@ int main() {
   // now, CSG primitive set can be destroyed
   CSGPrimitiveSetsDestroy(csgSets);
 
+  // create Bitmap and Z-buffer once, they are cleared for every frame
+  const int w = 1000, h = 1000;
+  Bitmap *bmp = BitmapNewImage(w, h);
+  ZBuffer *zbuffer = ZBufferCreate(w, h, Float32DepthFormat);
+
   for (int i = 0; i < 360; ++i) {
-    const int w = 1000, h = 1000;
-    Bitmap *bmp = BitmapNewImage(w, h);
+    BitmapClear(bmp, NULL);
+    ZBufferClear(zbuffer);
 
     // create camera
     Camera *camera = CameraPerspectiveProjection(V(3, -3, 3), V(1, -2, 1), V(0, 1, 0), w, h, 0.1, 1000, 60);
@@ -32,16 +37,13 @@ int main() {
     // set camera
     SceneSetCamera(scene, camera);
 
-    // create Z-buffer
-    ZBuffer *zbuffer = ZBufferCreate(w, h);
-
     // append light to scene
     Light light = LightCreatePointLight(V(1, 1, 1), V(1, 1, 1), V(0, -6, 3));
     SceneAppendLight(scene, &light);
 
     // append CSG primitive to scene
     Transformer *transformer = TransformerCreate(V0, V(0, RADIAN(i), 0), V1);
-    const Material redMaterial = (Material){V(0.8274, 0.2196, 0.1098), 1, 1, 1, 30};
+    const Material redMaterial = (Material){V(0.8274, 0.2196, 0.1098), 1, 1, 1, 30, false};
     Thing *thing = ThingCreate(polygon, transformer, &redMaterial);
     SceneAppendThing(scene, thing);
 
@@ -56,11 +58,12 @@ int main() {
     // clean-up
     ThingDestroy(thing);
     TransformerDestroy(transformer);
-    ZBufferDestroy(zbuffer);
     SceneDestroy(scene);
     CameraDestroy(camera);
-    BitmapDestroy(bmp);
   }
 
+  ZBufferDestroy(zbuffer);
+  BitmapDestroy(bmp);
+
   PolygonDestroy(polygon);
 }
\ No newline at end of file
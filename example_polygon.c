@@ -29,13 +29,13 @@ int main() {
 
   // solid shading
   for (uint32_t i = 0; i < polygon->triangle; ++i) {
-    Triangle triangle = rasterize(camera, polygon->triangles[i]);
+    Triangle triangle = rasterize(camera, PolygonGetTriangle(polygon, i));
     DrawTriangle(bmp, triangle.vertexes[0], triangle.vertexes[1], triangle.vertexes[2], BMP_COLOR(255, 0, 0), NULL);
   }
 
   // draw wire-frame
   for (uint32_t i = 0; i < polygon->triangle; ++i) {
-    Triangle triangle = rasterize(camera, polygon->triangles[i]);
+    Triangle triangle = rasterize(camera, PolygonGetTriangle(polygon, i));
     DrawLine(bmp, triangle.vertexes[0], triangle.vertexes[1], BMP_COLOR(0, 0, 255));
     DrawLine(bmp, triangle.vertexes[1], triangle.vertexes[2], BMP_COLOR(0, 0, 255));
     DrawLine(bmp, triangle.vertexes[2], triangle.vertexes[0], BMP_COLOR(0, 0, 255));
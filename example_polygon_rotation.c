@@ -24,7 +24,7 @@ int main() {
 
     // draw wire-frame
     for (uint32_t i = 0; i < polygon->triangle; ++i) {
-      Triangle triangleWorld = TransformerTransformTriangle(transformer, polygon->triangles[i]);
+      Triangle triangleWorld = TransformerTransformTriangle(transformer, PolygonGetTriangle(polygon, i));
       Triangle triangle = rasterize(camera, triangleWorld);
       DrawLine(bmp, triangle.vertexes[0], triangle.vertexes[1], BMP_COLOR(0, 0, 255));
       DrawLine(bmp, triangle.vertexes[1], triangle.vertexes[2], BMP_COLOR(0, 0, 255));
@@ -11,7 +11,7 @@ int main() {
   Camera *camera = CameraPerspectiveProjection(V(2, 0, 0), V(0, 0, 0), V(0, 1, 0), w, h, 0.1, 1000, 60);
 
   // define material like gold
-  const Material goldMaterial = (Material){V(0.831373, 0.686275, 0.215686), 1, 1, 1, 120};
+  const Material goldMaterial = (Material){V(0.831373, 0.686275, 0.215686), 1, 1, 1, 120, false};
 
   // load ball model from STL file
   Polygon *polygon = PolygonReadSTL("models/ball.stl");
@@ -47,7 +47,7 @@ int main() {
     SceneAppendThing(scene, thing);
 
     // create empty z-buffer
-    ZBuffer *zbuffer = ZBufferCreate(w, h);
+    ZBuffer *zbuffer = ZBufferCreate(w, h, Float32DepthFormat);
 
     /*
      * Render type
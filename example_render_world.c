@@ -9,9 +9,9 @@ int main() {
   const int h = 1000;
 
   // define materials
-  const Material monkeyRedMaterial = (Material){V(0.8274, 0.2196, 0.1098), 1, 1, 1, 30};
-  const Material monkeyPurpleMaterial = (Material){V(0.4156, 0.2039, 0.5333), 0.5, 0.5, 0.5, 60};
-  const Material ballMaterial = (Material){V(1, 1, 1), 1, 1, 1, 90};
+  const Material monkeyRedMaterial = (Material){V(0.8274, 0.2196, 0.1098), 1, 1, 1, 30, false};
+  const Material monkeyPurpleMaterial = (Material){V(0.4156, 0.2039, 0.5333), 0.5, 0.5, 0.5, 60, false};
+  const Material ballMaterial = (Material){V(1, 1, 1), 1, 1, 1, 90, false};
 
   // load polygon from STL files
   Polygon *monkeyPolygon = PolygonReadSTL("models/monkey.stl");
@@ -37,45 +37,53 @@ int main() {
   Camera *camera = CameraPerspectiveProjection(V(2, 0, 0), V(0, 0, 0), V(0, 1, 0), w, h, 0.1, 1000, 60);
 
 #ifdef _OPENMP
-#pragma omp parallel for default(none) schedule(dynamic) shared(camera, monkeyRed, monkeyPurple, topBall, bottomBall)
+#pragma omp parallel default(none) shared(camera, monkeyRed, monkeyPurple, topBall, bottomBall)
 #endif
-  for (int i = 0; i < 360; ++i) {
+  {
+    // create Bitmap and Z-buffer once (per thread), they are cleared for every frame
     Bitmap *bmp = BitmapNewImage(w, h);
+    ZBuffer *zbuffer = ZBufferCreate(w, h, Float32DepthFormat);
 
-    // create point source rotating around objects
-    Transformer *lightTransformer = TransformerCreate(V0, V(RADIAN(i), RADIAN(i), 0), V1);
-    Vector lightPos = TransformerTransformPoint(lightTransformer, V(10, 10, 10));
-    TransformerDestroy(lightTransformer);
-    Light light = LightCreatePointLight(V(1, 1, 1), V(1, 1, 1), lightPos);
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic)
+#endif
+    for (int i = 0; i < 360; ++i) {
+      BitmapClear(bmp, NULL);
+      ZBufferClear(zbuffer);
+
+      // create point source rotating around objects
+      Transformer *lightTransformer = TransformerCreate(V0, V(RADIAN(i), RADIAN(i), 0), V1);
+      Vector lightPos = TransformerTransformPoint(lightTransformer, V(10, 10, 10));
+      TransformerDestroy(lightTransformer);
+      Light light = LightCreatePointLight(V(1, 1, 1), V(1, 1, 1), lightPos);
 
-    // create empty scene
-    Scene *scene = SceneCreateEmpty();
+      // create empty scene
+      Scene *scene = SceneCreateEmpty();
 
-    // set camera to the scene
-    SceneSetCamera(scene, camera);
+      // set camera to the scene
+      SceneSetCamera(scene, camera);
 
-    // append light source to the scene
-    SceneAppendLight(scene, &light);
+      // append light source to the scene
+      SceneAppendLight(scene, &light);
 
-    // append objects to the scene
-    SceneAppendThing(scene, monkeyRed);
-    SceneAppendThing(scene, monkeyPurple);
-    SceneAppendThing(scene, topBall);
-    SceneAppendThing(scene, bottomBall);
+      // append objects to the scene
+      SceneAppendThing(scene, monkeyRed);
+      SceneAppendThing(scene, monkeyPurple);
+      SceneAppendThing(scene, topBall);
+      SceneAppendThing(scene, bottomBall);
 
-    // create Z-buffer
-    ZBuffer *zbuffer = ZBufferCreate(w, h);
+      // render scene to Bitmap
+      SceneRender(scene, bmp, zbuffer, WorldRender, PhongShading, BlinnPhongReflectionModel);
 
-    // render scene to Bitmap
-    SceneRender(scene, bmp, zbuffer, WorldRender, PhongShading, BlinnPhongReflectionModel);
+      // save image to Bitmap file
+      char buf[100];
+      sprintf(buf, "render_world_%d.bmp", i);
+      BitmapWriteFile(bmp, buf);
 
-    // save image to Bitmap file
-    char buf[100];
-    sprintf(buf, "render_world_%d.bmp", i);
-    BitmapWriteFile(bmp, buf);
+      // clean-up
+      SceneDestroy(scene);
+    }
 
-    // clean-up
-    SceneDestroy(scene);
     ZBufferDestroy(zbuffer);
     BitmapDestroy(bmp);
   }
@@ -15,11 +15,11 @@ int main() {
   Camera *camera = CameraPerspectiveProjection(V(1, 0, 0), V(0, 0, 0), V(0, 1, 0), w, h, 0.1, 1000, 120);
 
   // create empty z-buffer
-  ZBuffer *zbuffer = ZBufferCreate(w, h);
+  ZBuffer *zbuffer = ZBufferCreate(w, h, Float32DepthFormat);
 
   // draw wire-frame
   for (uint32_t i = 0; i < polygon->triangle; ++i) {
-    Triangle triangle = rasterize(camera, polygon->triangles[i]);
+    Triangle triangle = rasterize(camera, PolygonGetTriangle(polygon, i));
     DrawTriangle(bmp, triangle.vertexes[0], triangle.vertexes[1], triangle.vertexes[2], BMP_COLOR(255, 0, 0), zbuffer);
   }
 
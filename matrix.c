@@ -56,7 +56,7 @@ void MatrixPrint(const Matrix *a) {
   for (uint32_t row = 0; row < a->rows; ++row) {
     printf("{");
     for (uint32_t col = 0; col < a->columns; ++col) {
-      printf(col < a->columns - 1 ? "%Lf," : "%Lf", MatrixGetElement(a, row, col));
+      printf(col < a->columns - 1 ? REAL_FORMAT "," : REAL_FORMAT, MatrixGetElement(a, row, col));
     }
     printf("%s", row < a->rows - 1 ? "}," : "}");
   }
@@ -82,7 +82,7 @@ bool MatrixCompareLoose(const Matrix *a, const Matrix *b, Real error) {
 #endif
   for (uint32_t row = 0; row < a->rows; ++row) {
     for (uint32_t col = 0; col < a->columns; ++col) {
-      if (fabsl(MatrixGetElement(a, row, col) - MatrixGetElement(b, row, col)) >= error) {
+      if (FABS(MatrixGetElement(a, row, col) - MatrixGetElement(b, row, col)) >= error) {
         return false;
       }
     }
@@ -438,3 +438,97 @@ Matrix *MatrixScalarSubtraction(const Matrix *a, Real value) { return _MatrixSca
 Matrix *MatrixScalarMultiplication(const Matrix *a, Real value) { return _MatrixScalarManipulation(a, '*', value); }
 
 Matrix *MatrixScalarDivision(const Matrix *a, Real value) { return _MatrixScalarManipulation(a, '/', value); }
+
+Mat4 Mat4Identity(void) { return (Mat4){{1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1}}; }
+
+Mat4 Mat4FromArray(const Real array[4][4]) {
+  Mat4 new;
+  memcpy(new.m, array, sizeof(new.m));
+  return new;
+}
+
+Matrix *Mat4ToMatrix(const Mat4 *a) {
+  Matrix *new = MatrixZero(4, 4);
+  memcpy(new->matrix, a->m, sizeof(a->m));
+  return new;
+}
+
+bool Mat4Compare(const Mat4 *a, const Mat4 *b) {
+  for (uint32_t index = 0; index < 16; ++index) {
+    if (a->m[index] != b->m[index]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool Mat4CompareLoose(const Mat4 *a, const Mat4 *b, Real error) {
+  for (uint32_t index = 0; index < 16; ++index) {
+    if (FABS(a->m[index] - b->m[index]) >= error) {
+      return false;
+    }
+  }
+  return true;
+}
+
+Mat4 Mat4Transpose(const Mat4 *a) {
+  const Real *m = a->m;
+  return (Mat4){{m[0], m[4], m[8], m[12], m[1], m[5], m[9], m[13], m[2], m[6], m[10], m[14], m[3], m[7], m[11], m[15]}};
+}
+
+/*
+ * 2x2 minors of the upper (s) and lower (c) row pairs, shared by Mat4Determinant and Mat4Inverse.
+ * det = s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0
+ */
+#define MAT4_MINORS(m)                                                                                                                                                                                 \
+  const Real s0 = m[0] * m[5] - m[4] * m[1], s1 = m[0] * m[6] - m[4] * m[2], s2 = m[0] * m[7] - m[4] * m[3];                                                                                           \
+  const Real s3 = m[1] * m[6] - m[5] * m[2], s4 = m[1] * m[7] - m[5] * m[3], s5 = m[2] * m[7] - m[6] * m[3];                                                                                           \
+  const Real c5 = m[10] * m[15] - m[14] * m[11], c4 = m[9] * m[15] - m[13] * m[11], c3 = m[9] * m[14] - m[13] * m[10];                                                                                 \
+  const Real c2 = m[8] * m[15] - m[12] * m[11], c1 = m[8] * m[14] - m[12] * m[10], c0 = m[8] * m[13] - m[12] * m[9]
+
+Real Mat4Determinant(const Mat4 *a) {
+  const Real *m = a->m;
+  MAT4_MINORS(m);
+  return s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0;
+}
+
+Mat4 Mat4Inverse(const Mat4 *a) {
+  const Real *m = a->m;
+  MAT4_MINORS(m);
+  const Real d = 1 / (s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0);
+  return (Mat4){{(m[5] * c5 - m[6] * c4 + m[7] * c3) * d, (-m[1] * c5 + m[2] * c4 - m[3] * c3) * d, (m[13] * s5 - m[14] * s4 + m[15] * s3) * d, (-m[9] * s5 + m[10] * s4 - m[11] * s3) * d,
+                 (-m[4] * c5 + m[6] * c2 - m[7] * c1) * d, (m[0] * c5 - m[2] * c2 + m[3] * c1) * d, (-m[12] * s5 + m[14] * s2 - m[15] * s1) * d, (m[8] * s5 - m[10] * s2 + m[11] * s1) * d,
+                 (m[4] * c4 - m[5] * c2 + m[7] * c0) * d, (-m[0] * c4 + m[1] * c2 - m[3] * c0) * d, (m[12] * s4 - m[13] * s2 + m[15] * s0) * d, (-m[8] * s4 + m[9] * s2 - m[11] * s0) * d,
+                 (-m[4] * c3 + m[5] * c1 - m[6] * c0) * d, (m[0] * c3 - m[1] * c1 + m[2] * c0) * d, (-m[12] * s3 + m[13] * s1 - m[14] * s0) * d, (m[8] * s3 - m[9] * s1 + m[10] * s0) * d}};
+}
+
+#undef MAT4_MINORS
+
+Mat4 Mat4Multiplication(const Mat4 *a, const Mat4 *b) {
+  const Real *x = a->m, *y = b->m;
+  Mat4 new;
+  for (uint32_t row = 0; row < 4; ++row) {
+    const Real *r = &x[row * 4];
+    new.m[row * 4 + 0] = r[0] * y[0] + r[1] * y[4] + r[2] * y[8] + r[3] * y[12];
+    new.m[row * 4 + 1] = r[0] * y[1] + r[1] * y[5] + r[2] * y[9] + r[3] * y[13];
+    new.m[row * 4 + 2] = r[0] * y[2] + r[1] * y[6] + r[2] * y[10] + r[3] * y[14];
+    new.m[row * 4 + 3] = r[0] * y[3] + r[1] * y[7] + r[2] * y[11] + r[3] * y[15];
+  }
+  return new;
+}
+
+Vec4 Mat4TransformVec4(const Mat4 *a, const Vec4 v) {
+  const Real *m = a->m;
+  return (Vec4){m[0] * v.x + m[1] * v.y + m[2] * v.z + m[3] * v.w, m[4] * v.x + m[5] * v.y + m[6] * v.z + m[7] * v.w, m[8] * v.x + m[9] * v.y + m[10] * v.z + m[11] * v.w,
+                m[12] * v.x + m[13] * v.y + m[14] * v.z + m[15] * v.w};
+}
+
+Vec4 Mat4TransformPoint(const Mat4 *a, const Vector v) {
+  const Real *m = a->m;
+  return (Vec4){m[0] * v.x + m[1] * v.y + m[2] * v.z + m[3], m[4] * v.x + m[5] * v.y + m[6] * v.z + m[7], m[8] * v.x + m[9] * v.y + m[10] * v.z + m[11], m[12] * v.x + m[13] * v.y + m[14] * v.z + m[15]};
+}
+
+Vector Mat4TransformDirection(const Mat4 *a, const Vector v) {
+  const Real *m = a->m;
+  return (Vector){m[0] * v.x + m[1] * v.y + m[2] * v.z, m[4] * v.x + m[5] * v.y + m[6] * v.z, m[8] * v.x + m[9] * v.y + m[10] * v.z};
+}
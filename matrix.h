@@ -2,6 +2,7 @@
 #define RENDER_MATRIX_H
 
 #include "common.h"
+#include "vector.h"
 
 typedef struct tagMatrix {
   uint32_t rows;
@@ -9,6 +10,18 @@ typedef struct tagMatrix {
   Real *matrix; // {{1,2,3},{4,5,6},{7,8,9}} -> {1,2,3,4,5,6,7,8,9}
 } Matrix;
 
+/**
+ * Fixed-size 4x4 matrix for per-vertex transforms.
+ * Same row-major layout as Matrix but stored by value, so no heap allocation is involved.
+ */
+typedef struct tagMat4 {
+  Real m[16];
+} Mat4;
+
+typedef struct tagVec4 {
+  Real x, y, z, w;
+} Vec4;
+
 Matrix *MatrixZero(uint32_t rows, uint32_t columns);
 Matrix *MatrixFromArray(uint32_t rows, uint32_t columns, const Real array[rows][columns]);
 bool MatrixDestroy(Matrix *a);
@@ -34,4 +47,17 @@ Matrix *MatrixScalarSubtraction(const Matrix *a, Real value);
 Matrix *MatrixScalarMultiplication(const Matrix *a, Real value);
 Matrix *MatrixScalarDivision(const Matrix *a, Real value);
 
+Mat4 Mat4Identity(void);
+Mat4 Mat4FromArray(const Real array[4][4]);
+Matrix *Mat4ToMatrix(const Mat4 *a);
+bool Mat4Compare(const Mat4 *a, const Mat4 *b);
+bool Mat4CompareLoose(const Mat4 *a, const Mat4 *b, Real error);
+Mat4 Mat4Transpose(const Mat4 *a);
+Real Mat4Determinant(const Mat4 *a);
+Mat4 Mat4Inverse(const Mat4 *a);
+Mat4 Mat4Multiplication(const Mat4 *a, const Mat4 *b);
+Vec4 Mat4TransformVec4(const Mat4 *a, Vec4 v);
+Vec4 Mat4TransformPoint(const Mat4 *a, Vector v);      // (x, y, z, 1)
+Vector Mat4TransformDirection(const Mat4 *a, Vector v); // (x, y, z, 0)
+
 #endif // RENDER_MATRIX_H
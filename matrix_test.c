@@ -1,7 +1,11 @@
 #include <assert.h>
+#include <math.h>
 
 #include "matrix.h"
 
+// NOTE: Real may be float (RENDER_REAL=float) which can't hold large determinants exactly.
+#define ASSERT_REAL_EQUAL(a, b) assert(FABS((a) - (b)) <= FABS(b) * REAL_EPSILON * 8)
+
 int main() {
   {
     Matrix *a = MatrixZero(2, 3);
@@ -35,7 +39,7 @@ int main() {
     Matrix *a = MatrixFromArray(1, 1, _a);
     Real b = MatrixDeterminant(a);
     Real c = 13;
-    assert(b == c);
+    ASSERT_REAL_EQUAL(b, c);
     MatrixDestroy(a);
   }
   {
@@ -43,7 +47,7 @@ int main() {
     Matrix *a = MatrixFromArray(2, 2, _a);
     Real b = MatrixDeterminant(a);
     Real c = -4719;
-    assert(b == c);
+    ASSERT_REAL_EQUAL(b, c);
     MatrixDestroy(a);
   }
   {
@@ -51,7 +55,7 @@ int main() {
     Matrix *a = MatrixFromArray(3, 3, _a);
     Real b = MatrixDeterminant(a);
     Real c = -51011;
-    assert(b == c);
+    ASSERT_REAL_EQUAL(b, c);
     MatrixDestroy(a);
   }
   {
@@ -59,7 +63,7 @@ int main() {
     Matrix *a = MatrixFromArray(4, 4, _a);
     Real b = MatrixDeterminant(a);
     Real c = -71424;
-    assert(b == c);
+    ASSERT_REAL_EQUAL(b, c);
     MatrixDestroy(a);
   }
   {
@@ -67,7 +71,7 @@ int main() {
     Matrix *a = MatrixFromArray(5, 5, _a);
     Real b = MatrixDeterminant(a);
     Real c = 434893104;
-    assert(b == c);
+    ASSERT_REAL_EQUAL(b, c);
     MatrixDestroy(a);
   }
   {
@@ -209,4 +213,53 @@ int main() {
     MatrixDestroy(b);
     MatrixDestroy(z);
   }
+  {
+    Real _a[][4] = {{65, 63, 54, 92}, {79, 51, 18, 73}, {16, 38, 44, 55}, {39, 49, 1, 60}};
+    Mat4 a = Mat4FromArray(_a);
+    Real b = Mat4Determinant(&a);
+    Real c = -71424;
+    ASSERT_REAL_EQUAL(b, c);
+  }
+  {
+    Real _a[][4] = {{84, 61, 40, 20}, {66, 97, 36, 5}, {14, 84, 30, 17}, {34, 32, 66, 33}};
+    Mat4 a = Mat4FromArray(_a);
+    Mat4 b = Mat4Inverse(&a);
+    Real _z[][4] = {
+        {0.0165518, -0.0012969, -0.00842985, -0.00549223}, {-0.0011845, 0.00197605, 0.0128443, -0.0061983}, {-0.0345384, 0.034493, -0.0257954, 0.0289947}, {0.053172, -0.069566, 0.047821, -0.0160171}};
+    Mat4 z = Mat4FromArray(_z);
+    assert(Mat4CompareLoose(&b, &z, 0.01));
+    Mat4 c = Mat4Multiplication(&a, &b);
+    Mat4 i = Mat4Identity();
+    assert(Mat4CompareLoose(&c, &i, 0.0001));
+  }
+  {
+    Real _a[][4] = {{1, 2, 3, 4}, {5, 6, 7, 8}, {9, 10, 11, 12}, {13, 14, 15, 16}};
+    Real _b[][4] = {{17, 18, 19, 20}, {21, 22, 23, 24}, {25, 26, 27, 28}, {29, 30, 31, 32}};
+    Mat4 a = Mat4FromArray(_a);
+    Mat4 b = Mat4FromArray(_b);
+    Mat4 c = Mat4Multiplication(&a, &b);
+    Matrix *x = Mat4ToMatrix(&a);
+    Matrix *y = Mat4ToMatrix(&b);
+    Matrix *_c = MatrixMultiplication(x, y);
+    Matrix *d = Mat4ToMatrix(&c);
+    assert(MatrixCompareLoose(_c, d, 0.0001));
+    Mat4 e = Mat4Transpose(&a);
+    Real _z[][4] = {{1, 5, 9, 13}, {2, 6, 10, 14}, {3, 7, 11, 15}, {4, 8, 12, 16}};
+    Mat4 z = Mat4FromArray(_z);
+    assert(Mat4Compare(&e, &z));
+    MatrixDestroy(x);
+    MatrixDestroy(y);
+    MatrixDestroy(_c);
+    MatrixDestroy(d);
+  }
+  {
+    Real _a[][4] = {{2, 0, 0, 10}, {0, 3, 0, 20}, {0, 0, 4, 30}, {0, 0, 1, 0}};
+    Mat4 a = Mat4FromArray(_a);
+    Vec4 b = Mat4TransformPoint(&a, V(1, 1, 1));
+    assert(b.x == 12 && b.y == 23 && b.z == 34 && b.w == 1);
+    Vector c = Mat4TransformDirection(&a, V(1, 1, 1));
+    assert(c.x == 2 && c.y == 3 && c.z == 4);
+    Vec4 d = Mat4TransformVec4(&a, (Vec4){1, 1, 1, 0});
+    assert(d.x == 2 && d.y == 3 && d.z == 4 && d.w == 1);
+  }
 }
\ No newline at end of file
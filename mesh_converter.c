@@ -0,0 +1,58 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "polygon.h"
+
+/**
+ * Convert an STL file to the native mesh format: weld, calculate vertex normals, optionally reorder for the vertex cache and write the buffers to be mapped by
+ * PolygonReadMesh.
+ * usage: mesh_converter input.stl output.mesh [uniform|area|angle] [optimize]
+ */
+
+double _ConverterNow() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 3) {
+    fprintf(stderr, "usage: %s input.stl output.mesh [uniform|area|angle] [optimize]\n", argv[0]);
+    return 1;
+  }
+  NormalWeightingType weighting = UniformNormalWeighting;
+  bool optimize = false;
+  for (int argumentIndex = 3; argumentIndex < argc; ++argumentIndex) {
+    const char *weightings[] = {"uniform", "area", "angle"};
+    int i = 0;
+    while (i < 3 && strcmp(argv[argumentIndex], weightings[i]) != 0) {
+      ++i;
+    }
+    if (i < 3) {
+      weighting = (NormalWeightingType)i;
+    } else if (strcmp(argv[argumentIndex], "optimize") == 0) {
+      optimize = true;
+    } else {
+      fprintf(stderr, "unknown option: %s\n", argv[argumentIndex]);
+      return 1;
+    }
+  }
+
+  const double start = _ConverterNow();
+  Polygon *polygon = PolygonReadSTL(argv[1]);
+  if (polygon == NULL) {
+    return 1;
+  }
+  PolygonCalculateWeightedVertexNormals(polygon, weighting);
+  const double acmr = PolygonVertexCacheMissRatio(polygon, 32);
+  if (optimize) {
+    PolygonOptimizeVertexCache(polygon);
+    PolygonOptimizeVertexFetch(polygon);
+    printf("ACMR (FIFO 32) %.3f -> %.3f\n", acmr, PolygonVertexCacheMissRatio(polygon, 32));
+  }
+  const bool written = PolygonWriteMesh(polygon, argv[2]);
+  printf("%s: %llu triangles, %llu vertexes, converted in %.3f ms\n", argv[2], (unsigned long long)polygon->triangle, (unsigned long long)polygon->vertex, _ConverterNow() - start);
+  PolygonDestroy(polygon);
+  return written ? 0 : 1;
+}
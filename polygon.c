@@ -1,82 +1,895 @@
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 
-#include "hashdict/hashdict.h"
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 #include "polygon.h"
 
-Polygon *PolygonReadSTL(const char *filename) {
+#define POLYGON_BLOCKS 64     // blocks of the parallel passes, results depend neither on them nor on the number of threads
+#define POLYGON_RADIX_BITS 11 // digit of the radix sort
+#define POLYGON_PARALLEL_MINIMUM 65536
+
+typedef struct tagPolygonSortRecord {
+  uint32_t key;
+  uint32_t value;
+} PolygonSortRecord;
+
+FORCE_INLINE int _PolygonBlockCount(uint64_t count) { return count > POLYGON_PARALLEL_MINIMUM ? POLYGON_BLOCKS : 1; }
+
+FORCE_INLINE uint64_t _PolygonBlockStart(uint64_t count, int blocks, int blockIndex) { return count * (uint64_t)blockIndex / (uint64_t)blocks; }
+
+/**
+ * Stable LSD radix sort of records by key, up to maxKey.
+ * Each pass counts and scatters blocks of the records in parallel.
+ * @param buffer as large as records
+ * @return sorted records, either records or buffer
+ */
+PolygonSortRecord *_PolygonRadixSort(PolygonSortRecord *records, PolygonSortRecord *buffer, uint64_t count, uint32_t maxKey) {
+  const int blocks = _PolygonBlockCount(count);
+  uint32_t(*histograms)[1 << POLYGON_RADIX_BITS] = malloc(sizeof(uint32_t) * blocks * (1 << POLYGON_RADIX_BITS));
+  const uint32_t mask = (1 << POLYGON_RADIX_BITS) - 1;
+  for (uint32_t shift = 0; shift < 32 && (maxKey >> shift) != 0; shift += POLYGON_RADIX_BITS) {
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) if (count > POLYGON_PARALLEL_MINIMUM)
+#endif
+    for (int blockIndex = 0; blockIndex < blocks; ++blockIndex) {
+      uint32_t *histogram = histograms[blockIndex];
+      memset(histogram, 0, sizeof(histograms[0]));
+      for (uint64_t i = _PolygonBlockStart(count, blocks, blockIndex); i < _PolygonBlockStart(count, blocks, blockIndex + 1); ++i) {
+        ++histogram[(records[i].key >> shift) & mask];
+      }
+    }
+    uint32_t offset = 0;
+    for (uint32_t digit = 0; digit <= mask; ++digit) {
+      for (int blockIndex = 0; blockIndex < blocks; ++blockIndex) {
+        const uint32_t digitCount = histograms[blockIndex][digit];
+        histograms[blockIndex][digit] = offset;
+        offset += digitCount;
+      }
+    }
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) if (count > POLYGON_PARALLEL_MINIMUM)
+#endif
+    for (int blockIndex = 0; blockIndex < blocks; ++blockIndex) {
+      uint32_t *histogram = histograms[blockIndex];
+      for (uint64_t i = _PolygonBlockStart(count, blocks, blockIndex); i < _PolygonBlockStart(count, blocks, blockIndex + 1); ++i) {
+        buffer[histogram[(records[i].key >> shift) & mask]++] = records[i];
+      }
+    }
+    PolygonSortRecord *sorted = buffer;
+    buffer = records;
+    records = sorted;
+  }
+  free(histograms);
+  return records;
+}
+
+/**
+ * First run of equal keys starting in a block of sorted records: a run crossing the start of the block belongs to the previous one
+ */
+FORCE_INLINE uint64_t _PolygonBlockFirstRun(const PolygonSortRecord *sorted, uint64_t count, int blocks, int blockIndex) {
+  uint64_t i = _PolygonBlockStart(count, blocks, blockIndex);
+  const uint64_t blockEnd = _PolygonBlockStart(count, blocks, blockIndex + 1);
+  while (i > 0 && i < blockEnd && sorted[i].key == sorted[i - 1].key) {
+    ++i;
+  }
+  return i;
+}
+
+/**
+ * Position of a corner (3 per triangle), adding zero turns -0 into +0 so that both weld
+ */
+FORCE_INLINE void _PolygonCornerPosition(const STLTriangle *triangles, uint32_t corner, float position[3]) {
+  for (int i = 0; i < 3; ++i) {
+    position[i] = triangles[corner / 3].vertexes[corner % 3][i] + 0.0f;
+  }
+}
+
+FORCE_INLINE uint32_t _PolygonHashPosition(const float position[3]) {
+  uint32_t bits[3];
+  memcpy(bits, position, sizeof(bits));
+  uint32_t hash = 0x811c9dc5;
+  for (int i = 0; i < 3; ++i) {
+    hash = (hash ^ bits[i]) * 0x85ebca6b;
+    hash ^= hash >> 13;
+    hash *= 0xc2b2ae35;
+    hash ^= hash >> 16;
+  }
+  return hash;
+}
+
+/**
+ * Create an indexed polygon from STL triangles: vertexes with equal positions are welded in order of first occurrence.
+ * The corners are sorted by the hash of their position, then every run of equal hashes is split by position, all in parallel.
+ * The result does not depend on the number of threads, and the function is reentrant.
+ * @param triangles
+ * @param triangle number of triangles
+ * @return NULL if the polygon has too many vertexes to be indexed
+ */
+Polygon *PolygonCreateFromSTL(const STLTriangle *triangles, uint64_t triangle) {
+  const uint64_t corner = triangle * 3; // number of total vertexes
+  if (corner > UINT32_MAX) {
+    fprintf(stderr, "%s: too many vertexes (%llu)\n", __FUNCTION_NAME__, (unsigned long long)corner);
+    return NULL;
+  }
   Polygon *new = calloc(1, sizeof(Polygon));
-  FILE *fp = fopen(filename, "rb");
+  new->triangle = triangle;
+  new->positions = (float *)malloc((corner > 0 ? corner : 1) * 3 * sizeof(float));
+  new->surfaceNormals = (float *)malloc((triangle > 0 ? triangle : 1) * 3 * sizeof(float));
+  new->indices = (uint32_t *)malloc((corner > 0 ? corner : 1) * sizeof(uint32_t));
+  PolygonSortRecord *records = (PolygonSortRecord *)malloc((corner > 0 ? corner : 1) * sizeof(PolygonSortRecord));
+  PolygonSortRecord *buffer = (PolygonSortRecord *)malloc((corner > 0 ? corner : 1) * sizeof(PolygonSortRecord));
+  uint32_t *firsts = (uint32_t *)malloc((corner > 0 ? corner : 1) * sizeof(uint32_t)); // first corner with the same position
+  const bool parallel = corner > POLYGON_PARALLEL_MINIMUM;
+  const int blocks = _PolygonBlockCount(corner);
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) if (parallel)
+#endif
+  for (int64_t triangleIndex = 0; triangleIndex < (int64_t)triangle; ++triangleIndex) {
+    for (int i = 0; i < 3; ++i) {
+      new->surfaceNormals[triangleIndex * 3 + i] = triangles[triangleIndex].surfaceNormal[i];
+      float position[3];
+      _PolygonCornerPosition(triangles, (uint32_t)(triangleIndex * 3 + i), position);
+      records[triangleIndex * 3 + i] = (PolygonSortRecord){_PolygonHashPosition(position), (uint32_t)(triangleIndex * 3 + i)};
+    }
+  }
+  const PolygonSortRecord *sorted = _PolygonRadixSort(records, buffer, corner, UINT32_MAX);
+
+  // runs of equal hashes hold corners in ascending order, as the sort is stable
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic) if (parallel)
+#endif
+  for (int blockIndex = 0; blockIndex < blocks; ++blockIndex) {
+    const uint64_t blockEnd = _PolygonBlockStart(corner, blocks, blockIndex + 1);
+    uint32_t distinct[8]; // first corners of the distinct positions of a run, hashes rarely collide
+    for (uint64_t runStart = _PolygonBlockFirstRun(sorted, corner, blocks, blockIndex), runEnd; runStart < blockEnd; runStart = runEnd) {
+      uint32_t distinctCount = 0;
+      for (runEnd = runStart; runEnd < corner && sorted[runEnd].key == sorted[runStart].key; ++runEnd) {
+        const uint32_t c = sorted[runEnd].value;
+        float position[3];
+        _PolygonCornerPosition(triangles, c, position);
+        firsts[c] = c;
+        const uint32_t searched = distinctCount < 8 ? distinctCount : (uint32_t)(runEnd - runStart); // past 8, search the whole run
+        for (uint32_t i = 0; i < searched; ++i) {
+          const uint32_t candidate = distinctCount < 8 ? distinct[i] : sorted[runStart + i].value;
+          float candidatePosition[3];
+          _PolygonCornerPosition(triangles, candidate, candidatePosition);
+          if (firsts[candidate] == candidate && memcmp(position, candidatePosition, sizeof(position)) == 0) {
+            firsts[c] = candidate;
+            break;
+          }
+        }
+        if (firsts[c] == c && distinctCount < 8) {
+          distinct[distinctCount] = c;
+        }
+        distinctCount += firsts[c] == c;
+      }
+    }
+  }
+  free(buffer);
+  free(records);
+
+  // number the first corners in order, then point the others to them
+  uint64_t vertexOffsets[POLYGON_BLOCKS + 1] = {0};
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) if (parallel)
+#endif
+  for (int blockIndex = 0; blockIndex < blocks; ++blockIndex) {
+    uint64_t count = 0;
+    for (uint64_t c = _PolygonBlockStart(corner, blocks, blockIndex); c < _PolygonBlockStart(corner, blocks, blockIndex + 1); ++c) {
+      count += firsts[c] == c;
+    }
+    vertexOffsets[blockIndex + 1] = count;
+  }
+  for (int blockIndex = 0; blockIndex < blocks; ++blockIndex) {
+    vertexOffsets[blockIndex + 1] += vertexOffsets[blockIndex];
+  }
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) if (parallel)
+#endif
+  for (int blockIndex = 0; blockIndex < blocks; ++blockIndex) {
+    uint32_t next = (uint32_t)vertexOffsets[blockIndex];
+    for (uint64_t c = _PolygonBlockStart(corner, blocks, blockIndex); c < _PolygonBlockStart(corner, blocks, blockIndex + 1); ++c) {
+      if (firsts[c] == c) {
+        _PolygonCornerPosition(triangles, (uint32_t)c, &new->positions[(uint64_t)next * 3]);
+        new->indices[c] = next++;
+      }
+    }
+  }
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) if (parallel)
+#endif
+  for (int64_t c = 0; c < (int64_t)corner; ++c) {
+    if (firsts[c] != (uint32_t)c) {
+      new->indices[c] = new->indices[firsts[c]];
+    }
+  }
+  free(firsts);
+
+  const uint64_t vertex = vertexOffsets[blocks];
+  new->vertex = vertex;
+  new->positions = (float *)realloc(new->positions, (vertex > 0 ? vertex : 1) * 3 * sizeof(float));
+  new->normals = (float *)calloc((vertex > 0 ? vertex : 1) * 3, sizeof(float));
+  PolygonCalculateBoundingSphere(new);
+  return new;
+}
+
+/**
+ * Map a whole file, read-only for sequential parsing or copy-on-write for buffers used in place.
+ * @return NULL if the file can't be opened, is empty or can't be mapped, must be released by _PolygonUnmapFile
+ */
+void *_PolygonMapFile(const char *filename, uint64_t *size, bool copyOnWrite) {
+  void *mapping = NULL;
+  *size = 0;
+#ifdef _WIN32
+  HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+  if (file == INVALID_HANDLE_VALUE) {
+    fprintf(stderr, "%s: can't open %s\n", __FUNCTION_NAME__, filename);
+    return NULL;
+  }
+  LARGE_INTEGER fileSize;
+  if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0) {
+    *size = (uint64_t)fileSize.QuadPart;
+    HANDLE fileMapping = CreateFileMappingA(file, NULL, copyOnWrite ? PAGE_WRITECOPY : PAGE_READONLY, 0, 0, NULL);
+    if (fileMapping != NULL) {
+      mapping = MapViewOfFile(fileMapping, copyOnWrite ? FILE_MAP_COPY : FILE_MAP_READ, 0, 0, 0);
+      CloseHandle(fileMapping);
+    }
+  }
+  CloseHandle(file);
+#else
+  const int fd = open(filename, O_RDONLY);
+  if (fd < 0) {
+    fprintf(stderr, "%s: can't open %s\n", __FUNCTION_NAME__, filename);
+    return NULL;
+  }
+  struct stat st;
+  if (fstat(fd, &st) == 0 && st.st_size > 0) {
+    *size = (uint64_t)st.st_size;
+    mapping = mmap(NULL, (size_t)*size, copyOnWrite ? PROT_READ | PROT_WRITE : PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapping == MAP_FAILED) {
+      mapping = NULL;
+    } else if (!copyOnWrite) {
+      madvise(mapping, (size_t)*size, MADV_SEQUENTIAL);
+    }
+  }
+  close(fd);
+#endif
+  if (mapping == NULL) {
+    fprintf(stderr, "%s: can't map %s (%llu bytes)\n", __FUNCTION_NAME__, filename, (unsigned long long)*size);
+  }
+  return mapping;
+}
+
+void _PolygonUnmapFile(void *mapping, uint64_t size) {
+#ifdef _WIN32
+  UNUSED(size);
+  UnmapViewOfFile(mapping);
+#else
+  munmap(mapping, (size_t)size);
+#endif
+}
+
+/**
+ * Number of triangles of a binary STL file, if the file is long enough for it
+ * @return false if the file is truncated
+ */
+bool _PolygonBinarySTLTriangles(const void *mapping, uint64_t size, uint32_t *triangle) {
+  if (size < STL_HEADER_SIZE) {
+    return false;
+  }
+  memcpy(triangle, (const uint8_t *)mapping + 80, sizeof(*triangle));
+  return (uint64_t)*triangle * sizeof(STLTriangle) <= size - STL_HEADER_SIZE;
+}
+
+/**
+ * Map a binary STL file read-only and validate its triangle count against the file size.
+ * Trailing bytes after the last record are ignored.
+ * @param filename
+ * @return NULL if the file can't be mapped or is truncated, must be released by PolygonUnmapSTL
+ */
+STLView *PolygonMapSTL(const char *filename) {
+  uint64_t size;
+  void *mapping = _PolygonMapFile(filename, &size, false);
+  if (mapping == NULL) {
+    return NULL;
+  }
+  uint32_t triangle = 0;
+  if (!_PolygonBinarySTLTriangles(mapping, size, &triangle)) {
+    fprintf(stderr, "%s: %s is truncated (%u triangles in %llu bytes)\n", __FUNCTION_NAME__, filename, triangle, (unsigned long long)size);
+    _PolygonUnmapFile(mapping, size);
+    return NULL;
+  }
+#ifndef NDEBUG
+  if ((uint64_t)triangle * sizeof(STLTriangle) < size - STL_HEADER_SIZE) {
+    fprintf(stderr, "%s: %s has trailing bytes, ignored.\n", __FUNCTION_NAME__, filename);
+  }
+#endif
+
+  STLView *new = calloc(1, sizeof(STLView));
+  new->triangle = triangle;
+  new->triangles = (const STLTriangle *)((const uint8_t *)mapping + STL_HEADER_SIZE);
+  new->mapping = mapping;
+  new->size = size;
+  return new;
+}
+
+bool PolygonUnmapSTL(STLView *view) {
+  if (view == NULL) {
+#ifndef NDEBUG
+    fprintf(stderr, "%s: trying to free null pointer, ignored.\n", __FUNCTION_NAME__);
+#endif
+    return false;
+  }
+  _PolygonUnmapFile(view->mapping, view->size);
+  free(view);
+  return true;
+}
+
+FORCE_INLINE bool _STLIsSpace(char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f'; }
+
+/**
+ * Next whitespace-separated token of an ASCII STL file
+ * @return length of the token, 0 at the end of the text
+ */
+FORCE_INLINE size_t _STLNextToken(const char **cursor, const char *end, const char **token) {
+  const char *p = *cursor;
+  while (p < end && _STLIsSpace(*p)) {
+    ++p;
+  }
+  *token = p;
+  while (p < end && !_STLIsSpace(*p)) {
+    ++p;
+  }
+  *cursor = p;
+  return (size_t)(p - *token);
+}
+
+FORCE_INLINE bool _STLExpectToken(const char **cursor, const char *end, const char *keyword) {
+  const char *token;
+  const size_t length = _STLNextToken(cursor, end, &token);
+  return length == strlen(keyword) && memcmp(token, keyword, length) == 0;
+}
+
+/**
+ * Parse 3 numbers. The mapped text is not terminated, so every token is copied before strtof.
+ */
+bool _STLParseFloats(const char **cursor, const char *end, float values[3]) {
+  for (int i = 0; i < 3; ++i) {
+    const char *token;
+    char buffer[64];
+    const size_t length = _STLNextToken(cursor, end, &token);
+    if (length == 0 || length >= sizeof(buffer)) {
+      return false;
+    }
+    memcpy(buffer, token, length);
+    buffer[length] = '\0';
+    char *parsed;
+    values[i] = strtof(buffer, &parsed);
+    if (parsed != buffer + length) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * Parse one facet, from just after its "facet" keyword
+ */
+bool _STLParseFacet(const char **cursor, const char *end, STLTriangle *triangle) {
+  if (!_STLExpectToken(cursor, end, "normal") || !_STLParseFloats(cursor, end, triangle->surfaceNormal) || !_STLExpectToken(cursor, end, "outer") ||
+      !_STLExpectToken(cursor, end, "loop")) {
+    return false;
+  }
+  for (int vertexIndex = 0; vertexIndex < 3; ++vertexIndex) {
+    if (!_STLExpectToken(cursor, end, "vertex") || !_STLParseFloats(cursor, end, triangle->vertexes[vertexIndex])) {
+      return false;
+    }
+  }
+  triangle->attribute = 0;
+  return _STLExpectToken(cursor, end, "endloop") && _STLExpectToken(cursor, end, "endfacet");
+}
+
+/**
+ * Whether the token at cursor starts a facet: "facet" followed by "normal", so that solid names are not mistaken for facets
+ */
+FORCE_INLINE bool _STLIsFacet(const char *token, size_t length, const char *cursor, const char *end) {
+  if (length != 5 || memcmp(token, "facet", 5) != 0) {
+    return false;
+  }
+  return _STLExpectToken(&cursor, end, "normal");
+}
+
+#define STL_ASCII_CHUNK_SIZE (1 << 20)
+
+/**
+ * First token boundary of a chunk of an ASCII STL file: a token crossing the start of the chunk belongs to the previous one
+ */
+FORCE_INLINE const char *_STLChunk(const char *text, uint64_t size, uint64_t chunkIndex, const char **chunkEnd) {
+  const uint64_t start = chunkIndex * STL_ASCII_CHUNK_SIZE;
+  *chunkEnd = text + (size - start > STL_ASCII_CHUNK_SIZE ? start + STL_ASCII_CHUNK_SIZE : size);
+  const char *cursor = text + start;
+  while (cursor > text && cursor < *chunkEnd && !_STLIsSpace(cursor[-1])) {
+    ++cursor;
+  }
+  return cursor;
+}
+
+/**
+ * Whether the last line of an ASCII STL file is "endsolid [name]", so that truncated files and binary ones starting with "solid" are told apart
+ */
+bool _STLHasEnd(const char *text, uint64_t size) {
+  const char *end = text + size;
+  while (end > text && _STLIsSpace(end[-1])) {
+    --end;
+  }
+  const char *line = end;
+  while (line > text && line[-1] != '\n' && line[-1] != '\r') {
+    --line;
+  }
+  return _STLExpectToken(&line, end, "endsolid");
+}
+
+/**
+ * Parse an ASCII STL file in chunks of STL_ASCII_CHUNK_SIZE bytes, in parallel.
+ * A facet belongs to the chunk holding its "facet" keyword: the facets of every chunk are counted first, then parsed into their place, so the order is the one of the file.
+ * @return NULL if a facet is malformed or the file is truncated, must be freed by caller
+ */
+STLTriangle *_PolygonParseASCIISTL(const char *text, uint64_t size, uint64_t *triangle) {
+  const char *end = text + size;
+  if (!_STLHasEnd(text, size)) {
+    return NULL;
+  }
+  const int64_t chunkCount = (int64_t)((size + STL_ASCII_CHUNK_SIZE - 1) / STL_ASCII_CHUNK_SIZE);
+  uint64_t *offsets = (uint64_t *)calloc(chunkCount + 1, sizeof(uint64_t));
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic) if (chunkCount > 1)
+#endif
+  for (int64_t chunkIndex = 0; chunkIndex < chunkCount; ++chunkIndex) {
+    const char *chunkEnd, *token;
+    const char *cursor = _STLChunk(text, size, (uint64_t)chunkIndex, &chunkEnd);
+    size_t length;
+    uint64_t facets = 0;
+    while ((length = _STLNextToken(&cursor, end, &token)) > 0 && token < chunkEnd) {
+      facets += _STLIsFacet(token, length, cursor, end);
+    }
+    offsets[chunkIndex + 1] = facets;
+  }
+  for (int64_t chunkIndex = 0; chunkIndex < chunkCount; ++chunkIndex) {
+    offsets[chunkIndex + 1] += offsets[chunkIndex];
+  }
+
+  *triangle = offsets[chunkCount];
+  STLTriangle *triangles = (STLTriangle *)malloc((*triangle > 0 ? *triangle : 1) * sizeof(STLTriangle));
+  bool valid = true;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic) reduction(&& : valid) if (chunkCount > 1)
+#endif
+  for (int64_t chunkIndex = 0; chunkIndex < chunkCount; ++chunkIndex) {
+    const char *chunkEnd, *token;
+    const char *cursor = _STLChunk(text, size, (uint64_t)chunkIndex, &chunkEnd);
+    size_t length;
+    uint64_t next = offsets[chunkIndex];
+    while ((length = _STLNextToken(&cursor, end, &token)) > 0 && token < chunkEnd) {
+      if (_STLIsFacet(token, length, cursor, end)) {
+        valid = _STLParseFacet(&cursor, end, &triangles[next++]) && valid;
+      }
+    }
+  }
+  free(offsets);
+
+  if (!valid) {
+    free(triangles);
+    return NULL;
+  }
+  return triangles;
+}
+
+/**
+ * Read an ASCII or binary STL file.
+ * Binary records are welded straight from the mapped file, without an intermediate copy, ASCII files are parsed in parallel.
+ * Binary files may also start with "solid": the ASCII parser is only tried if the size does not match the binary triangle count.
+ * @param filename
+ * @return NULL if the file can't be read, is truncated or malformed
+ */
+Polygon *PolygonReadSTL(const char *filename) {
+  uint64_t size;
+  void *mapping = _PolygonMapFile(filename, &size, false);
+  if (mapping == NULL) {
+    return NULL;
+  }
+  uint32_t binaryTriangle = 0;
+  const bool binary = _PolygonBinarySTLTriangles(mapping, size, &binaryTriangle);
+  Polygon *new = NULL;
+  if (size >= 5 && memcmp(mapping, "solid", 5) == 0 && !(binary && (uint64_t)binaryTriangle * sizeof(STLTriangle) == size - STL_HEADER_SIZE)) {
+    uint64_t triangle;
+    STLTriangle *triangles = _PolygonParseASCIISTL((const char *)mapping, size, &triangle);
+    if (triangles != NULL && (triangle > 0 || !binary)) {
+      new = PolygonCreateFromSTL(triangles, triangle);
+      free(triangles);
+      _PolygonUnmapFile(mapping, size);
+      return new;
+    }
+    free(triangles);
+  }
+  if (binary) {
+    new = PolygonCreateFromSTL((const STLTriangle *)((const uint8_t *)mapping + STL_HEADER_SIZE), binaryTriangle);
+  } else {
+    fprintf(stderr, "%s: %s is neither a valid ASCII nor binary STL file (%llu bytes)\n", __FUNCTION_NAME__, filename, (unsigned long long)size);
+  }
+  _PolygonUnmapFile(mapping, size);
+  return new;
+}
+
+FORCE_INLINE uint64_t _PolygonMeshAlign(uint64_t offset) { return (offset + POLYGON_MESH_ALIGNMENT - 1) / POLYGON_MESH_ALIGNMENT * POLYGON_MESH_ALIGNMENT; }
+
+/**
+ * Layout of the buffers of a mesh file after its header
+ */
+void _PolygonMeshLayout(PolygonMeshHeader *header) {
+  header->positionsOffset = _PolygonMeshAlign(sizeof(PolygonMeshHeader));
+  header->normalsOffset = _PolygonMeshAlign(header->positionsOffset + header->vertex * 3 * sizeof(float));
+  header->surfaceNormalsOffset = _PolygonMeshAlign(header->normalsOffset + header->vertex * 3 * sizeof(float));
+  header->indicesOffset = _PolygonMeshAlign(header->surfaceNormalsOffset + header->triangle * 3 * sizeof(float));
+  header->size = header->indicesOffset + header->triangle * 3 * sizeof(uint32_t);
+}
+
+/**
+ * Write the polygon in the native mesh format, to be mapped by PolygonReadMesh without parsing.
+ * @param polygon
+ * @param filename
+ * @return
+ */
+bool PolygonWriteMesh(const Polygon *polygon, const char *filename) {
+  if (polygon->quantizedPositions != NULL) {
+    fprintf(stderr, "%s: quantized polygons can't be written, %s is not created\n", __FUNCTION_NAME__, filename);
+    return false;
+  }
+  FILE *fp = fopen(filename, "wb");
   if (fp == NULL) {
     fprintf(stderr, "%s: can't open %s\n", __FUNCTION_NAME__, filename);
+    return false;
+  }
+  PolygonMeshHeader header = {.magic = POLYGON_MESH_MAGIC,
+                              .version = POLYGON_MESH_VERSION,
+                              .endianness = POLYGON_MESH_ENDIANNESS,
+                              .headerSize = sizeof(PolygonMeshHeader),
+                              .triangle = polygon->triangle,
+                              .vertex = polygon->vertex};
+  _PolygonMeshLayout(&header);
+  header.boundingCenter[0] = (double)polygon->boundingCenter.x;
+  header.boundingCenter[1] = (double)polygon->boundingCenter.y;
+  header.boundingCenter[2] = (double)polygon->boundingCenter.z;
+  header.boundingRadius = (double)polygon->boundingRadius;
+
+  const struct {
+    uint64_t offset;
+    const void *buffer;
+    uint64_t size;
+  } sections[4] = {{header.positionsOffset, polygon->positions, polygon->vertex * 3 * sizeof(float)},
+                   {header.normalsOffset, polygon->normals, polygon->vertex * 3 * sizeof(float)},
+                   {header.surfaceNormalsOffset, polygon->surfaceNormals, polygon->triangle * 3 * sizeof(float)},
+                   {header.indicesOffset, polygon->indices, polygon->triangle * 3 * sizeof(uint32_t)}};
+  const uint8_t padding[POLYGON_MESH_ALIGNMENT] = {0};
+  bool written = fwrite(&header, sizeof(header), 1, fp) == 1;
+  uint64_t offset = sizeof(header);
+  for (int i = 0; i < 4 && written; ++i) {
+    written = fwrite(padding, 1, sections[i].offset - offset, fp) == sections[i].offset - offset && fwrite(sections[i].buffer, 1, sections[i].size, fp) == sections[i].size;
+    offset = sections[i].offset + sections[i].size;
+  }
+  written = fclose(fp) == 0 && written;
+  if (!written) {
+    fprintf(stderr, "%s: can't write %s\n", __FUNCTION_NAME__, filename);
+  }
+  return written;
+}
+
+/**
+ * Map a file of the native mesh format: the buffers of the polygon point into the copy-on-write mapping, nothing is parsed or copied.
+ * The header and the indices are validated, so that a corrupted file can't make the renderer read out of bounds.
+ * @param filename
+ * @return NULL if the file can't be mapped or is invalid
+ */
+Polygon *PolygonReadMesh(const char *filename) {
+  uint64_t size;
+  uint8_t *mapping = _PolygonMapFile(filename, &size, true);
+  if (mapping == NULL) {
+    return NULL;
+  }
+  PolygonMeshHeader header;
+  bool valid = size >= sizeof(header);
+  if (valid) {
+    memcpy(&header, mapping, sizeof(header));
+    PolygonMeshHeader layout = header;
+    _PolygonMeshLayout(&layout);
+    valid = memcmp(header.magic, POLYGON_MESH_MAGIC, sizeof(header.magic)) == 0 && header.version == POLYGON_MESH_VERSION && header.endianness == POLYGON_MESH_ENDIANNESS &&
+            header.headerSize == sizeof(header) && header.triangle <= UINT32_MAX / 3 && header.vertex <= header.triangle * 3 && header.size == size &&
+            memcmp(&header, &layout, sizeof(header)) == 0;
+  }
+  if (!valid) {
+    fprintf(stderr, "%s: %s is not a valid mesh file (version %d)\n", __FUNCTION_NAME__, filename, POLYGON_MESH_VERSION);
+    _PolygonUnmapFile(mapping, size);
+    return NULL;
+  }
+
+  const uint32_t *indices = (const uint32_t *)(mapping + header.indicesOffset);
+  const int64_t corner = (int64_t)header.triangle * 3;
+  bool inRange = true;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) reduction(&& : inRange) if (corner > POLYGON_PARALLEL_MINIMUM)
+#endif
+  for (int64_t c = 0; c < corner; ++c) {
+    inRange = indices[c] < header.vertex && inRange;
+  }
+  if (!inRange) {
+    fprintf(stderr, "%s: %s has indices out of range\n", __FUNCTION_NAME__, filename);
+    _PolygonUnmapFile(mapping, size);
     return NULL;
   }
-  fseek(fp, 80, SEEK_CUR);         // skip STL header
-  fread(&new->triangle, 4, 1, fp); // read number of triangles
-  new->triangles = (Triangle *)calloc(new->triangle, sizeof(Triangle));
-  STLTriangle *t = calloc(new->triangle, sizeof(STLTriangle));
-  fread(t, sizeof(STLTriangle), new->triangle, fp); // read triangles
-  for (uint64_t i = 0; i < new->triangle; ++i) {
-    new->triangles[i].surfaceNormal = (Vector){t[i].surfaceNormal[0], t[i].surfaceNormal[1], t[i].surfaceNormal[2]};
-    new->triangles[i].vertexes[0] = (Vector){t[i].vertexes[0][0], t[i].vertexes[0][1], t[i].vertexes[0][2]};
-    new->triangles[i].vertexes[1] = (Vector){t[i].vertexes[1][0], t[i].vertexes[1][1], t[i].vertexes[1][2]};
-    new->triangles[i].vertexes[2] = (Vector){t[i].vertexes[2][0], t[i].vertexes[2][1], t[i].vertexes[2][2]};
-  }
-  free(t);
-  fclose(fp);
+
+  Polygon *new = calloc(1, sizeof(Polygon));
+  new->triangle = header.triangle;
+  new->vertex = header.vertex;
+  new->positions = (float *)(mapping + header.positionsOffset);
+  new->normals = (float *)(mapping + header.normalsOffset);
+  new->surfaceNormals = (float *)(mapping + header.surfaceNormalsOffset);
+  new->indices = (uint32_t *)(mapping + header.indicesOffset);
+  new->boundingCenter = V(header.boundingCenter[0], header.boundingCenter[1], header.boundingCenter[2]);
+  new->boundingRadius = header.boundingRadius;
+  new->mapping = mapping;
+  new->mappingSize = size;
   return new;
 }
 
 /**
- * Calculate vertex normals
- * Warning: This function is NOT thread safe!
+ * Calculate vertex normals with the surface normals of the triangles given by the source (UniformNormalWeighting).
  * @param polygon
  * @return
  */
-bool PolygonCalculateVertexNormals(Polygon *polygon) {
-  const uint64_t triangle = polygon->triangle; // number of triangles
-  const uint64_t vertex = triangle * 3;        // number of total vertexes
-  Vector *vertexNormals = (Vector *)calloc(vertex, sizeof(Vector));
-  struct dictionary *dic = dic_new(vertex);
-
-  // accumulate surface normal vectors
-  uint64_t a = 0;
-  for (uint64_t triangleIndex = 0; triangleIndex < triangle; ++triangleIndex) {
-    Triangle *t = &polygon->triangles[triangleIndex];
-    for (uint64_t vertexIndex = 0; vertexIndex < 3; ++vertexIndex) {
-      Vector v = t->vertexes[vertexIndex];
-      if (dic_add(dic, &v, sizeof(Vector))) {
-        const uint64_t foo = *dic->value;
-        vertexNormals[foo] = VectorAddition(vertexNormals[foo], t->surfaceNormal);
-      } else {
-        *dic->value = a;
-        vertexNormals[a] = t->surfaceNormal;
-        ++a;
-      }
+bool PolygonCalculateVertexNormals(Polygon *polygon) { return PolygonCalculateWeightedVertexNormals(polygon, UniformNormalWeighting); }
+
+/**
+ * Octahedral encoding of a unit vector into 2 snorm16, the inverse of _PolygonDecodeOctahedral.
+ * The 4 neighbouring grid points are decoded and the closest one to the vector is kept, which bounds the error by about 0.0025 degrees.
+ * @return squared sine of the angle between the vector and its encoding (the cosine rounds to 1 in float)
+ */
+Real _PolygonEncodeOctahedral(Vector n, int16_t encoded[2]) {
+  const Real l1 = FABS(n.x) + FABS(n.y) + FABS(n.z);
+  encoded[0] = encoded[1] = 0;
+  if (l1 == 0) {
+    return 0;
+  }
+  Real x = n.x / l1, y = n.y / l1;
+  if (n.z < 0) {
+    const Real foldedX = (1 - FABS(y)) * (x >= 0 ? 1 : -1);
+    y = (1 - FABS(x)) * (y >= 0 ? 1 : -1);
+    x = foldedX;
+  }
+  const Vector unit = VectorScalarDivision(n, SQRT(n.x * n.x + n.y * n.y + n.z * n.z));
+  const Real baseX = FLOOR(x * INT16_MAX), baseY = FLOOR(y * INT16_MAX);
+  Real bestSine = REAL_MAX;
+  for (int i = 0; i < 4; ++i) {
+    const Real candidateX = baseX + (i & 1), candidateY = baseY + (i >> 1);
+    const int16_t candidate[2] = {(int16_t)(candidateX > INT16_MAX ? INT16_MAX : candidateX < -INT16_MAX ? -INT16_MAX : candidateX),
+                                  (int16_t)(candidateY > INT16_MAX ? INT16_MAX : candidateY < -INT16_MAX ? -INT16_MAX : candidateY)};
+    const Vector decoded = _PolygonDecodeOctahedral(candidate);
+    const Vector cross = V(decoded.y * unit.z - decoded.z * unit.y, decoded.z * unit.x - decoded.x * unit.z, decoded.x * unit.y - decoded.y * unit.x);
+    const Real sine = cross.x * cross.x + cross.y * cross.y + cross.z * cross.z;
+    if (sine < bestSine) {
+      bestSine = sine;
+      encoded[0] = candidate[0];
+      encoded[1] = candidate[1];
     }
   }
+  return bestSine;
+}
 
-  // set vertex normal vectors
-  for (uint64_t triangleIndex = 0; triangleIndex < triangle; ++triangleIndex) {
-    Triangle *t = &polygon->triangles[triangleIndex];
-    for (uint64_t vertexIndex = 0; vertexIndex < 3; ++vertexIndex) {
-      Vector v = t->vertexes[vertexIndex];
-      if (dic_find(dic, &v, sizeof(Vector))) {
-        const uint64_t foo = *dic->value;
-        t->vertexNormals[vertexIndex] = VectorL2Normalization(vertexNormals[foo]);
-      } else {
-#ifndef NDEBUG
-        fprintf(stderr, "%s: accumulated surface normal vector does not exist, may be bug.\n", __FUNCTION_NAME__);
+/**
+ * Normal of a triangle weighted for one of its corners
+ */
+FORCE_INLINE Vector _PolygonCornerNormal(const Polygon *polygon, uint64_t corner, NormalWeightingType weighting) {
+  const uint64_t triangleIndex = corner / 3;
+  if (weighting == UniformNormalWeighting) {
+    const float *n = &polygon->surfaceNormals[triangleIndex * 3];
+    return V(n[0], n[1], n[2]);
+  }
+  const uint32_t *indices = &polygon->indices[triangleIndex * 3];
+  const Vector v0 = PolygonGetPosition(polygon, indices[corner % 3]), v1 = PolygonGetPosition(polygon, indices[(corner + 1) % 3]),
+               v2 = PolygonGetPosition(polygon, indices[(corner + 2) % 3]);
+  const Vector e1 = VectorSubtraction(v1, v0), e2 = VectorSubtraction(v2, v0);
+  const Vector cross = VectorCrossProduct(e1, e2); // length is twice the area
+  if (weighting == AreaNormalWeighting) {
+    return cross;
+  }
+  const Real length = VectorEuclideanNorm(cross);
+  if (length == 0) {
+    return V0;
+  }
+  return VectorScalarMultiplication(cross, ATAN2(length, VectorDotProduct(e1, e2)) / length);
+}
+
+/**
+ * Calculate vertex normals: the normalized sum of the weighted normals of the triangles sharing a vertex.
+ * Area and angle weighting use the winding of the triangles (counterclockwise is the front), uniform weighting the surface normals of the source.
+ * Every vertex sums the normals of its corners in ascending order, through a vertex to corner adjacency, so the result does not depend on the number of threads.
+ * @param polygon
+ * @param weighting
+ * @return
+ */
+bool PolygonCalculateWeightedVertexNormals(Polygon *polygon, NormalWeightingType weighting) {
+  const uint64_t corner = polygon->triangle * 3, vertex = polygon->vertex;
+
+  // corners of every vertex, in ascending order
+  uint32_t *valences = (uint32_t *)calloc(vertex > 0 ? vertex : 1, sizeof(uint32_t));
+  uint64_t *offsets = (uint64_t *)malloc((vertex + 1) * sizeof(uint64_t));
+  uint64_t *adjacency = (uint64_t *)malloc((corner > 0 ? corner : 1) * sizeof(uint64_t));
+  for (uint64_t c = 0; c < corner; ++c) {
+    ++valences[polygon->indices[c]];
+  }
+  offsets[0] = 0;
+  for (uint64_t v = 0; v < vertex; ++v) {
+    offsets[v + 1] = offsets[v] + valences[v];
+    valences[v] = 0;
+  }
+  for (uint64_t c = 0; c < corner; ++c) {
+    const uint32_t v = polygon->indices[c];
+    adjacency[offsets[v] + valences[v]++] = c;
+  }
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) if (corner > POLYGON_PARALLEL_MINIMUM)
 #endif
-      }
+  for (int64_t vertexIndex = 0; vertexIndex < (int64_t)vertex; ++vertexIndex) {
+    // accumulate weighted normal vectors
+    Vector sum = V0;
+    for (uint64_t i = offsets[vertexIndex]; i < offsets[vertexIndex + 1]; ++i) {
+      sum = VectorAddition(sum, _PolygonCornerNormal(polygon, adjacency[i], weighting));
+    }
+
+    // set vertex normal vector
+    const Vector n = VectorL2Normalization(sum);
+    if (polygon->quantizedNormals != NULL) {
+      _PolygonEncodeOctahedral(n, &polygon->quantizedNormals[vertexIndex * 2]);
+      continue;
     }
+    polygon->normals[vertexIndex * 3 + 0] = (float)n.x;
+    polygon->normals[vertexIndex * 3 + 1] = (float)n.y;
+    polygon->normals[vertexIndex * 3 + 2] = (float)n.z;
   }
+  free(adjacency);
+  free(offsets);
+  free(valences);
+  return true;
+}
 
-  dic_delete(dic);
-  free(vertexNormals);
+/**
+ * Calculate the bounding sphere of the polygon: the center of its bounding box and the farthest vertex from it.
+ * Call again after modifying the vertexes.
+ */
+bool PolygonCalculateBoundingSphere(Polygon *polygon) {
+  Vector min = V(REAL_MAX, REAL_MAX, REAL_MAX), max = V(-REAL_MAX, -REAL_MAX, -REAL_MAX);
+  for (uint32_t vertexIndex = 0; vertexIndex < polygon->vertex; ++vertexIndex) {
+    const Vector v = PolygonGetPosition(polygon, vertexIndex);
+    min = V(FMIN(min.x, v.x), FMIN(min.y, v.y), FMIN(min.z, v.z));
+    max = V(FMAX(max.x, v.x), FMAX(max.y, v.y), FMAX(max.z, v.z));
+  }
+  if (polygon->vertex == 0) {
+    polygon->boundingCenter = V0;
+    polygon->boundingRadius = 0;
+    return false;
+  }
+
+  polygon->boundingCenter = VectorScalarMultiplication(VectorAddition(min, max), 0.5);
+  Real radius = 0;
+  for (uint32_t vertexIndex = 0; vertexIndex < polygon->vertex; ++vertexIndex) {
+    radius = FMAX(radius, VectorEuclideanDistance(polygon->boundingCenter, PolygonGetPosition(polygon, vertexIndex)));
+  }
+  polygon->boundingRadius = radius;
+  return true;
+}
+
+/**
+ * Quantize the vertexes of the polygon: positions to 3 uint16 steps of the bounding box (quantizationOrigin + q * quantizationScale),
+ * vertex normals to 2 int16 of their octahedral encoding (off by at most about 0.0025 degrees). The float buffers are released, PolygonGetPosition and PolygonGetNormal decode on the fly.
+ * Vertex data shrinks from 24 to 10 bytes per vertex; every coordinate is off by at most half a step (0.5 * quantizationScale).
+ * The bounding sphere (and the BVH if it is built) is recalculated from the quantized positions.
+ * @param polygon
+ * @param positionError [out, optional] largest distance between a vertex and its quantized position
+ * @param normalError [out, optional] largest angle (radian) between a vertex normal and its quantized one
+ * @return false if the polygon is already quantized
+ */
+bool PolygonQuantize(Polygon *polygon, Real *positionError, Real *normalError) {
+  if (polygon->quantizedPositions != NULL) {
+    fprintf(stderr, "%s: polygon is already quantized\n", __FUNCTION_NAME__);
+    return false;
+  }
+  const uint64_t vertex = polygon->vertex;
+  Vector min = V(REAL_MAX, REAL_MAX, REAL_MAX), max = V(-REAL_MAX, -REAL_MAX, -REAL_MAX);
+  for (uint64_t v = 0; v < vertex; ++v) {
+    const Vector p = PolygonGetPosition(polygon, (uint32_t)v);
+    min = V(FMIN(min.x, p.x), FMIN(min.y, p.y), FMIN(min.z, p.z));
+    max = V(FMAX(max.x, p.x), FMAX(max.y, p.y), FMAX(max.z, p.z));
+  }
+  if (vertex == 0) {
+    min = max = V0;
+  }
+  polygon->quantizationOrigin = min;
+  polygon->quantizationScale = VectorScalarDivision(VectorSubtraction(max, min), UINT16_MAX);
+
+  uint16_t *quantizedPositions = (uint16_t *)malloc((vertex > 0 ? vertex : 1) * 3 * sizeof(uint16_t));
+  int16_t *quantizedNormals = (int16_t *)malloc((vertex > 0 ? vertex : 1) * 2 * sizeof(int16_t));
+  const Real origin[3] = {min.x, min.y, min.z}, scale[3] = {polygon->quantizationScale.x, polygon->quantizationScale.y, polygon->quantizationScale.z};
+  Real maxPositionError = 0, maxNormalSine = 0; // squared
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) reduction(max : maxPositionError, maxNormalSine) if (vertex > POLYGON_PARALLEL_MINIMUM)
+#endif
+  for (int64_t v = 0; v < (int64_t)vertex; ++v) {
+    Real distance = 0;
+    for (int axis = 0; axis < 3; ++axis) {
+      const Real position = polygon->positions[v * 3 + axis];
+      const Real step = scale[axis] > 0 ? ROUND((position - origin[axis]) / scale[axis]) : 0;
+      quantizedPositions[v * 3 + axis] = (uint16_t)(step > UINT16_MAX ? UINT16_MAX : step < 0 ? 0 : step);
+      const Real error = origin[axis] + quantizedPositions[v * 3 + axis] * scale[axis] - position;
+      distance += error * error;
+    }
+    maxPositionError = distance > maxPositionError ? distance : maxPositionError;
+    const Real sine = _PolygonEncodeOctahedral(PolygonGetNormal(polygon, (uint32_t)v), &quantizedNormals[v * 2]);
+    maxNormalSine = sine > maxNormalSine ? sine : maxNormalSine;
+  }
+  if (positionError != NULL) {
+    *positionError = SQRT(maxPositionError);
+  }
+  if (normalError != NULL) {
+    *normalError = ATAN2(SQRT(maxNormalSine), SQRT(1 - maxNormalSine));
+  }
+
+  // release the float buffers, they belong to the file if the polygon is mapped
+  if (polygon->mapping == NULL) {
+    free(polygon->positions);
+    free(polygon->normals);
+  }
+  polygon->positions = polygon->normals = NULL;
+  polygon->quantizedPositions = quantizedPositions;
+  polygon->quantizedNormals = quantizedNormals;
+  PolygonCalculateBoundingSphere(polygon);
+  if (polygon->bvh != NULL) {
+    PolygonBuildBVH(polygon);
+  }
   return true;
 }
 
+/**
+ * Expand a triangle of the polygon.
+ * @param polygon
+ * @param triangleIndex
+ * @return triangle with its vertexes, surface normal and vertex normals
+ */
+Triangle PolygonGetTriangle(const Polygon *polygon, uint64_t triangleIndex) {
+  const float *n = &polygon->surfaceNormals[triangleIndex * 3];
+  const uint32_t *indices = &polygon->indices[triangleIndex * 3];
+  Triangle t;
+  t.surfaceNormal = V(n[0], n[1], n[2]);
+  for (int vertexIndex = 0; vertexIndex < 3; ++vertexIndex) {
+    t.vertexes[vertexIndex] = PolygonGetPosition(polygon, indices[vertexIndex]);
+    t.vertexNormals[vertexIndex] = PolygonGetNormal(polygon, indices[vertexIndex]);
+  }
+  return t;
+}
+
 bool PolygonDestroy(Polygon *polygon) {
   if (polygon == NULL) {
 #ifndef NDEBUG
@@ -84,7 +897,22 @@ bool PolygonDestroy(Polygon *polygon) {
 #endif
     return false;
   }
-  free(polygon->triangles);
+  if (polygon->bvh != NULL) {
+    BVHDestroy(polygon->bvh);
+  }
+  if (polygon->lod != NULL) {
+    PolygonDestroy(polygon->lod);
+  }
+  free(polygon->quantizedPositions);
+  free(polygon->quantizedNormals);
+  if (polygon->mapping != NULL) {
+    _PolygonUnmapFile(polygon->mapping, polygon->mappingSize);
+  } else {
+    free(polygon->indices);
+    free(polygon->surfaceNormals);
+    free(polygon->normals);
+    free(polygon->positions);
+  }
   free(polygon);
   return true;
 }
@@ -1,6 +1,9 @@
 #ifndef RENDER_POLYGON_H
 #define RENDER_POLYGON_H
 
+#include <math.h>
+
+#include "bvh.h"
 #include "common.h"
 #include "vector.h"
 
@@ -13,19 +16,131 @@ typedef struct tagSTLTriangle {
 } STLTriangle;
 #pragma pack(pop)
 
+typedef enum { UniformNormalWeighting, AreaNormalWeighting, AngleNormalWeighting } NormalWeightingType;
+
+#define STL_HEADER_SIZE 84 // 80 bytes of header and the number of triangles
+
+/*
+ * Read-only view of the triangle records of a binary STL file, mapped in place.
+ * The records are packed (50 bytes each), so access their members directly instead of taking pointers to them.
+ */
+typedef struct tagSTLView {
+  uint64_t triangle;
+  const STLTriangle *triangles;
+  void *mapping;
+  uint64_t size; // file size
+} STLView;
+
 typedef struct tagTriangle {
   Vector surfaceNormal;
   Vector vertexes[3];
   Vector vertexNormals[3];
 } Triangle;
 
+/*
+ * Indexed triangle mesh: vertexes with equal positions are welded and stored once, in float, and each triangle holds the indices of its 3 vertexes.
+ * Surface normals are kept per triangle (as given by the source), vertex normals are zero until PolygonCalculateVertexNormals.
+ * Use PolygonGetTriangle to expand one triangle, PolygonGetPosition and PolygonGetNormal to read one vertex.
+ * PolygonQuantize replaces positions and vertex normals by 16-bit ones (10 bytes per vertex instead of 24), decoded by the same functions.
+ * PolygonBuildLOD chains simplified copies (levels of detail) to the polygon, from which PolygonSelectLOD picks the one to draw.
+ */
 typedef struct tagPolygon {
   uint64_t triangle;
-  Triangle *triangles;
+  uint64_t vertex;
+  float *positions;             // x, y, z of each vertex
+  float *normals;               // x, y, z of each vertex normal
+  float *surfaceNormals;        // x, y, z of each triangle
+  uint32_t *indices;            // 3 vertexes of each triangle
+  uint16_t *quantizedPositions; // [PolygonQuantize] x, y, z of each vertex in steps of quantizationScale from quantizationOrigin, positions is NULL
+  int16_t *quantizedNormals;    // [PolygonQuantize] octahedral encoded vertex normals (2 snorm16), normals is NULL
+  Vector quantizationOrigin;
+  Vector quantizationScale;
+  Vector boundingCenter; // bounding sphere in object space
+  Real boundingRadius;
+  BVH *bvh; // [PolygonBuildBVH] BVH of the triangles in object space, used for culling and ray queries
+  void *mapping; // [PolygonReadMesh] mapped file holding the buffers
+  uint64_t mappingSize;
+  struct tagPolygon *lod; // [PolygonBuildLOD] next coarser level of detail, owned by this polygon
+  Real lodError;          // [PolygonBuildLOD] distance of this level from the full polygon in object space, 0 for the full polygon
 } Polygon;
 
+#define POLYGON_MESH_MAGIC "SRTMESH"
+#define POLYGON_MESH_VERSION 1
+#define POLYGON_MESH_ENDIANNESS 0x01020304
+#define POLYGON_MESH_ALIGNMENT 64
+
+/*
+ * Header of the native mesh format, followed by the buffers of Polygon at the given offsets (aligned to POLYGON_MESH_ALIGNMENT bytes).
+ * Vertex normals are stored as they are, calculate them before writing.
+ * Files are written in the byte order of the writer and rejected on other ones.
+ */
+typedef struct tagPolygonMeshHeader {
+  char magic[8]; // POLYGON_MESH_MAGIC
+  uint32_t version;
+  uint32_t endianness; // POLYGON_MESH_ENDIANNESS
+  uint32_t headerSize; // sizeof(PolygonMeshHeader)
+  uint32_t reserved;
+  uint64_t triangle;
+  uint64_t vertex;
+  uint64_t positionsOffset; // bytes from the start of the file
+  uint64_t normalsOffset;
+  uint64_t surfaceNormalsOffset;
+  uint64_t indicesOffset;
+  double boundingCenter[3];
+  double boundingRadius;
+  uint64_t size; // file size
+} PolygonMeshHeader;
+
+STLView *PolygonMapSTL(const char *filename);
+bool PolygonUnmapSTL(STLView *view);
+Polygon *PolygonCreateFromSTL(const STLTriangle *triangles, uint64_t triangle);
 Polygon *PolygonReadSTL(const char *filename);
+bool PolygonWriteMesh(const Polygon *polygon, const char *filename);
+Polygon *PolygonReadMesh(const char *filename);
 bool PolygonDestroy(Polygon *polygon);
 bool PolygonCalculateVertexNormals(Polygon *polygon);
+bool PolygonCalculateWeightedVertexNormals(Polygon *polygon, NormalWeightingType weighting);
+bool PolygonCalculateBoundingSphere(Polygon *polygon);
+Triangle PolygonGetTriangle(const Polygon *polygon, uint64_t triangleIndex);
+bool PolygonOptimizeVertexCache(Polygon *polygon);
+bool PolygonOptimizeVertexFetch(Polygon *polygon);
+double PolygonVertexCacheMissRatio(const Polygon *polygon, uint32_t cacheSize);
+bool PolygonQuantize(Polygon *polygon, Real *positionError, Real *normalError);
+bool PolygonBuildBVH(Polygon *polygon);
+bool PolygonRaycast(const Polygon *polygon, Vector origin, Vector direction, Real *distance, uint64_t *triangleIndex);
+bool PolygonBuildLOD(Polygon *polygon, uint32_t levels, Real ratio);
+const Polygon *PolygonSelectLOD(const Polygon *polygon, Real maximumError);
+
+/**
+ * Decode an octahedral encoded unit vector: the octahedron |x| + |y| + |z| = 1 unfolded on the square [-1, 1]^2, lower half folded over the diagonals
+ */
+FORCE_INLINE Vector _PolygonDecodeOctahedral(const int16_t encoded[2]) {
+  // float like the unquantized normals, whose precision is far beyond the 16-bit grid
+  float x = encoded[0] * (1.0f / INT16_MAX), y = encoded[1] * (1.0f / INT16_MAX);
+  const float z = 1 - fabsf(x) - fabsf(y);
+  const float fold = z < 0 ? -z : 0;
+  x += x >= 0 ? -fold : fold;
+  y += y >= 0 ? -fold : fold;
+  const float inverse = 1 / sqrtf(x * x + y * y + z * z);
+  return V(x * inverse, y * inverse, z * inverse);
+}
+
+FORCE_INLINE Vector PolygonGetPosition(const Polygon *polygon, uint32_t vertexIndex) {
+  if (polygon->quantizedPositions != NULL) {
+    const uint16_t *position = &polygon->quantizedPositions[vertexIndex * 3];
+    const Vector origin = polygon->quantizationOrigin, scale = polygon->quantizationScale;
+    return V(origin.x + position[0] * scale.x, origin.y + position[1] * scale.y, origin.z + position[2] * scale.z);
+  }
+  const float *position = &polygon->positions[vertexIndex * 3];
+  return V(position[0], position[1], position[2]);
+}
+
+FORCE_INLINE Vector PolygonGetNormal(const Polygon *polygon, uint32_t vertexIndex) {
+  if (polygon->quantizedNormals != NULL) {
+    return _PolygonDecodeOctahedral(&polygon->quantizedNormals[vertexIndex * 2]);
+  }
+  const float *normal = &polygon->normals[vertexIndex * 3];
+  return V(normal[0], normal[1], normal[2]);
+}
 
 #endif // RENDER_POLYGON_H
@@ -0,0 +1,109 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "polygon.h"
+
+/*
+ * BVH of the triangles of a polygon and ray queries against it.
+ */
+
+#define POLYGON_BVH_PARALLEL_MINIMUM 65536
+#define POLYGON_RAY_EPSILON (REAL_EPSILON * 64) // barycentric tolerance, a ray along an edge shared by two triangles hits one of them
+
+/**
+ * Build (or rebuild) the BVH of the triangles of the polygon in object space.
+ * Call again after modifying the vertexes; PolygonOptimizeVertexCache rebuilds it when it reorders the triangles.
+ * @param polygon
+ * @return
+ */
+bool PolygonBuildBVH(Polygon *polygon) {
+  if (polygon->triangle > UINT32_MAX) {
+    fprintf(stderr, "%s: too many triangles (%llu)\n", __FUNCTION_NAME__, (unsigned long long)polygon->triangle);
+    return false;
+  }
+  const int64_t triangle = (int64_t)polygon->triangle;
+  float *boxes = (float *)malloc((triangle > 0 ? triangle : 1) * 6 * sizeof(float));
+  if (boxes == NULL) {
+    fprintf(stderr, "%s: failed to allocate memory\n", __FUNCTION_NAME__);
+    return false;
+  }
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) if (triangle > POLYGON_BVH_PARALLEL_MINIMUM)
+#endif
+  for (int64_t t = 0; t < triangle; ++t) {
+    const uint32_t *indices = &polygon->indices[t * 3];
+    const Vector v0 = PolygonGetPosition(polygon, indices[0]), v1 = PolygonGetPosition(polygon, indices[1]), v2 = PolygonGetPosition(polygon, indices[2]);
+    BVHBoxFromReal(V(FMIN(v0.x, FMIN(v1.x, v2.x)), FMIN(v0.y, FMIN(v1.y, v2.y)), FMIN(v0.z, FMIN(v1.z, v2.z))),
+                   V(FMAX(v0.x, FMAX(v1.x, v2.x)), FMAX(v0.y, FMAX(v1.y, v2.y)), FMAX(v0.z, FMAX(v1.z, v2.z))), &boxes[t * 6]);
+  }
+  BVH *bvh = BVHCreate(boxes, (uint32_t)triangle);
+  free(boxes);
+  if (bvh == NULL) {
+    return false;
+  }
+  if (polygon->bvh != NULL) {
+    BVHDestroy(polygon->bvh);
+  }
+  polygon->bvh = bvh;
+  return true;
+}
+
+/**
+ * Intersect the ray with a triangle of the polygon, from either side (Moller-Trumbore), edges slightly enlarged
+ */
+bool _PolygonRayTriangle(const void *context, uint32_t triangleIndex, Vector origin, Vector direction, Real *distance) {
+  const Polygon *polygon = (const Polygon *)context;
+  const uint32_t *indices = &polygon->indices[(uint64_t)triangleIndex * 3];
+  const Vector v0 = PolygonGetPosition(polygon, indices[0]);
+  const Vector e1 = VectorSubtraction(PolygonGetPosition(polygon, indices[1]), v0), e2 = VectorSubtraction(PolygonGetPosition(polygon, indices[2]), v0);
+  const Vector p = VectorCrossProduct(direction, e2);
+  const Real determinant = VectorDotProduct(e1, p);
+  if (determinant == 0) {
+    return false;
+  }
+  const Vector s = VectorSubtraction(origin, v0);
+  const Real u = VectorDotProduct(s, p) / determinant;
+  if (u < -POLYGON_RAY_EPSILON || u > 1 + POLYGON_RAY_EPSILON) {
+    return false;
+  }
+  const Vector q = VectorCrossProduct(s, e1);
+  const Real v = VectorDotProduct(direction, q) / determinant;
+  if (v < -POLYGON_RAY_EPSILON || u + v > 1 + POLYGON_RAY_EPSILON) {
+    return false;
+  }
+  const Real t = VectorDotProduct(e2, q) / determinant;
+  if (t < 0 || t > *distance) {
+    return false;
+  }
+  *distance = t;
+  return true;
+}
+
+/**
+ * Find the nearest triangle hit by the ray origin + t * direction (0 <= t <= distance) in object space, through the BVH if it is built.
+ * Both sides of the triangles are hit.
+ * @param polygon
+ * @param origin
+ * @param direction need not be normalized, distance is measured in its length
+ * @param distance [in, out] largest t, t of the nearest hit
+ * @param triangleIndex [out] nearest triangle hit
+ * @return true if a triangle is hit
+ */
+bool PolygonRaycast(const Polygon *polygon, Vector origin, Vector direction, Real *distance, uint64_t *triangleIndex) {
+  if (polygon->bvh != NULL) {
+    uint32_t primitive;
+    if (!BVHRaycast(polygon->bvh, origin, direction, _PolygonRayTriangle, polygon, distance, &primitive)) {
+      return false;
+    }
+    *triangleIndex = primitive;
+    return true;
+  }
+  bool hit = false;
+  for (uint64_t t = 0; t < polygon->triangle; ++t) {
+    if (_PolygonRayTriangle(polygon, (uint32_t)t, origin, direction, distance)) {
+      hit = true;
+      *triangleIndex = t;
+    }
+  }
+  return hit;
+}
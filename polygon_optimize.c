@@ -0,0 +1,227 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "polygon.h"
+
+/*
+ * Vertex cache and vertex fetch optimization of indexed polygons.
+ * Triangles are reordered with Tom Forsyth's "Linear-Speed Vertex Cache Optimisation" (LRU cache of POLYGON_CACHE_SIZE vertexes),
+ * then vertexes are renumbered in order of first use so that the vertex buffers are read almost sequentially.
+ */
+
+#define POLYGON_CACHE_SIZE 32
+#define POLYGON_VALENCE_SCORES 32 // valences scored by table, higher ones share the last score
+
+/**
+ * Score of a vertex from its position in the LRU cache (-1 outside) and its number of triangles still to be emitted
+ */
+FORCE_INLINE float _PolygonVertexScore(const float *cacheScores, const float *valenceScores, int32_t cachePosition, uint32_t valence) {
+  if (valence == 0) {
+    return -1;
+  }
+  return (cachePosition >= 0 ? cacheScores[cachePosition] : 0) + valenceScores[valence < POLYGON_VALENCE_SCORES ? valence : POLYGON_VALENCE_SCORES - 1];
+}
+
+/**
+ * Reorder the triangles of the polygon for a post-transform vertex cache (Forsyth).
+ * The triangle with the best score among those of the vertexes in the simulated cache is emitted next, and the first remaining triangle if none is left.
+ * Surface normals follow their triangles, vertexes are not renumbered (see PolygonOptimizeVertexFetch). A built BVH is rebuilt.
+ * @param polygon
+ * @return
+ */
+bool PolygonOptimizeVertexCache(Polygon *polygon) {
+  const uint64_t triangle = polygon->triangle, vertex = polygon->vertex;
+  if (triangle == 0) {
+    return true;
+  }
+  float cacheScores[POLYGON_CACHE_SIZE], valenceScores[POLYGON_VALENCE_SCORES];
+  for (int i = 0; i < POLYGON_CACHE_SIZE; ++i) {
+    // the vertexes of the last triangle get a fixed score, so that the next triangle does not simply reuse its edge
+    cacheScores[i] = i < 3 ? 0.75f : powf(1.0f - (float)(i - 3) / (POLYGON_CACHE_SIZE - 3), 1.5f);
+  }
+  valenceScores[0] = 0;
+  for (int i = 1; i < POLYGON_VALENCE_SCORES; ++i) {
+    valenceScores[i] = 2.0f * powf((float)i, -0.5f);
+  }
+
+  // triangles of every vertex, the emitted ones are moved past the valence
+  uint32_t *valences = (uint32_t *)calloc(vertex, sizeof(uint32_t));
+  uint64_t *offsets = (uint64_t *)malloc((vertex + 1) * sizeof(uint64_t));
+  uint32_t *adjacency = (uint32_t *)malloc(triangle * 3 * sizeof(uint32_t));
+  for (uint64_t c = 0; c < triangle * 3; ++c) {
+    ++valences[polygon->indices[c]];
+  }
+  offsets[0] = 0;
+  for (uint64_t v = 0; v < vertex; ++v) {
+    offsets[v + 1] = offsets[v] + valences[v];
+    valences[v] = 0;
+  }
+  for (uint64_t c = 0; c < triangle * 3; ++c) {
+    const uint32_t v = polygon->indices[c];
+    adjacency[offsets[v] + valences[v]++] = (uint32_t)(c / 3);
+  }
+
+  int32_t *cachePositions = (int32_t *)malloc(vertex * sizeof(int32_t));
+  float *vertexScores = (float *)malloc(vertex * sizeof(float));
+  for (uint64_t v = 0; v < vertex; ++v) {
+    cachePositions[v] = -1;
+    vertexScores[v] = _PolygonVertexScore(cacheScores, valenceScores, -1, valences[v]);
+  }
+  float *triangleScores = (float *)malloc(triangle * sizeof(float));
+  uint8_t *emitted = (uint8_t *)calloc(triangle, sizeof(uint8_t));
+  for (uint64_t t = 0; t < triangle; ++t) {
+    const uint32_t *indices = &polygon->indices[t * 3];
+    triangleScores[t] = vertexScores[indices[0]] + vertexScores[indices[1]] + vertexScores[indices[2]];
+  }
+
+  uint32_t *order = (uint32_t *)malloc(triangle * sizeof(uint32_t));
+  uint32_t cache[POLYGON_CACHE_SIZE + 3];
+  uint32_t cacheCount = 0;
+  uint64_t next = 0; // first triangle that may not be emitted yet
+  int64_t best = -1;
+  for (uint64_t emittedCount = 0; emittedCount < triangle; ++emittedCount) {
+    if (best < 0) {
+      while (emitted[next]) {
+        ++next;
+      }
+      best = (int64_t)next;
+    }
+    const uint32_t *indices = &polygon->indices[best * 3];
+    order[emittedCount] = (uint32_t)best;
+    emitted[best] = 1;
+
+    // remove the triangle from its vertexes, then put them at the front of the cache
+    uint32_t newCache[POLYGON_CACHE_SIZE + 3];
+    uint32_t newCount = 0;
+    for (int i = 0; i < 3; ++i) {
+      const uint32_t v = indices[i];
+      uint32_t *triangles = &adjacency[offsets[v]];
+      for (uint32_t j = 0; j < valences[v]; ++j) {
+        if (triangles[j] == (uint32_t)best) {
+          triangles[j] = triangles[valences[v] - 1];
+          triangles[valences[v] - 1] = (uint32_t)best;
+          break;
+        }
+      }
+      --valences[v];
+      newCache[newCount++] = v;
+    }
+    for (uint32_t i = 0; i < cacheCount; ++i) {
+      const uint32_t v = cache[i];
+      if (v != indices[0] && v != indices[1] && v != indices[2]) {
+        newCache[newCount++] = v;
+      }
+    }
+
+    // rescore the vertexes in the cache, and the ones pushed out of it, then their triangles
+    best = -1;
+    float bestScore = -1;
+    for (uint32_t i = 0; i < newCount; ++i) {
+      const uint32_t v = newCache[i];
+      cachePositions[v] = i < POLYGON_CACHE_SIZE ? (int32_t)i : -1;
+      const float score = _PolygonVertexScore(cacheScores, valenceScores, cachePositions[v], valences[v]);
+      const float delta = score - vertexScores[v];
+      vertexScores[v] = score;
+      for (uint32_t j = 0; j < valences[v]; ++j) {
+        const uint32_t t = adjacency[offsets[v] + j];
+        triangleScores[t] += delta;
+        if (triangleScores[t] > bestScore) {
+          bestScore = triangleScores[t];
+          best = t;
+        }
+      }
+    }
+    cacheCount = newCount < POLYGON_CACHE_SIZE ? newCount : POLYGON_CACHE_SIZE;
+    memcpy(cache, newCache, cacheCount * sizeof(uint32_t));
+  }
+
+  // apply the order to the index buffer and the surface normals
+  uint32_t *indices = (uint32_t *)malloc(triangle * 3 * sizeof(uint32_t));
+  float *surfaceNormals = (float *)malloc(triangle * 3 * sizeof(float));
+  for (uint64_t t = 0; t < triangle; ++t) {
+    memcpy(&indices[t * 3], &polygon->indices[(uint64_t)order[t] * 3], 3 * sizeof(uint32_t));
+    memcpy(&surfaceNormals[t * 3], &polygon->surfaceNormals[(uint64_t)order[t] * 3], 3 * sizeof(float));
+  }
+  memcpy(polygon->indices, indices, triangle * 3 * sizeof(uint32_t));
+  memcpy(polygon->surfaceNormals, surfaceNormals, triangle * 3 * sizeof(float));
+  if (polygon->bvh != NULL) {
+    PolygonBuildBVH(polygon);
+  }
+
+  free(surfaceNormals);
+  free(indices);
+  free(order);
+  free(emitted);
+  free(triangleScores);
+  free(vertexScores);
+  free(cachePositions);
+  free(adjacency);
+  free(offsets);
+  free(valences);
+  return true;
+}
+
+/**
+ * Renumber the vertexes of the polygon in order of first use by the index buffer, so that they are fetched almost sequentially.
+ * Call after PolygonOptimizeVertexCache. Unused vertexes are kept after the used ones.
+ * @param polygon
+ * @return
+ */
+bool PolygonOptimizeVertexFetch(Polygon *polygon) {
+  const uint64_t vertex = polygon->vertex;
+  uint32_t *remap = (uint32_t *)malloc((vertex > 0 ? vertex : 1) * sizeof(uint32_t));
+  memset(remap, 0xff, vertex * sizeof(uint32_t));
+  uint32_t next = 0;
+  for (uint64_t c = 0; c < polygon->triangle * 3; ++c) {
+    uint32_t *index = &polygon->indices[c];
+    if (remap[*index] == UINT32_MAX) {
+      remap[*index] = next++;
+    }
+    *index = remap[*index];
+  }
+  for (uint64_t v = 0; v < vertex; ++v) {
+    if (remap[v] == UINT32_MAX) {
+      remap[v] = next++;
+    }
+  }
+
+  // float or quantized vertex buffers
+  uint8_t *buffers[2] = {polygon->positions != NULL ? (uint8_t *)polygon->positions : (uint8_t *)polygon->quantizedPositions,
+                         polygon->normals != NULL ? (uint8_t *)polygon->normals : (uint8_t *)polygon->quantizedNormals};
+  const size_t strides[2] = {polygon->positions != NULL ? 3 * sizeof(float) : 3 * sizeof(uint16_t), polygon->normals != NULL ? 3 * sizeof(float) : 2 * sizeof(int16_t)};
+  uint8_t *buffer = (uint8_t *)malloc((vertex > 0 ? vertex : 1) * 3 * sizeof(float));
+  for (int i = 0; i < 2; ++i) {
+    for (uint64_t v = 0; v < vertex; ++v) {
+      memcpy(&buffer[(uint64_t)remap[v] * strides[i]], &buffers[i][v * strides[i]], strides[i]);
+    }
+    memcpy(buffers[i], buffer, vertex * strides[i]);
+  }
+  free(buffer);
+  free(remap);
+  return true;
+}
+
+/**
+ * Average cache miss ratio: vertexes transformed per triangle with a FIFO post-transform cache of cacheSize vertexes.
+ * 3 is the worst, 0.5 about the best for large regular meshes.
+ * @param polygon
+ * @param cacheSize
+ * @return
+ */
+double PolygonVertexCacheMissRatio(const Polygon *polygon, uint32_t cacheSize) {
+  if (polygon->triangle == 0 || cacheSize == 0) {
+    return 0;
+  }
+  uint64_t *timestamps = (uint64_t *)calloc(polygon->vertex > 0 ? polygon->vertex : 1, sizeof(uint64_t)); // time each vertex entered the cache, 0 if never
+  uint64_t misses = 0;
+  for (uint64_t c = 0; c < polygon->triangle * 3; ++c) {
+    const uint32_t v = polygon->indices[c];
+    if (timestamps[v] == 0 || misses + 1 - timestamps[v] > cacheSize) {
+      ++misses;
+      timestamps[v] = misses;
+    }
+  }
+  free(timestamps);
+  return (double)misses / polygon->triangle;
+}
@@ -0,0 +1,516 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "polygon.h"
+
+/*
+ * Level of detail chain of a polygon by quadric error metric simplification (Garland and Heckbert, "Surface Simplification Using Quadric Error Metrics").
+ * Edges are collapsed cheapest first into the point minimizing the mean squared distance to the planes of the original triangles around them, weighted by their areas.
+ * One pass runs from the full mesh to the coarsest level, so the quadrics of a level account for every collapse before it.
+ */
+
+#define POLYGON_LOD_MINIMUM 32    // no level is made of fewer triangles
+#define POLYGON_BORDER_WEIGHT 16  // weight (per squared length) of the planes through border edges, perpendicular to their triangle, so that open borders stay in place
+#define POLYGON_FLIP_COSINE 0.25  // a collapse is rejected if it turns a remaining triangle by more than about 75 degrees
+#define POLYGON_SOLVE_EPSILON 1e-9 // quadrics whose determinant is below this (relative to their trace) are not solved, the best of the ends and the midpoint is taken
+
+/*
+ * Symmetric 4x4 quadric: a2, ab, ac, ad, b2, bc, bd, c2, cd, d2 of the planes ax + by + cz + d = 0 summed with their weights (areas)
+ */
+typedef struct tagPolygonQuadric {
+  double q[10];
+  double weight; // sum of the weights
+} PolygonQuadric;
+
+typedef struct tagPolygonCollapse {
+  double cost;
+  double target[3];
+  uint32_t from, to;           // from is merged into to
+  uint32_t fromStamp, toStamp; // versions of the vertexes when the collapse was evaluated, stale entries are dropped
+} PolygonCollapse;
+
+/*
+ * State of one simplification: the working mesh, the triangles of every vertex as linked lists (merged on collapse, removed triangles skipped) and a heap of collapses
+ */
+typedef struct tagPolygonSimplifier {
+  uint64_t triangle, vertex;
+  uint64_t remaining; // triangles left
+  double *points;     // x, y, z of each vertex
+  uint32_t *indices;  // 3 vertexes of each triangle
+  uint8_t *removed;   // per triangle
+  uint8_t *merged;    // per vertex
+  uint32_t *stamps;   // per vertex
+  uint32_t *marks;    // per vertex, for neighbour sets
+  uint32_t mark;
+  PolygonQuadric *quadrics;
+  uint32_t *heads, *tails; // first and last corner of each vertex list
+  uint32_t *nexts;         // next corner of each corner in the list of its vertex
+  PolygonCollapse *heap;
+  uint64_t heapSize, heapCapacity;
+} PolygonSimplifier;
+
+FORCE_INLINE void _PolygonQuadricAddPlane(PolygonQuadric *quadric, double a, double b, double c, double d, double weight) {
+  const double plane[4] = {a, b, c, d};
+  int k = 0;
+  for (int i = 0; i < 4; ++i) {
+    for (int j = i; j < 4; ++j) {
+      quadric->q[k++] += plane[i] * plane[j] * weight;
+    }
+  }
+  quadric->weight += weight;
+}
+
+FORCE_INLINE void _PolygonQuadricAdd(PolygonQuadric *quadric, const PolygonQuadric *other) {
+  for (int i = 0; i < 10; ++i) {
+    quadric->q[i] += other->q[i];
+  }
+  quadric->weight += other->weight;
+}
+
+/**
+ * Weighted mean of the squared distances of p to the planes of the quadric
+ */
+FORCE_INLINE double _PolygonQuadricError(const PolygonQuadric *quadric, const double p[3]) {
+  const double *q = quadric->q;
+  const double x = p[0], y = p[1], z = p[2];
+  const double error = q[0] * x * x + 2 * q[1] * x * y + 2 * q[2] * x * z + 2 * q[3] * x + q[4] * y * y + 2 * q[5] * y * z + 2 * q[6] * y + q[7] * z * z + 2 * q[8] * z + q[9];
+  return error > 0 && quadric->weight > 0 ? error / quadric->weight : 0;
+}
+
+FORCE_INLINE void _PolygonCross(const double a[3], const double b[3], double cross[3]) {
+  cross[0] = a[1] * b[2] - a[2] * b[1];
+  cross[1] = a[2] * b[0] - a[0] * b[2];
+  cross[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+/**
+ * Normal of the triangle p0 p1 p2 by its winding, twice its area long
+ */
+FORCE_INLINE void _PolygonNormal(const double *p0, const double *p1, const double *p2, double normal[3]) {
+  const double e1[3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]}, e2[3] = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+  _PolygonCross(e1, e2, normal);
+}
+
+void _PolygonHeapPush(PolygonSimplifier *simplifier, const PolygonCollapse *collapse) {
+  if (simplifier->heapSize == simplifier->heapCapacity) {
+    simplifier->heapCapacity *= 2;
+    simplifier->heap = (PolygonCollapse *)realloc(simplifier->heap, simplifier->heapCapacity * sizeof(PolygonCollapse));
+  }
+  PolygonCollapse *heap = simplifier->heap;
+  uint64_t i = simplifier->heapSize++;
+  for (; i > 0 && heap[(i - 1) / 2].cost > collapse->cost; i = (i - 1) / 2) {
+    heap[i] = heap[(i - 1) / 2];
+  }
+  heap[i] = *collapse;
+}
+
+PolygonCollapse _PolygonHeapPop(PolygonSimplifier *simplifier) {
+  PolygonCollapse *heap = simplifier->heap;
+  const PolygonCollapse top = heap[0], last = heap[--simplifier->heapSize];
+  const uint64_t size = simplifier->heapSize;
+  uint64_t i = 0;
+  for (uint64_t child = 1; child < size; child = i * 2 + 1) {
+    if (child + 1 < size && heap[child + 1].cost < heap[child].cost) {
+      ++child;
+    }
+    if (heap[child].cost >= last.cost) {
+      break;
+    }
+    heap[i] = heap[child];
+    i = child;
+  }
+  if (size > 0) {
+    heap[i] = last;
+  }
+  return top;
+}
+
+/**
+ * Evaluate the collapse of the edge from - to and push it: the point minimizing the summed quadric, unless it is ill-conditioned or far off the edge
+ */
+void _PolygonPushCollapse(PolygonSimplifier *simplifier, uint32_t from, uint32_t to) {
+  PolygonQuadric quadric = simplifier->quadrics[from];
+  _PolygonQuadricAdd(&quadric, &simplifier->quadrics[to]);
+  const double *q = quadric.q, *p0 = &simplifier->points[(uint64_t)from * 3], *p1 = &simplifier->points[(uint64_t)to * 3];
+  PolygonCollapse collapse = {0, {0, 0, 0}, from, to, simplifier->stamps[from], simplifier->stamps[to]};
+
+  // solve A x = -b for A = [q0 q1 q2; q1 q4 q5; q2 q5 q7], b = (q3, q6, q8) by Cramer's rule
+  const double c0 = q[4] * q[7] - q[5] * q[5], c1 = q[2] * q[5] - q[1] * q[7], c2 = q[1] * q[5] - q[2] * q[4];
+  const double determinant = q[0] * c0 + q[1] * c1 + q[2] * c2;
+  const double trace = q[0] + q[4] + q[7];
+  const double edge = (p1[0] - p0[0]) * (p1[0] - p0[0]) + (p1[1] - p0[1]) * (p1[1] - p0[1]) + (p1[2] - p0[2]) * (p1[2] - p0[2]);
+  bool solved = false;
+  if (fabs(determinant) > POLYGON_SOLVE_EPSILON * trace * trace * trace) {
+    const double inverse = 1 / determinant;
+    const double x = -(c0 * q[3] + c1 * q[6] + c2 * q[8]) * inverse;
+    const double y = -((q[2] * q[5] - q[1] * q[7]) * q[3] + (q[0] * q[7] - q[2] * q[2]) * q[6] + (q[1] * q[2] - q[0] * q[5]) * q[8]) * inverse;
+    const double z = -((q[1] * q[5] - q[2] * q[4]) * q[3] + (q[1] * q[2] - q[0] * q[5]) * q[6] + (q[0] * q[4] - q[1] * q[1]) * q[8]) * inverse;
+    const double midpoint[3] = {(p0[0] + p1[0]) * 0.5, (p0[1] + p1[1]) * 0.5, (p0[2] + p1[2]) * 0.5};
+    const double offset = (x - midpoint[0]) * (x - midpoint[0]) + (y - midpoint[1]) * (y - midpoint[1]) + (z - midpoint[2]) * (z - midpoint[2]);
+    if (offset <= edge) {
+      collapse.target[0] = x;
+      collapse.target[1] = y;
+      collapse.target[2] = z;
+      collapse.cost = _PolygonQuadricError(&quadric, collapse.target);
+      solved = true;
+    }
+  }
+  if (!solved) {
+    const double candidates[3][3] = {{p1[0], p1[1], p1[2]}, {p0[0], p0[1], p0[2]}, {(p0[0] + p1[0]) * 0.5, (p0[1] + p1[1]) * 0.5, (p0[2] + p1[2]) * 0.5}};
+    collapse.cost = INFINITY;
+    for (int i = 0; i < 3; ++i) {
+      const double cost = _PolygonQuadricError(&quadric, candidates[i]);
+      if (cost < collapse.cost) {
+        collapse.cost = cost;
+        memcpy(collapse.target, candidates[i], sizeof(collapse.target));
+      }
+    }
+  }
+  _PolygonHeapPush(simplifier, &collapse);
+}
+
+/**
+ * Check that merging from into to at target keeps the mesh manifold (the common neighbours are the opposite vertexes of the triangles of the edge)
+ * and does not fold any remaining triangle over
+ */
+bool _PolygonCollapseValid(PolygonSimplifier *simplifier, const PolygonCollapse *collapse) {
+  const uint32_t from = collapse->from, to = collapse->to;
+  const uint32_t neighbourMark = ++simplifier->mark, commonMark = ++simplifier->mark;
+  uint32_t shared = 0, common = 0;
+  for (uint32_t corner = simplifier->heads[to]; corner != UINT32_MAX; corner = simplifier->nexts[corner]) {
+    const uint32_t *indices = &simplifier->indices[(corner / 3) * 3];
+    for (int i = 0; i < 3 && !simplifier->removed[corner / 3]; ++i) {
+      simplifier->marks[indices[i]] = neighbourMark;
+    }
+  }
+  for (uint32_t corner = simplifier->heads[from]; corner != UINT32_MAX; corner = simplifier->nexts[corner]) {
+    const uint32_t *indices = &simplifier->indices[(corner / 3) * 3];
+    if (simplifier->removed[corner / 3]) {
+      continue;
+    }
+    shared += indices[0] == to || indices[1] == to || indices[2] == to;
+    for (int i = 0; i < 3; ++i) {
+      if (indices[i] != from && indices[i] != to && simplifier->marks[indices[i]] == neighbourMark) {
+        simplifier->marks[indices[i]] = commonMark;
+        ++common;
+      }
+    }
+  }
+  if (common != shared) {
+    return false;
+  }
+
+  const uint32_t ends[2] = {from, to};
+  for (int end = 0; end < 2; ++end) {
+    for (uint32_t corner = simplifier->heads[ends[end]]; corner != UINT32_MAX; corner = simplifier->nexts[corner]) {
+      const uint32_t *indices = &simplifier->indices[(corner / 3) * 3];
+      if (simplifier->removed[corner / 3] || ((indices[0] == from || indices[1] == from || indices[2] == from) && (indices[0] == to || indices[1] == to || indices[2] == to))) {
+        continue;
+      }
+      const double *points[3], *moved[3];
+      for (int i = 0; i < 3; ++i) {
+        points[i] = &simplifier->points[(uint64_t)indices[i] * 3];
+        moved[i] = indices[i] == ends[end] ? collapse->target : points[i];
+      }
+      double before[3], after[3];
+      _PolygonNormal(points[0], points[1], points[2], before);
+      _PolygonNormal(moved[0], moved[1], moved[2], after);
+      const double dot = before[0] * after[0] + before[1] * after[1] + before[2] * after[2];
+      const double beforeLength = sqrt(before[0] * before[0] + before[1] * before[1] + before[2] * before[2]);
+      const double afterLength = sqrt(after[0] * after[0] + after[1] * after[1] + after[2] * after[2]);
+      if (beforeLength > 0 && (afterLength == 0 || dot < POLYGON_FLIP_COSINE * beforeLength * afterLength)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+/**
+ * Merge from into to: triangles of the edge are removed, the others of from are moved to the list of to, and the edges around to are evaluated again
+ */
+void _PolygonApplyCollapse(PolygonSimplifier *simplifier, const PolygonCollapse *collapse) {
+  const uint32_t from = collapse->from, to = collapse->to;
+  for (uint32_t corner = simplifier->heads[from]; corner != UINT32_MAX; corner = simplifier->nexts[corner]) {
+    uint32_t *indices = &simplifier->indices[(corner / 3) * 3];
+    if (simplifier->removed[corner / 3]) {
+      continue;
+    }
+    if (indices[0] == to || indices[1] == to || indices[2] == to) {
+      simplifier->removed[corner / 3] = 1;
+      --simplifier->remaining;
+    } else {
+      indices[corner % 3] = to;
+    }
+  }
+  if (simplifier->heads[from] != UINT32_MAX) {
+    if (simplifier->heads[to] == UINT32_MAX) {
+      simplifier->heads[to] = simplifier->heads[from];
+    } else {
+      simplifier->nexts[simplifier->tails[to]] = simplifier->heads[from];
+    }
+    simplifier->tails[to] = simplifier->tails[from];
+  }
+  simplifier->heads[from] = UINT32_MAX;
+  simplifier->merged[from] = 1;
+  ++simplifier->stamps[to];
+  memcpy(&simplifier->points[(uint64_t)to * 3], collapse->target, sizeof(collapse->target));
+  _PolygonQuadricAdd(&simplifier->quadrics[to], &simplifier->quadrics[from]);
+
+  const uint32_t neighbourMark = ++simplifier->mark;
+  simplifier->marks[to] = neighbourMark;
+  for (uint32_t corner = simplifier->heads[to]; corner != UINT32_MAX; corner = simplifier->nexts[corner]) {
+    const uint32_t *indices = &simplifier->indices[(corner / 3) * 3];
+    if (simplifier->removed[corner / 3]) {
+      continue;
+    }
+    for (int i = 0; i < 3; ++i) {
+      if (simplifier->marks[indices[i]] != neighbourMark) {
+        simplifier->marks[indices[i]] = neighbourMark;
+        _PolygonPushCollapse(simplifier, indices[i], to);
+      }
+    }
+  }
+}
+
+int _PolygonCompareEdges(const void *a, const void *b) {
+  const uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+  return x < y ? -1 : x > y;
+}
+
+/**
+ * Polygon of the remaining triangles, in their original order, with the vertexes they use.
+ * Surface normals follow the winding, vertex normals are calculated from them, and the triangles are reordered for the vertex cache.
+ */
+Polygon *_PolygonSimplifiedLevel(const PolygonSimplifier *simplifier, bool bvh) {
+  Polygon *level = (Polygon *)calloc(1, sizeof(Polygon));
+  const uint64_t triangle = simplifier->remaining;
+  uint32_t *remap = (uint32_t *)malloc((simplifier->vertex > 0 ? simplifier->vertex : 1) * sizeof(uint32_t));
+  memset(remap, 0xff, simplifier->vertex * sizeof(uint32_t));
+  for (uint64_t t = 0; t < simplifier->triangle; ++t) {
+    for (int i = 0; i < 3 && !simplifier->removed[t]; ++i) {
+      remap[simplifier->indices[t * 3 + i]] = 0;
+    }
+  }
+  uint64_t vertex = 0;
+  for (uint64_t v = 0; v < simplifier->vertex; ++v) {
+    if (remap[v] == 0) {
+      remap[v] = (uint32_t)vertex++;
+    }
+  }
+  level->triangle = triangle;
+  level->vertex = vertex;
+  level->positions = (float *)malloc((vertex > 0 ? vertex : 1) * 3 * sizeof(float));
+  level->normals = (float *)calloc((vertex > 0 ? vertex : 1) * 3, sizeof(float));
+  level->surfaceNormals = (float *)malloc((triangle > 0 ? triangle : 1) * 3 * sizeof(float));
+  level->indices = (uint32_t *)malloc((triangle > 0 ? triangle : 1) * 3 * sizeof(uint32_t));
+  for (uint64_t v = 0; v < simplifier->vertex; ++v) {
+    for (int i = 0; i < 3 && remap[v] != UINT32_MAX; ++i) {
+      level->positions[(uint64_t)remap[v] * 3 + i] = (float)simplifier->points[v * 3 + i];
+    }
+  }
+  uint64_t next = 0;
+  for (uint64_t t = 0; t < simplifier->triangle; ++t) {
+    if (simplifier->removed[t]) {
+      continue;
+    }
+    const uint32_t *indices = &simplifier->indices[t * 3];
+    double normal[3];
+    _PolygonNormal(&simplifier->points[(uint64_t)indices[0] * 3], &simplifier->points[(uint64_t)indices[1] * 3], &simplifier->points[(uint64_t)indices[2] * 3], normal);
+    const double length = sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+    for (int i = 0; i < 3; ++i) {
+      level->indices[next * 3 + i] = remap[indices[i]];
+      level->surfaceNormals[next * 3 + i] = length > 0 ? (float)(normal[i] / length) : 0;
+    }
+    ++next;
+  }
+  free(remap);
+  PolygonOptimizeVertexCache(level);
+  PolygonOptimizeVertexFetch(level);
+  PolygonCalculateVertexNormals(level);
+  PolygonCalculateBoundingSphere(level);
+  if (bvh) {
+    PolygonBuildBVH(level);
+  }
+  return level;
+}
+
+/**
+ * Build (or rebuild) the level of detail chain of the polygon: polygon->lod holds about ratio times its triangles, its lod the next level, and so on.
+ * Levels stop after levels of them, below POLYGON_LOD_MINIMUM triangles or when no edge can be collapsed any more.
+ * Each level stores its error (lodError) in object space: the largest root mean square distance of a collapsed vertex to the original triangles it stands for.
+ * Levels are plain polygons with float positions and vertex normals of their own, and a BVH if the polygon has one. Build again after modifying the polygon.
+ * @param polygon
+ * @param levels largest number of levels below the polygon
+ * @param ratio triangles of a level relative to the previous one, in (0, 1)
+ * @return
+ */
+bool PolygonBuildLOD(Polygon *polygon, uint32_t levels, Real ratio) {
+  if (!(ratio > 0 && ratio < 1)) {
+    fprintf(stderr, "%s: ratio out of range (%f)\n", __FUNCTION_NAME__, (double)ratio);
+    return false;
+  }
+  if (polygon->triangle * 3 >= UINT32_MAX) {
+    fprintf(stderr, "%s: too many triangles (%llu)\n", __FUNCTION_NAME__, (unsigned long long)polygon->triangle);
+    return false;
+  }
+  if (polygon->lod != NULL) {
+    PolygonDestroy(polygon->lod);
+    polygon->lod = NULL;
+  }
+  polygon->lodError = 0;
+
+  PolygonSimplifier simplifier = {0};
+  const uint64_t triangle = simplifier.triangle = simplifier.remaining = polygon->triangle;
+  const uint64_t vertex = simplifier.vertex = polygon->vertex;
+  const uint64_t corner = triangle * 3;
+  simplifier.points = (double *)malloc((vertex > 0 ? vertex : 1) * 3 * sizeof(double));
+  simplifier.indices = (uint32_t *)malloc((corner > 0 ? corner : 1) * sizeof(uint32_t));
+  simplifier.removed = (uint8_t *)calloc(triangle > 0 ? triangle : 1, sizeof(uint8_t));
+  simplifier.merged = (uint8_t *)calloc(vertex > 0 ? vertex : 1, sizeof(uint8_t));
+  simplifier.stamps = (uint32_t *)calloc(vertex > 0 ? vertex : 1, sizeof(uint32_t));
+  simplifier.marks = (uint32_t *)calloc(vertex > 0 ? vertex : 1, sizeof(uint32_t));
+  simplifier.quadrics = (PolygonQuadric *)calloc(vertex > 0 ? vertex : 1, sizeof(PolygonQuadric));
+  simplifier.heads = (uint32_t *)malloc((vertex > 0 ? vertex : 1) * sizeof(uint32_t));
+  simplifier.tails = (uint32_t *)malloc((vertex > 0 ? vertex : 1) * sizeof(uint32_t));
+  simplifier.nexts = (uint32_t *)malloc((corner > 0 ? corner : 1) * sizeof(uint32_t));
+  simplifier.heapCapacity = corner > 0 ? corner : 1;
+  simplifier.heap = (PolygonCollapse *)malloc(simplifier.heapCapacity * sizeof(PolygonCollapse));
+  uint64_t *edges = (uint64_t *)malloc((corner > 0 ? corner : 1) * sizeof(uint64_t)); // lower vertex << 32 | higher vertex
+  bool allocated = true;
+  if (simplifier.points == NULL || simplifier.indices == NULL || simplifier.removed == NULL || simplifier.merged == NULL || simplifier.stamps == NULL || simplifier.marks == NULL ||
+      simplifier.quadrics == NULL || simplifier.heads == NULL || simplifier.tails == NULL || simplifier.nexts == NULL || simplifier.heap == NULL || edges == NULL) {
+    fprintf(stderr, "%s: failed to allocate memory\n", __FUNCTION_NAME__);
+    allocated = false;
+    levels = 0;
+  }
+
+  // quadrics of the planes of the triangles around each vertex, linked lists of the corners of each vertex
+  for (uint64_t v = 0; levels > 0 && v < vertex; ++v) {
+    const Vector position = PolygonGetPosition(polygon, (uint32_t)v);
+    simplifier.points[v * 3] = (double)position.x;
+    simplifier.points[v * 3 + 1] = (double)position.y;
+    simplifier.points[v * 3 + 2] = (double)position.z;
+    simplifier.heads[v] = UINT32_MAX;
+  }
+  for (uint64_t c = 0; levels > 0 && c < corner; ++c) {
+    const uint32_t v = simplifier.indices[c] = polygon->indices[c];
+    simplifier.nexts[c] = UINT32_MAX;
+    if (simplifier.heads[v] == UINT32_MAX) {
+      simplifier.heads[v] = (uint32_t)c;
+    } else {
+      simplifier.nexts[simplifier.tails[v]] = (uint32_t)c;
+    }
+    simplifier.tails[v] = (uint32_t)c;
+  }
+  for (uint64_t t = 0; levels > 0 && t < triangle; ++t) {
+    const uint32_t *indices = &simplifier.indices[t * 3];
+    double normal[3];
+    _PolygonNormal(&simplifier.points[(uint64_t)indices[0] * 3], &simplifier.points[(uint64_t)indices[1] * 3], &simplifier.points[(uint64_t)indices[2] * 3], normal);
+    const double length = sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+    for (int i = 0; i < 3; ++i) {
+      edges[t * 3 + i] = indices[i] < indices[(i + 1) % 3] ? (uint64_t)indices[i] << 32 | indices[(i + 1) % 3] : (uint64_t)indices[(i + 1) % 3] << 32 | indices[i];
+    }
+    if (length == 0) {
+      continue;
+    }
+    const double *p0 = &simplifier.points[(uint64_t)indices[0] * 3];
+    const double a = normal[0] / length, b = normal[1] / length, c = normal[2] / length;
+    for (int i = 0; i < 3; ++i) {
+      _PolygonQuadricAddPlane(&simplifier.quadrics[indices[i]], a, b, c, -(a * p0[0] + b * p0[1] + c * p0[2]), length * 0.5);
+    }
+  }
+
+  // every edge once; border edges (of a single triangle) get a perpendicular plane
+  if (levels > 0) {
+    qsort(edges, corner, sizeof(uint64_t), _PolygonCompareEdges);
+  }
+  for (uint64_t e = 0, end; levels > 0 && e < corner; e = end) {
+    for (end = e + 1; end < corner && edges[end] == edges[e]; ++end) {
+    }
+    const uint32_t v0 = (uint32_t)(edges[e] >> 32), v1 = (uint32_t)edges[e];
+    if (end - e == 1) {
+      for (uint32_t c = simplifier.heads[v0]; c != UINT32_MAX; c = simplifier.nexts[c]) {
+        const uint32_t *indices = &simplifier.indices[(c / 3) * 3];
+        if (indices[0] != v1 && indices[1] != v1 && indices[2] != v1) {
+          continue;
+        }
+        const double *p0 = &simplifier.points[(uint64_t)v0 * 3], *p1 = &simplifier.points[(uint64_t)v1 * 3];
+        double normal[3];
+        _PolygonNormal(&simplifier.points[(uint64_t)indices[0] * 3], &simplifier.points[(uint64_t)indices[1] * 3], &simplifier.points[(uint64_t)indices[2] * 3], normal);
+        const double edge[3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+        double border[3];
+        _PolygonCross(edge, normal, border);
+        const double length = sqrt(border[0] * border[0] + border[1] * border[1] + border[2] * border[2]);
+        if (length > 0) {
+          const double a = border[0] / length, b = border[1] / length, c = border[2] / length, d = -(a * p0[0] + b * p0[1] + c * p0[2]);
+          const double weight = (edge[0] * edge[0] + edge[1] * edge[1] + edge[2] * edge[2]) * POLYGON_BORDER_WEIGHT;
+          _PolygonQuadricAddPlane(&simplifier.quadrics[v0], a, b, c, d, weight);
+          _PolygonQuadricAddPlane(&simplifier.quadrics[v1], a, b, c, d, weight);
+        }
+        break;
+      }
+    }
+    if (v0 != v1) {
+      _PolygonPushCollapse(&simplifier, v0, v1);
+    }
+  }
+  free(edges);
+
+  // collapse the cheapest edges, taking a level each time few enough triangles remain
+  Polygon *last = polygon;
+  double error = 0;
+  uint64_t target = (uint64_t)(triangle * ratio);
+  for (uint32_t level = 0; level < levels && target >= POLYGON_LOD_MINIMUM;) {
+    bool collapsed = false;
+    while (simplifier.remaining > target && simplifier.heapSize > 0) {
+      const PolygonCollapse collapse = _PolygonHeapPop(&simplifier);
+      if (simplifier.merged[collapse.from] || simplifier.merged[collapse.to] || simplifier.stamps[collapse.from] != collapse.fromStamp ||
+          simplifier.stamps[collapse.to] != collapse.toStamp || !_PolygonCollapseValid(&simplifier, &collapse)) {
+        continue;
+      }
+      _PolygonApplyCollapse(&simplifier, &collapse);
+      error = fmax(error, collapse.cost);
+      collapsed = true;
+    }
+    if (!collapsed || simplifier.remaining >= last->triangle) {
+      break;
+    }
+    last->lod = _PolygonSimplifiedLevel(&simplifier, polygon->bvh != NULL);
+    last = last->lod;
+    last->lodError = (Real)sqrt(error);
+    target = (uint64_t)(simplifier.remaining * ratio);
+    ++level;
+    if (simplifier.heapSize == 0) {
+      break;
+    }
+  }
+
+  free(simplifier.heap);
+  free(simplifier.nexts);
+  free(simplifier.tails);
+  free(simplifier.heads);
+  free(simplifier.quadrics);
+  free(simplifier.marks);
+  free(simplifier.stamps);
+  free(simplifier.merged);
+  free(simplifier.removed);
+  free(simplifier.indices);
+  free(simplifier.points);
+  return allocated;
+}
+
+/**
+ * Coarsest level of detail of the polygon whose error is at most maximumError (object space), the polygon itself if there is none
+ * @param polygon
+ * @param maximumError
+ * @return
+ */
+const Polygon *PolygonSelectLOD(const Polygon *polygon, Real maximumError) {
+  while (polygon->lod != NULL && polygon->lod->lodError <= maximumError) {
+    polygon = polygon->lod;
+  }
+  return polygon;
+}
@@ -0,0 +1,374 @@
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "polygon.h"
+
+int main() {
+  {
+    // two triangles sharing an edge, -0 welds with +0
+    const STLTriangle triangles[2] = {{{0, 0, 1}, {{0, 0, 0}, {1, 0, 0}, {0, 1, 0}}, 0}, {{0, 0, 1}, {{1, 0, 0}, {1, 1, 0}, {0, 1, -0.0f}}, 0}};
+    Polygon *polygon = PolygonCreateFromSTL(triangles, 2);
+    assert(polygon != NULL);
+    assert(polygon->triangle == 2);
+    assert(polygon->vertex == 4);
+    const uint32_t indices[6] = {0, 1, 2, 1, 3, 2};
+    for (int i = 0; i < 6; ++i) {
+      assert(polygon->indices[i] == indices[i]);
+    }
+    assert(VectorCompare(polygon->boundingCenter, V(0.5, 0.5, 0)));
+
+    PolygonCalculateVertexNormals(polygon);
+    for (uint32_t i = 0; i < 4; ++i) {
+      assert(VectorCompare(PolygonGetNormal(polygon, i), V(0, 0, 1)));
+    }
+    const Triangle t = PolygonGetTriangle(polygon, 1);
+    assert(VectorCompare(t.surfaceNormal, V(0, 0, 1)));
+    assert(VectorCompare(t.vertexes[0], V(1, 0, 0)));
+    assert(VectorCompare(t.vertexes[1], V(1, 1, 0)));
+    assert(VectorCompare(t.vertexes[2], V(0, 1, 0)));
+    assert(VectorCompare(t.vertexNormals[2], V(0, 0, 1)));
+    PolygonDestroy(polygon);
+  }
+  {
+    // two faces meeting at the origin with angles of 45 and 90 degrees, twice areas of 2 and 1
+    const STLTriangle triangles[2] = {{{0, 0, 1}, {{0, 0, 0}, {2, 0, 0}, {1, 1, 0}}, 0}, {{1, 0, 0}, {{0, 0, 0}, {0, 1, 0}, {0, 0, 1}}, 0}};
+    Polygon *polygon = PolygonCreateFromSTL(triangles, 2);
+    assert(polygon != NULL && polygon->vertex == 5 && polygon->indices[3] == 0);
+    PolygonCalculateWeightedVertexNormals(polygon, UniformNormalWeighting);
+    assert(VectorCompareLoose(PolygonGetNormal(polygon, 0), VectorL2Normalization(V(1, 0, 1)), 1e-6));
+    PolygonCalculateWeightedVertexNormals(polygon, AreaNormalWeighting);
+    assert(VectorCompareLoose(PolygonGetNormal(polygon, 0), VectorL2Normalization(V(1, 0, 2)), 1e-6));
+    PolygonCalculateWeightedVertexNormals(polygon, AngleNormalWeighting);
+    assert(VectorCompareLoose(PolygonGetNormal(polygon, 0), VectorL2Normalization(V(2, 0, 1)), 1e-6));
+    PolygonDestroy(polygon);
+  }
+  {
+    // grid large enough for the parallel weld: vertexes are numbered in order of first occurrence
+    const uint32_t n = 200;
+    STLTriangle *triangles = calloc(2 * n * n, sizeof(STLTriangle));
+    for (uint32_t y = 0; y < n; ++y) {
+      for (uint32_t x = 0; x < n; ++x) {
+        const float corners[4][3] = {{x, y, 0}, {x + 1, y, 0}, {x, y + 1, 0}, {x + 1, y + 1, 0}};
+        const int faces[2][3] = {{0, 1, 2}, {1, 3, 2}};
+        for (int face = 0; face < 2; ++face) {
+          for (int vertexIndex = 0; vertexIndex < 3; ++vertexIndex) {
+            memcpy(triangles[(y * n + x) * 2 + face].vertexes[vertexIndex], corners[faces[face][vertexIndex]], sizeof(corners[0]));
+          }
+        }
+      }
+    }
+    Polygon *polygon = PolygonCreateFromSTL(triangles, 2 * n * n);
+    assert(polygon != NULL && polygon->vertex == (n + 1) * (n + 1));
+    uint32_t next = 0;
+    for (uint64_t corner = 0; corner < polygon->triangle * 3; ++corner) {
+      const uint32_t index = polygon->indices[corner];
+      assert(index <= next);
+      next += index == next;
+      const float *expected = triangles[corner / 3].vertexes[corner % 3];
+      assert(VectorCompare(PolygonGetPosition(polygon, index), V(expected[0], expected[1], expected[2])));
+      UNUSED(expected);
+    }
+    assert(next == polygon->vertex);
+
+    // reordering keeps the triangles and improves the cache miss ratio
+    Polygon *optimized = PolygonCreateFromSTL(triangles, 2 * n * n);
+    const double before = PolygonVertexCacheMissRatio(optimized, 32);
+    PolygonOptimizeVertexCache(optimized);
+    PolygonOptimizeVertexFetch(optimized);
+    const double after = PolygonVertexCacheMissRatio(optimized, 32);
+    assert(after < before && after < 0.8);
+    UNUSED(before);
+    UNUSED(after);
+    uint64_t positionSum[2] = {0, 0};
+    for (uint64_t corner = 0; corner < polygon->triangle * 3; ++corner) {
+      const Vector a = PolygonGetPosition(polygon, polygon->indices[corner]), b = PolygonGetPosition(optimized, optimized->indices[corner]);
+      positionSum[0] += (uint64_t)(a.x * 3 + a.y * 5 * n);
+      positionSum[1] += (uint64_t)(b.x * 3 + b.y * 5 * n);
+    }
+    assert(positionSum[0] == positionSum[1]);
+    next = 0;
+    for (uint64_t corner = 0; corner < optimized->triangle * 3; ++corner) {
+      assert(optimized->indices[corner] <= next);
+      next += optimized->indices[corner] == next;
+    }
+    PolygonDestroy(optimized);
+
+    // native mesh format: same buffers, mapped copy-on-write so that normals can be recalculated
+    PolygonCalculateVertexNormals(polygon);
+    const bool written = PolygonWriteMesh(polygon, "polygon_test.mesh");
+    assert(written);
+    UNUSED(written);
+    Polygon *mesh = PolygonReadMesh("polygon_test.mesh");
+    assert(mesh != NULL && mesh->triangle == polygon->triangle && mesh->vertex == polygon->vertex);
+    assert(memcmp(mesh->positions, polygon->positions, polygon->vertex * 3 * sizeof(float)) == 0);
+    assert(memcmp(mesh->normals, polygon->normals, polygon->vertex * 3 * sizeof(float)) == 0);
+    assert(memcmp(mesh->surfaceNormals, polygon->surfaceNormals, polygon->triangle * 3 * sizeof(float)) == 0);
+    assert(memcmp(mesh->indices, polygon->indices, polygon->triangle * 3 * sizeof(uint32_t)) == 0);
+    assert(VectorCompareLoose(mesh->boundingCenter, polygon->boundingCenter, 1e-9) && FABS(mesh->boundingRadius - polygon->boundingRadius) < 1e-9);
+    PolygonCalculateWeightedVertexNormals(mesh, AreaNormalWeighting);
+    PolygonDestroy(mesh);
+
+    // an index out of range and a truncated file are rejected
+    polygon->indices[7] = (uint32_t)polygon->vertex;
+    PolygonWriteMesh(polygon, "polygon_test.mesh");
+    const Polygon *outOfRange = PolygonReadMesh("polygon_test.mesh");
+    FILE *fp = fopen("polygon_test.mesh", "wb");
+    assert(fp != NULL);
+    fwrite(polygon->positions, sizeof(float), 100, fp);
+    fclose(fp);
+    const Polygon *truncated = PolygonReadMesh("polygon_test.mesh");
+    remove("polygon_test.mesh");
+    assert(outOfRange == NULL && truncated == NULL);
+    UNUSED(outOfRange);
+    UNUSED(truncated);
+    PolygonDestroy(polygon);
+    free(triangles);
+  }
+  {
+    // quantized vertexes: positions within half a step of the bounding box, normals within 0.003 degrees
+    const uint32_t n = 64;
+    STLTriangle *triangles = calloc(2 * n * n, sizeof(STLTriangle));
+    for (uint32_t y = 0; y < n; ++y) {
+      for (uint32_t x = 0; x < n; ++x) {
+        float corners[4][3] = {{x, y, 0}, {x + 1, y, 0}, {x, y + 1, 0}, {x + 1, y + 1, 0}};
+        for (int corner = 0; corner < 4; ++corner) {
+          corners[corner][2] = 3 * sinf(corners[corner][0] / 7) * cosf(corners[corner][1] / 5);
+        }
+        const int faces[2][3] = {{0, 1, 2}, {1, 3, 2}};
+        for (int face = 0; face < 2; ++face) {
+          for (int vertexIndex = 0; vertexIndex < 3; ++vertexIndex) {
+            memcpy(triangles[(y * n + x) * 2 + face].vertexes[vertexIndex], corners[faces[face][vertexIndex]], sizeof(corners[0]));
+          }
+        }
+      }
+    }
+    Polygon *polygon = PolygonCreateFromSTL(triangles, 2 * n * n), *quantized = PolygonCreateFromSTL(triangles, 2 * n * n);
+    PolygonCalculateWeightedVertexNormals(polygon, AngleNormalWeighting);
+    PolygonCalculateWeightedVertexNormals(quantized, AngleNormalWeighting);
+    Real positionError = -1, normalError = -1;
+    const bool done = PolygonQuantize(quantized, &positionError, &normalError);
+    assert(done && quantized->positions == NULL && quantized->normals == NULL);
+    UNUSED(done);
+    const Real positionBound = VectorEuclideanNorm(quantized->quantizationScale) / 2 * (1 + 1e-3), normalBound = 0.003 * 3.14159265358979323846 / 180;
+    assert(positionError >= 0 && positionError <= positionBound && normalError >= 0 && normalError <= normalBound);
+    for (uint32_t v = 0; v < polygon->vertex; ++v) {
+      assert(VectorEuclideanDistance(PolygonGetPosition(quantized, v), PolygonGetPosition(polygon, v)) <= positionBound);
+      assert(VectorEuclideanDistance(PolygonGetNormal(quantized, v), PolygonGetNormal(polygon, v)) <= normalBound + 1e-6);
+    }
+    assert(FABS(quantized->boundingRadius - polygon->boundingRadius) <= positionBound);
+
+    // normals are recalculated into the quantized buffer, vertexes are reordered with it, the mesh format stays float only
+    PolygonCalculateWeightedVertexNormals(quantized, AngleNormalWeighting);
+    const Vector normal = PolygonGetNormal(quantized, 100);
+    assert(VectorEuclideanDistance(normal, PolygonGetNormal(polygon, 100)) < 1e-3);
+    PolygonOptimizeVertexCache(quantized);
+    PolygonOptimizeVertexFetch(quantized);
+    for (uint64_t t = 0; t < quantized->triangle; t += 97) {
+      const Triangle triangle = PolygonGetTriangle(quantized, t);
+      assert(FABS(VectorEuclideanNorm(triangle.vertexNormals[0]) - 1) < 1e-6 && triangle.vertexes[2].x <= n);
+      UNUSED(triangle);
+    }
+    const bool written = PolygonWriteMesh(quantized, "polygon_test.mesh");
+    const bool again = PolygonQuantize(quantized, NULL, NULL);
+    assert(!written && !again);
+    UNUSED(normal);
+    UNUSED(written);
+    UNUSED(again);
+
+    // rays through the BVH hit the same triangles as without it, before and after quantization
+    Vector origins[64], directions[64];
+    Real distances[64];
+    uint64_t hits[64];
+    for (int i = 0; i < 64; ++i) {
+      origins[i] = V((i * 37 % 61) + 0.37, (i * 23 % 59) + 0.61, 10);
+      directions[i] = V((i % 5) * 0.1 - 0.2, (i % 7) * 0.1 - 0.3, -1);
+      distances[i] = REAL_MAX;
+      if (!PolygonRaycast(polygon, origins[i], directions[i], &distances[i], &hits[i])) {
+        distances[i] = -1;
+      }
+    }
+    const bool built = PolygonBuildBVH(polygon) && PolygonBuildBVH(quantized);
+    assert(built && polygon->bvh->primitive == polygon->triangle);
+    UNUSED(built);
+    for (int i = 0; i < 64; ++i) {
+      Real distance = REAL_MAX, quantizedDistance = REAL_MAX;
+      uint64_t hit = UINT64_MAX, quantizedHit = UINT64_MAX;
+      const bool found = PolygonRaycast(polygon, origins[i], directions[i], &distance, &hit);
+      const bool quantizedFound = PolygonRaycast(quantized, origins[i], directions[i], &quantizedDistance, &quantizedHit);
+      assert(found == (distances[i] >= 0) && found == quantizedFound);
+      assert(!found || (distance == distances[i] && hit == hits[i] && FABS(quantizedDistance - distance) < 1e-3));
+      UNUSED(found);
+      UNUSED(quantizedFound);
+    }
+    Real shortDistance = 1;
+    uint64_t shortHit;
+    const bool shortFound = PolygonRaycast(polygon, V(10.5, 10.5, 10), V(0, 0, -1), &shortDistance, &shortHit);
+    assert(!shortFound && shortDistance == 1);
+    UNUSED(shortFound);
+    PolygonDestroy(quantized);
+    PolygonDestroy(polygon);
+    free(triangles);
+  }
+  {
+    // levels of detail of a closed unit sphere stay closed, outward and close to the sphere, those of a flat square lose nothing
+    const uint32_t n = 64, m = n / 2;
+    STLTriangle *triangles = calloc(2 * n * m, sizeof(STLTriangle));
+    uint64_t triangle = 0;
+    for (uint32_t j = 0; j < m; ++j) {
+      for (uint32_t i = 0; i < n; ++i) {
+        float corners[4][3];
+        for (uint32_t c = 0; c < 4; ++c) {
+          const uint32_t ring = j + (c >> 1);
+          const double theta = M_PI * ring / m, phi = 2 * M_PI * ((i + (c & 1)) % n) / n;
+          const bool pole = ring == 0 || ring == m;
+          corners[c][0] = pole ? 0 : (float)(sin(theta) * cos(phi));
+          corners[c][1] = pole ? 0 : (float)(sin(theta) * sin(phi));
+          corners[c][2] = (float)cos(theta);
+        }
+        const int faces[2][3] = {{0, 2, 1}, {1, 2, 3}};
+        for (int face = 0; face < 2; ++face) {
+          if ((face == 0 && j == 0) || (face == 1 && j == m - 1)) {
+            continue; // the corners at a pole are one vertex
+          }
+          for (int k = 0; k < 3; ++k) {
+            memcpy(triangles[triangle].vertexes[k], corners[faces[face][k]], sizeof(corners[0]));
+          }
+          ++triangle;
+        }
+      }
+    }
+    Polygon *sphere = PolygonCreateFromSTL(triangles, triangle);
+    free(triangles);
+    assert(sphere->vertex == (uint64_t)n * (m - 1) + 2);
+    const bool built = PolygonBuildLOD(sphere, 8, 0.5);
+    assert(built);
+    UNUSED(built);
+    uint32_t levels = 0;
+    for (const Polygon *level = sphere->lod, *previous = sphere; level != NULL; previous = level, level = level->lod, ++levels) {
+      assert(level->triangle < previous->triangle && level->triangle > previous->triangle / 3 && level->lodError > previous->lodError);
+      assert(level->lodError < 0.02 * (1 << levels));
+      UNUSED(previous);
+      // every edge is shared by two triangles, once in each direction
+      for (uint64_t corner = 0; corner < level->triangle * 3; ++corner) {
+        const uint32_t from = level->indices[corner], to = level->indices[corner / 3 * 3 + (corner + 1) % 3];
+        uint32_t forward = 0, backward = 0;
+        for (uint64_t other = 0; other < level->triangle * 3; ++other) {
+          const uint32_t otherFrom = level->indices[other], otherTo = level->indices[other / 3 * 3 + (other + 1) % 3];
+          forward += otherFrom == from && otherTo == to;
+          backward += otherFrom == to && otherTo == from;
+        }
+        assert(forward == 1 && backward == 1);
+        UNUSED(forward);
+        UNUSED(backward);
+      }
+      for (uint32_t v = 0; v < level->vertex; ++v) {
+        const Vector position = PolygonGetPosition(level, v);
+        assert(FABS(VectorEuclideanNorm(position) - 1) < 2 * level->lodError && VectorDotProduct(PolygonGetNormal(level, v), position) > 0.5);
+        UNUSED(position);
+      }
+      for (uint64_t t = 0; t < level->triangle; ++t) {
+        const Triangle face = PolygonGetTriangle(level, t);
+        assert(VectorDotProduct(face.surfaceNormal, VectorAddition(face.vertexes[0], VectorAddition(face.vertexes[1], face.vertexes[2]))) > 0);
+        UNUSED(face);
+      }
+    }
+    assert(levels >= 5 && PolygonSelectLOD(sphere, 0) == sphere && PolygonSelectLOD(sphere, sphere->lod->lodError) == sphere->lod);
+    PolygonDestroy(sphere);
+
+    const uint32_t cells = 16;
+    triangles = calloc(2 * cells * cells, sizeof(STLTriangle));
+    for (uint32_t y = 0; y < cells; ++y) {
+      for (uint32_t x = 0; x < cells; ++x) {
+        const STLTriangle faces[2] = {{{0, 0, 1}, {{x, y, 0}, {x + 1, y, 0}, {x, y + 1, 0}}, 0}, {{0, 0, 1}, {{x + 1, y, 0}, {x + 1, y + 1, 0}, {x, y + 1, 0}}, 0}};
+        memcpy(&triangles[(y * cells + x) * 2], faces, sizeof(faces));
+      }
+    }
+    Polygon *square = PolygonCreateFromSTL(triangles, 2 * cells * cells);
+    free(triangles);
+    PolygonBuildLOD(square, 8, 0.5);
+    const Polygon *coarsest = PolygonSelectLOD(square, REAL_MAX);
+    assert(coarsest->triangle <= 64 && coarsest->lodError < 1e-6);
+    Real area = 0;
+    for (uint64_t t = 0; t < coarsest->triangle; ++t) {
+      const Triangle face = PolygonGetTriangle(coarsest, t);
+      const Vector cross = VectorCrossProduct(VectorSubtraction(face.vertexes[1], face.vertexes[0]), VectorSubtraction(face.vertexes[2], face.vertexes[0]));
+      assert(cross.z > 0 && FABS(cross.x) + FABS(cross.y) == 0);
+      area += cross.z / 2;
+    }
+    assert(FABS(area - cells * cells) < 1e-3);
+    UNUSED(area);
+    UNUSED(coarsest);
+    PolygonDestroy(square);
+  }
+  {
+    Polygon *polygon = PolygonCreateFromSTL(NULL, 0);
+    assert(polygon != NULL && polygon->vertex == 0);
+    PolygonDestroy(polygon);
+  }
+  {
+    // mapped file: the count must fit the file size
+    const STLTriangle triangles[2] = {{{0, 0, 1}, {{0, 0, 0}, {1, 0, 0}, {0, 1, 0}}, 0}, {{0, 0, 1}, {{1, 0, 0}, {1, 1, 0}, {0, 1, 0}}, 0}};
+    const char header[80] = "solid polygon_test"; // binary files may start with "solid" too
+    const uint32_t triangle = 2;
+    FILE *fp = fopen("polygon_test.stl", "wb");
+    assert(fp != NULL);
+    fwrite(header, sizeof(header), 1, fp);
+    fwrite(&triangle, sizeof(triangle), 1, fp);
+    fwrite(triangles, sizeof(STLTriangle), 2, fp);
+    fclose(fp);
+
+    STLView *view = PolygonMapSTL("polygon_test.stl");
+    assert(view != NULL && view->triangle == 2 && view->size == STL_HEADER_SIZE + 2 * sizeof(STLTriangle));
+    assert(view->triangles[1].vertexes[1][0] == 1 && view->triangles[1].vertexes[1][1] == 1);
+    PolygonUnmapSTL(view);
+    Polygon *polygon = PolygonReadSTL("polygon_test.stl");
+    assert(polygon != NULL && polygon->triangle == 2 && polygon->vertex == 4);
+    PolygonDestroy(polygon);
+
+    fp = fopen("polygon_test.stl", "wb");
+    assert(fp != NULL);
+    fwrite(header, sizeof(header), 1, fp);
+    fwrite(&triangle, sizeof(triangle), 1, fp);
+    fwrite(triangles, sizeof(STLTriangle), 1, fp);
+    fclose(fp);
+    const STLView *truncated = PolygonMapSTL("polygon_test.stl");
+    const Polygon *truncatedPolygon = PolygonReadSTL("polygon_test.stl");
+    remove("polygon_test.stl");
+    const STLView *missing = PolygonMapSTL("polygon_test.stl");
+    assert(truncated == NULL && truncatedPolygon == NULL && missing == NULL);
+    UNUSED(truncated);
+    UNUSED(truncatedPolygon);
+    UNUSED(missing);
+  }
+  {
+    // ASCII file, the name of the solid is not a facet
+    const char *text = "solid facet\n"
+                       "  facet normal 0 0 1\n    outer loop\n      vertex 0 0 0\n      vertex 1 0 0\n      vertex 0 1 0\n    endloop\n  endfacet\n"
+                       "  facet normal 0 0 1.0e0\n    outer loop\n      vertex 1 0 0\n      vertex 1 1 0\n      vertex 0 1 -0\n    endloop\n  endfacet\n"
+                       "endsolid facet\n";
+    FILE *fp = fopen("polygon_test.stl", "wb");
+    assert(fp != NULL);
+    fputs(text, fp);
+    fclose(fp);
+    Polygon *polygon = PolygonReadSTL("polygon_test.stl");
+    assert(polygon != NULL && polygon->triangle == 2 && polygon->vertex == 4);
+    const uint32_t indices[6] = {0, 1, 2, 1, 3, 2};
+    for (int i = 0; i < 6; ++i) {
+      assert(polygon->indices[i] == indices[i]);
+    }
+    assert(VectorCompare(PolygonGetPosition(polygon, 3), V(1, 1, 0)));
+    PolygonDestroy(polygon);
+
+    fp = fopen("polygon_test.stl", "wb");
+    assert(fp != NULL);
+    fputs("solid broken\n  facet normal 0 0 1\n    outer loop\n      vertex 0 0 0\n      vertex 1 x 0\n", fp);
+    fclose(fp);
+    const Polygon *broken = PolygonReadSTL("polygon_test.stl");
+    remove("polygon_test.stl");
+    assert(broken == NULL);
+    UNUSED(broken);
+  }
+  return 0;
+}
@@ -17,28 +17,405 @@ Vector NDCPos2ImagePos(const Camera *camera, const Vector projectionVec) {
 
 Vector ImagePos2NDCPos(const Camera *camera, const Vector imageVec) { return V((Real)-1 + 2 * imageVec.x / camera->image_width, (Real)-1 + 2 * imageVec.y / camera->image_height, -imageVec.z); }
 
-Vector WorldPos2NDCPos(const Camera *camera, const Vector worldVec) {
-  Real _worldPos[][1] = {{worldVec.x}, {worldVec.y}, {worldVec.z}, {1}};
-  Matrix *worldPos = MatrixFromArray(4, 1, _worldPos);
-  Matrix *_ndcPos = MatrixMultiplication(camera->world2ndc, worldPos);
-  Real depth = MatrixGetElement(_ndcPos, 3, 0);
-  Vector ndcPos = V(-MatrixGetElement(_ndcPos, 0, 0) / depth, -MatrixGetElement(_ndcPos, 1, 0) / depth, MatrixGetElement(_ndcPos, 2, 0)); // NOTE: Negative sign corrects orientation of image
-  MatrixDestroy(_ndcPos);
-  MatrixDestroy(worldPos);
-  return ndcPos;
+Vector WorldPos2NDCPos(const Camera *camera, const Vector worldVec) { return ClipPos2NDCPos(Mat4TransformPoint(&camera->world2ndc, worldVec)); }
+
+/**
+ * NDC position of a clip space position (world2ndc applied to a world position), for callers which also need its outcode
+ */
+Vector ClipPos2NDCPos(const Vec4 clipVec) {
+  Real depth = clipVec.w;
+  return V(-clipVec.x / depth, -clipVec.y / depth, clipVec.z); // NOTE: Negative sign corrects orientation of image
 }
 
 // FIXME: This function will be used for phong shading but it's currently broken or not tested. It requires a depth between camera to surface, unfortunately there is no function implemented to do
 // that.
 Vector NDCPos2WorldPos(const Camera *camera, const Vector ndcVec, const Real depth) {
-  Real _ndcPos[][1] = {{ndcVec.x * depth}, {ndcVec.y * depth}, {ndcVec.z}, {depth}}; // NOTE: WorldPos2NDCPos drop one element "depth" from NDC matrix so we need to estimate it
-  Matrix *ndcPos = MatrixFromArray(4, 1, _ndcPos);
-  Matrix *_worldPos = MatrixMultiplication(camera->ndc2world, ndcPos);
-  Vector worldPos = V(MatrixGetElement(_worldPos, 0, 0), MatrixGetElement(_worldPos, 1, 0), MatrixGetElement(_worldPos, 2, 0));
-  MatrixDestroy(_worldPos);
-  MatrixDestroy(ndcPos);
-  return worldPos;
+  Vec4 ndcPos = {ndcVec.x * depth, ndcVec.y * depth, ndcVec.z, depth}; // NOTE: WorldPos2NDCPos drop one element "depth" from NDC matrix so we need to estimate it
+  Vec4 worldPos = Mat4TransformVec4(&camera->ndc2world, ndcPos);
+  return V(worldPos.x, worldPos.y, worldPos.z);
+}
+
+/**
+ * Snap an image coordinate to the subpixel grid
+ * @return false if the coordinate is out of the rasterizable range or NaN
+ */
+bool _RasterizerSnap(const Real value, int64_t *snapped) {
+  if (!(FABS(value) < RASTERIZER_MAX_COORDINATE)) {
+    return false;
+  }
+  *snapped = (int64_t)ROUND(value * RASTERIZER_SUBPIXEL_SCALE);
+  return true;
+}
+
+/**
+ * Pixel containing a subpixel coordinate, clamped to [0, size - 1]
+ */
+uint32_t _RasterizerPixel(const int64_t subpixel, const uint16_t size) {
+  if (subpixel < 0) {
+    return 0;
+  }
+  const int64_t pixel = subpixel >> RASTERIZER_SUBPIXEL_BITS;
+  return pixel < size ? (uint32_t)pixel : (uint32_t)size - 1;
+}
+
+/**
+ * Prepare rasterization of a triangle in image space
+ * @return false if the triangle is degenerate, out of the rasterizable range or does not cover the image
+ */
+bool TriangleEdgesSetup(TriangleEdges *edges, const Vector v1, const Vector v2, const Vector v3, uint16_t imageWidth, uint16_t imageHeight) {
+  const Vector vertexes[3] = {v1, v2, v3};
+  int64_t x[3], y[3];
+  if (imageWidth == 0 || imageHeight == 0) {
+    return false;
+  }
+  for (int i = 0; i < 3; ++i) {
+    if (!_RasterizerSnap(vertexes[i].x, &x[i]) || !_RasterizerSnap(vertexes[i].y, &y[i])) {
+      return false;
+    }
+  }
+
+  const int64_t area = (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]);
+  if (area == 0) {
+    return false;
+  }
+  const int64_t orientation = area > 0 ? 1 : -1;
+
+  const int64_t minX = x[0] < x[1] ? (x[0] < x[2] ? x[0] : x[2]) : (x[1] < x[2] ? x[1] : x[2]);
+  const int64_t maxX = x[0] > x[1] ? (x[0] > x[2] ? x[0] : x[2]) : (x[1] > x[2] ? x[1] : x[2]);
+  const int64_t minY = y[0] < y[1] ? (y[0] < y[2] ? y[0] : y[2]) : (y[1] < y[2] ? y[1] : y[2]);
+  const int64_t maxY = y[0] > y[1] ? (y[0] > y[2] ? y[0] : y[2]) : (y[1] > y[2] ? y[1] : y[2]);
+  if (maxX < 0 || maxY < 0 || minX >= (int64_t)imageWidth * RASTERIZER_SUBPIXEL_SCALE || minY >= (int64_t)imageHeight * RASTERIZER_SUBPIXEL_SCALE) {
+    return false;
+  }
+  edges->minX = _RasterizerPixel(minX, imageWidth);
+  edges->maxX = _RasterizerPixel(maxX, imageWidth);
+  edges->minY = _RasterizerPixel(minY, imageHeight);
+  edges->maxY = _RasterizerPixel(maxY, imageHeight);
+
+  // edge 0 is v2->v3, edge 1 is v3->v1 and edge 2 is v1->v2
+  const int64_t half = RASTERIZER_SUBPIXEL_SCALE / 2;
+  for (int i = 0; i < 3; ++i) {
+    const int a = (i + 1) % 3, b = (i + 2) % 3;
+    const int64_t dx = (x[b] - x[a]) * orientation, dy = (y[b] - y[a]) * orientation;
+    edges->edgeOrigin[i] = dx * (half - y[a]) - dy * (half - x[a]);
+    edges->edgeStepX[i] = (int32_t)(-dy * RASTERIZER_SUBPIXEL_SCALE);
+    edges->edgeStepY[i] = (int32_t)(dx * RASTERIZER_SUBPIXEL_SCALE);
+    // a left edge has the inside on its right, a top edge is horizontal with the inside below it
+    const bool topLeft = edges->edgeStepX[i] > 0 || (edges->edgeStepX[i] == 0 && edges->edgeStepY[i] > 0);
+    edges->edgeBias[i] = topLeft ? 0 : 1;
+  }
+  edges->inverseArea = (Real)1 / (Real)(area * orientation);
+  edges->depths = V(v1.z, v2.z, v3.z);
+  // weights of a covered pixel are non-negative but may not sum to exactly 1, allow a few roundings of the deepest vertex
+  const Real farthest = FMAX(FABS(v1.z), FMAX(FABS(v2.z), FABS(v3.z)));
+  edges->nearestDepth = FMIN(v1.z, FMIN(v2.z, v3.z)) - farthest * 16 * REAL_EPSILON;
+  edges->farthestDepth = FMAX(v1.z, FMAX(v2.z, v3.z)) + farthest * 16 * REAL_EPSILON;
+  edges->compact = area * orientation < INT32_MAX;
+  return true;
+}
+
+/**
+ * Restrict rasterization of a triangle to the pixels of rectangle [minX, maxX] x [minY, maxY]
+ * @return false if no pixel is left
+ */
+bool TriangleEdgesClip(TriangleEdges *edges, uint32_t minX, uint32_t minY, uint32_t maxX, uint32_t maxY) {
+  edges->minX = edges->minX > minX ? edges->minX : minX;
+  edges->minY = edges->minY > minY ? edges->minY : minY;
+  edges->maxX = edges->maxX < maxX ? edges->maxX : maxX;
+  edges->maxY = edges->maxY < maxY ? edges->maxY : maxY;
+  return edges->minX <= edges->maxX && edges->minY <= edges->maxY;
+}
+
+/**
+ * Inside test of a block, stepping edge values from the top-left pixel
+ * @return bit row * RASTERIZER_BLOCK_SIZE + column is set if every edge value is non-negative at that pixel
+ */
+uint64_t _BlockCoverageScalar(const int32_t value[3], const int32_t stepX[3], const int32_t stepY[3]) {
+  int32_t row0 = value[0], row1 = value[1], row2 = value[2];
+  uint64_t coverage = 0;
+  for (uint32_t row = 0; row < RASTERIZER_BLOCK_SIZE; ++row) {
+    int32_t e0 = row0, e1 = row1, e2 = row2;
+    for (uint32_t column = 0; column < RASTERIZER_BLOCK_SIZE; ++column) {
+      coverage |= (uint64_t)((e0 | e1 | e2) >= 0) << (row * RASTERIZER_BLOCK_SIZE + column);
+      e0 += stepX[0];
+      e1 += stepX[1];
+      e2 += stepX[2];
+    }
+    row0 += stepY[0];
+    row1 += stepY[1];
+    row2 += stepY[2];
+  }
+  return coverage;
+}
+
+/**
+ * Coverage of the block of RASTERIZER_BLOCK_SIZE x RASTERIZER_BLOCK_SIZE pixels whose top-left pixel is (blockX, blockY)
+ * Edges that do not cross the block are resolved once per block, the others are stepped per pixel in 32-bit integers.
+ * @return bit (y - blockY) * RASTERIZER_BLOCK_SIZE + (x - blockX) is set if pixel (x, y) is inside the triangle and its bounding box
+ */
+uint64_t TriangleEdgesBlockCoverage(const TriangleEdges *edges, uint32_t blockX, uint32_t blockY) {
+  const int64_t last = RASTERIZER_BLOCK_SIZE - 1;
+  int32_t value[3], stepX[3], stepY[3];
+  for (int i = 0; i < 3; ++i) {
+    const int64_t corner = edges->edgeOrigin[i] - edges->edgeBias[i] + (int64_t)edges->edgeStepX[i] * blockX + (int64_t)edges->edgeStepY[i] * blockY;
+    const int64_t spanX = edges->edgeStepX[i] * last, spanY = edges->edgeStepY[i] * last;
+    if (corner + (spanX > 0 ? spanX : 0) + (spanY > 0 ? spanY : 0) < 0) { // whole block outside
+      return 0;
+    }
+    if (corner + (spanX < 0 ? spanX : 0) + (spanY < 0 ? spanY : 0) >= 0) { // whole block inside
+      value[i] = stepX[i] = stepY[i] = 0;
+    } else {
+      value[i] = (int32_t)corner;
+      stepX[i] = edges->edgeStepX[i];
+      stepY[i] = edges->edgeStepY[i];
+    }
+  }
+
+  uint64_t coverage;
+  switch (RasterizerGetKernel()) {
+#ifdef RASTERIZER_SIMD
+  case AVX2RasterizerKernel:
+    coverage = _BlockCoverageAVX2(value, stepX, stepY);
+    break;
+  case SSE41RasterizerKernel:
+    coverage = _BlockCoverageSSE41(value, stepX, stepY);
+    break;
+#endif
+  default:
+    coverage = _BlockCoverageScalar(value, stepX, stepY);
+    break;
+  }
+
+  const uint32_t firstColumn = edges->minX > blockX ? edges->minX - blockX : 0, lastColumn = edges->maxX - blockX < last ? edges->maxX - blockX : last;
+  const uint32_t firstRow = edges->minY > blockY ? edges->minY - blockY : 0, lastRow = edges->maxY - blockY < last ? edges->maxY - blockY : last;
+  const uint64_t columns = ((1u << (lastColumn + 1)) - 1) & ~((1u << firstColumn) - 1);
+  uint64_t bounds = 0;
+  for (uint32_t row = firstRow; row <= lastRow; ++row) {
+    bounds |= columns << (row * RASTERIZER_BLOCK_SIZE);
+  }
+  return coverage & bounds;
+}
+
+/**
+ * Barycentric weights at the center of pixel (x, y), evaluated exactly from the integer edge values
+ */
+Vector TriangleEdgesWeight(const TriangleEdges *edges, uint32_t x, uint32_t y) {
+  Real weight[3];
+  for (int i = 0; i < 3; ++i) {
+    weight[i] = (Real)(edges->edgeOrigin[i] + (int64_t)edges->edgeStepX[i] * x + (int64_t)edges->edgeStepY[i] * y) * edges->inverseArea;
+  }
+  return V(weight[0], weight[1], weight[2]);
+}
+
+#define ZBUFFER_UNORM24_MAX 0xffffff
+#define ZBUFFER_UNORM16_MAX 0xffff
+
+/*
+ * Depths are compared as keys: smaller is nearer in every format and untouched pixels are REAL_MAX.
+ * The key of a depth is the depth rounded to the format, so that equal stored depths compare equal.
+ * Unorm formats reserve their largest value for untouched pixels.
+ */
+Real _ZBufferDepthKey(const DepthFormat format, const Real depth) {
+  switch (format) {
+  case Float32DepthFormat:
+    return (float)depth;
+  case Unorm24DepthFormat:
+    return ROUND(CONFINE(depth, 0, 1) * (ZBUFFER_UNORM24_MAX - 1));
+  case Unorm16DepthFormat:
+    return ROUND(CONFINE(depth, 0, 1) * (ZBUFFER_UNORM16_MAX - 1));
+  case ReversedFloat32DepthFormat:
+    return -(float)(1 - depth);
+  default:
+    return depth;
+  }
+}
+
+Real _ZBufferLoadKey(const ZBuffer *zbuffer, const uint32_t index) {
+  switch (zbuffer->format) {
+  case Float32DepthFormat: {
+    const float depth = ((const float *)zbuffer->depths)[index];
+    return depth == FLT_MAX ? REAL_MAX : depth;
+  }
+  case Unorm24DepthFormat: {
+    const uint32_t depth = ((const uint32_t *)zbuffer->depths)[index];
+    return depth == ZBUFFER_UNORM24_MAX ? REAL_MAX : depth;
+  }
+  case Unorm16DepthFormat: {
+    const uint16_t depth = ((const uint16_t *)zbuffer->depths)[index];
+    return depth == ZBUFFER_UNORM16_MAX ? REAL_MAX : depth;
+  }
+  case ReversedFloat32DepthFormat: {
+    const float depth = ((const float *)zbuffer->depths)[index];
+    return depth == -FLT_MAX ? REAL_MAX : -depth;
+  }
+  default:
+    return ((const Real *)zbuffer->depths)[index];
+  }
+}
+
+void _ZBufferStoreKey(const ZBuffer *zbuffer, const uint32_t index, const Real key) {
+  const bool untouched = key == REAL_MAX;
+  switch (zbuffer->format) {
+  case Float32DepthFormat:
+    ((float *)zbuffer->depths)[index] = untouched ? FLT_MAX : (float)key;
+    break;
+  case Unorm24DepthFormat:
+    ((uint32_t *)zbuffer->depths)[index] = untouched ? ZBUFFER_UNORM24_MAX : (uint32_t)key;
+    break;
+  case Unorm16DepthFormat:
+    ((uint16_t *)zbuffer->depths)[index] = untouched ? ZBUFFER_UNORM16_MAX : (uint16_t)key;
+    break;
+  case ReversedFloat32DepthFormat:
+    ((float *)zbuffer->depths)[index] = untouched ? -FLT_MAX : (float)-key;
+    break;
+  default:
+    ((Real *)zbuffer->depths)[index] = key;
+    break;
+  }
+}
+
+Real _ZBufferKeyDepth(const DepthFormat format, const Real key) {
+  if (key == REAL_MAX) {
+    return REAL_MAX;
+  }
+  switch (format) {
+  case Unorm24DepthFormat:
+    return key / (ZBUFFER_UNORM24_MAX - 1);
+  case Unorm16DepthFormat:
+    return key / (ZBUFFER_UNORM16_MAX - 1);
+  case ReversedFloat32DepthFormat:
+    return 1 + key;
+  default:
+    return key;
+  }
+}
+
+/**
+ * Depth test of a fragment against the z-buffer, with the depth rounded to the format
+ * @return true if the fragment passes (not deeper than the stored depth, or equal to it for EqualDepthTest)
+ */
+bool _ZBufferTest(ZBuffer *zbuffer, const DepthTestType depthTest, const uint32_t index, const Real depth) {
+  const Real key = _ZBufferDepthKey(zbuffer->format, depth);
+  const Real current = _ZBufferLoadKey(zbuffer, index);
+  if (depthTest == EqualDepthTest) {
+    return current == key;
+  }
+  if (current < key) {
+    return false;
+  }
+  _ZBufferStoreKey(zbuffer, index, key);
+  return true;
+}
+
+uint32_t _DepthTestRowScalar(const TriangleEdges *edges, ZBuffer *zbuffer, DepthTestType depthTest, uint32_t blockX, uint32_t y, uint32_t mask, FragmentRow *fragments) {
+  uint32_t passed = 0;
+  for (uint32_t lane = 0; lane < RASTERIZER_BLOCK_SIZE; ++lane) {
+    if (!(mask >> lane & 1)) {
+      continue;
+    }
+    const Vector weight = TriangleEdgesWeight(edges, blockX + lane, y);
+    const Real depth = VectorDotProduct(weight, edges->depths);
+    fragments->weights[0][lane] = weight.x;
+    fragments->weights[1][lane] = weight.y;
+    fragments->weights[2][lane] = weight.z;
+    fragments->depths[lane] = depth;
+    if (zbuffer == NULL || _ZBufferTest(zbuffer, depthTest, ZBufferPixelIndex(zbuffer, blockX + lane, y), depth)) {
+      passed |= 1u << lane;
+    }
+  }
+  return passed;
+}
+
+/**
+ * Interpolate depth of the pixels (blockX + lane, y) selected by mask and run the depth test on them.
+ * Weights and depths of the selected pixels are stored into fragments.
+ * Both passes of a depth prepass must run on the same kernel, so that depths compare equal.
+ * @return mask of the pixels which passed the depth test (all selected pixels if zbuffer is NULL)
+ */
+uint32_t TriangleEdgesDepthTestRow(const TriangleEdges *edges, ZBuffer *zbuffer, DepthTestType depthTest, uint32_t blockX, uint32_t y, uint32_t mask, FragmentRow *fragments) {
+#if defined(RASTERIZER_SIMD) && defined(RENDER_REAL_FLOAT)
+  // whole row loads, 32-bit edge values and float depths (Real is float)
+  if (edges->compact && (zbuffer == NULL || (blockX + RASTERIZER_BLOCK_SIZE <= zbuffer->imageWidth && zbuffer->format != Unorm24DepthFormat && zbuffer->format != Unorm16DepthFormat))) {
+    switch (RasterizerGetKernel()) {
+    case AVX2RasterizerKernel:
+      return _DepthTestRowAVX2(edges, zbuffer, depthTest, blockX, y, mask, fragments);
+    case SSE41RasterizerKernel:
+      return _DepthTestRowSSE41(edges, zbuffer, depthTest, blockX, y, mask, fragments);
+    default:
+      break;
+    }
+  }
+#endif
+  return _DepthTestRowScalar(edges, zbuffer, depthTest, blockX, y, mask, fragments);
+}
+
+/**
+ * Interpolate vertex attributes a, b and c with the weights of the fragments selected by mask
+ */
+void FragmentRowInterpolate(const FragmentRow *fragments, uint32_t mask, const Vector a, const Vector b, const Vector c, Vector *values) {
+#if defined(RASTERIZER_SIMD) && defined(RENDER_REAL_FLOAT)
+  switch (RasterizerGetKernel()) {
+  case AVX2RasterizerKernel:
+    _FragmentRowInterpolateAVX2(fragments, a, b, c, values);
+    return;
+  case SSE41RasterizerKernel:
+    _FragmentRowInterpolateSSE41(fragments, a, b, c, values);
+    return;
+  default:
+    break;
+  }
+#endif
+  for (uint32_t lane = 0; lane < RASTERIZER_BLOCK_SIZE; ++lane) {
+    if (mask >> lane & 1) {
+      values[lane] = VectorAddition(VectorScalarMultiplication(a, fragments->weights[0][lane]),
+                                    VectorAddition(VectorScalarMultiplication(b, fragments->weights[1][lane]), VectorScalarMultiplication(c, fragments->weights[2][lane])));
+    }
+  }
+}
+
+RasterizerKernelType _rasterizerKernel = ScalarRasterizerKernel;
+
+#ifdef RASTERIZER_SIMD
+__attribute__((constructor)) void _RasterizerSelectKernel() {
+  __builtin_cpu_init();
+  if (RasterizerKernelSupported(AVX2RasterizerKernel)) {
+    _rasterizerKernel = AVX2RasterizerKernel;
+  } else if (RasterizerKernelSupported(SSE41RasterizerKernel)) {
+    _rasterizerKernel = SSE41RasterizerKernel;
+  }
 }
+#endif
+
+bool RasterizerKernelSupported(RasterizerKernelType kernel) {
+  switch (kernel) {
+  case ScalarRasterizerKernel:
+    return true;
+#ifdef RASTERIZER_SIMD
+  case SSE41RasterizerKernel:
+    return __builtin_cpu_supports("sse4.1");
+  case AVX2RasterizerKernel:
+    return __builtin_cpu_supports("avx2");
+#endif
+  default:
+    return false;
+  }
+}
+
+/**
+ * Override the kernel selected at startup, used to compare kernels
+ */
+bool RasterizerSetKernel(RasterizerKernelType kernel) {
+  if (!RasterizerKernelSupported(kernel)) {
+#ifndef NDEBUG
+    fprintf(stderr, "%s: Unsupported kernel (%d)\n", __FUNCTION_NAME__, kernel);
+#endif
+    return false;
+  }
+  _rasterizerKernel = kernel;
+  return true;
+}
+
+RasterizerKernelType RasterizerGetKernel() { return _rasterizerKernel; }
 
 Triangle rasterize(const Camera *camera, const Triangle triangle) {
   Triangle new = triangle;
@@ -52,6 +429,118 @@ Triangle rasterize(const Camera *camera, const Triangle triangle) {
   return new;
 }
 
+typedef struct tagClipVertex {
+  Vec4 clip;
+  Vector position; // world space
+  Vector normal;
+} ClipVertex;
+
+typedef enum { NearClipPlane, LeftGuardBandPlane, RightGuardBandPlane, BottomGuardBandPlane, TopGuardBandPlane, ClipPlaneCount } ClipPlane;
+
+/**
+ * Signed distance to a clip plane, positive inside.
+ * Points in front of the camera have a negative w (see WorldPos2NDCPos), so -w is the distance along the view direction.
+ */
+Real _RasterizerClipDistance(const Vec4 clip, const ClipPlane plane, const Real near, const Real guardBandX, const Real guardBandY) {
+  switch (plane) {
+  case NearClipPlane:
+    return -clip.w - near;
+  case LeftGuardBandPlane:
+    return clip.x - guardBandX * clip.w;
+  case RightGuardBandPlane:
+    return -clip.x - guardBandX * clip.w;
+  case BottomGuardBandPlane:
+    return clip.y - guardBandY * clip.w;
+  case TopGuardBandPlane:
+    return -clip.y - guardBandY * clip.w;
+  default:
+    return 0;
+  }
+}
+
+ClipVertex _RasterizerClipVertexInterpolate(const ClipVertex *a, const ClipVertex *b, const Real t) {
+  const Vec4 clip = {a->clip.x + (b->clip.x - a->clip.x) * t, a->clip.y + (b->clip.y - a->clip.y) * t, a->clip.z + (b->clip.z - a->clip.z) * t, a->clip.w + (b->clip.w - a->clip.w) * t};
+  return (ClipVertex){clip, VectorAddition(a->position, VectorScalarMultiplication(VectorSubtraction(b->position, a->position), t)),
+                      VectorAddition(a->normal, VectorScalarMultiplication(VectorSubtraction(b->normal, a->normal), t))};
+}
+
+/**
+ * Outcode of a point in clip space (camera->world2ndc): one bit per clip plane (RASTERIZER_OUTCODE_CLIP), then one bit per side of the image, set if the point is outside
+ */
+uint32_t RasterizerClipOutcode(const Camera *camera, const Vec4 clip) {
+  const Real guardBandX = (Real)2 * RASTERIZER_GUARD_BAND / camera->image_width - 1, guardBandY = (Real)2 * RASTERIZER_GUARD_BAND / camera->image_height - 1;
+  uint32_t outside = 0;
+  for (ClipPlane plane = NearClipPlane; plane < ClipPlaneCount; ++plane) {
+    outside |= (uint32_t)!(_RasterizerClipDistance(clip, plane, camera->near, guardBandX, guardBandY) >= 0) << plane;
+  }
+  return outside | (uint32_t)(clip.x < clip.w) << ClipPlaneCount | (uint32_t)(-clip.x < clip.w) << (ClipPlaneCount + 1) | (uint32_t)(clip.y < clip.w) << (ClipPlaneCount + 2) |
+         (uint32_t)(-clip.y < clip.w) << (ClipPlaneCount + 3);
+}
+
+/**
+ * Clip a triangle in world space for rasterization.
+ * Triangles entirely behind the near plane or outside one side of the image are rejected, and the others are split against the near plane and, if needed, the guard band.
+ * Pieces keep the winding and the surface normal of the triangle, their vertexes and vertex normals are interpolated.
+ * @return number of triangles written to pieces (the triangle itself when it needs no clipping)
+ */
+uint32_t RasterizerClipTriangle(const Camera *camera, const Triangle triangle, Triangle pieces[RASTERIZER_CLIP_TRIANGLES]) {
+  const Real guardBandX = (Real)2 * RASTERIZER_GUARD_BAND / camera->image_width - 1, guardBandY = (Real)2 * RASTERIZER_GUARD_BAND / camera->image_height - 1;
+  ClipVertex vertexes[2][RASTERIZER_CLIP_TRIANGLES + 2];
+  uint32_t vertexCount = 3;
+
+  uint32_t outsideAny = 0, outsideAll = ~0u;
+  for (int vertexIndex = 0; vertexIndex < 3; ++vertexIndex) {
+    const Vec4 clip = Mat4TransformPoint(&camera->world2ndc, triangle.vertexes[vertexIndex]);
+    vertexes[0][vertexIndex] = (ClipVertex){clip, triangle.vertexes[vertexIndex], triangle.vertexNormals[vertexIndex]};
+    const uint32_t outside = RasterizerClipOutcode(camera, clip);
+    outsideAny |= outside;
+    outsideAll &= outside;
+  }
+  if (outsideAll != 0) {
+    return 0;
+  }
+  if ((outsideAny & RASTERIZER_OUTCODE_CLIP) == 0) {
+    pieces[0] = triangle;
+    return 1;
+  }
+
+  // Sutherland-Hodgman, intersections are always computed from the inside vertex so that neighbors sharing an edge get the same point
+  int current = 0;
+  for (ClipPlane plane = NearClipPlane; plane < ClipPlaneCount && vertexCount >= 3; ++plane) {
+    if ((outsideAny >> plane & 1) == 0) {
+      continue;
+    }
+    const ClipVertex *input = vertexes[current];
+    ClipVertex *output = vertexes[current ^ 1];
+    uint32_t outputCount = 0;
+    for (uint32_t vertexIndex = 0; vertexIndex < vertexCount; ++vertexIndex) {
+      const ClipVertex *a = &input[vertexIndex], *b = &input[(vertexIndex + 1) % vertexCount];
+      const Real distanceA = _RasterizerClipDistance(a->clip, plane, camera->near, guardBandX, guardBandY);
+      const Real distanceB = _RasterizerClipDistance(b->clip, plane, camera->near, guardBandX, guardBandY);
+      if (distanceA >= 0) {
+        output[outputCount++] = *a;
+      }
+      if ((distanceA >= 0) != (distanceB >= 0)) {
+        output[outputCount++] =
+            distanceA >= 0 ? _RasterizerClipVertexInterpolate(a, b, distanceA / (distanceA - distanceB)) : _RasterizerClipVertexInterpolate(b, a, distanceB / (distanceB - distanceA));
+      }
+    }
+    vertexCount = outputCount;
+    current ^= 1;
+  }
+  if (vertexCount < 3) {
+    return 0;
+  }
+
+  const ClipVertex *polygon = vertexes[current];
+  for (uint32_t pieceIndex = 0; pieceIndex < vertexCount - 2; ++pieceIndex) {
+    pieces[pieceIndex] = (Triangle){triangle.surfaceNormal,
+                                    {polygon[0].position, polygon[pieceIndex + 1].position, polygon[pieceIndex + 2].position},
+                                    {polygon[0].normal, polygon[pieceIndex + 1].normal, polygon[pieceIndex + 2].normal}};
+  }
+  return vertexCount - 2;
+}
+
 void DrawLine(Bitmap *bitmap, const Vector v1, const Vector v2, const RGBTRIPLE *color) {
   Vector unit = VectorL2Normalization(VectorSubtraction(v2, v1));
   Real length = VectorEuclideanDistance(v1, v2);
@@ -62,48 +551,203 @@ void DrawLine(Bitmap *bitmap, const Vector v1, const Vector v2, const RGBTRIPLE
   }
 }
 
-void DrawTriangle(Bitmap *bitmap, const Vector v1, const Vector v2, const Vector v3, const RGBTRIPLE *color, ZBuffer *zbuffer) {
-  const uint32_t maxX = (uint32_t)fminl(fmaxl(fmaxl(v1.x, fmaxl(v2.x, v3.x)), 0), bitmap->dibHeader.bcWidth - 1);
-  const uint32_t minX = (uint32_t)fmaxl(fminl(v1.x, fminl(v2.x, v3.x)), 0);
-  const uint32_t maxY = (uint32_t)fminl(fmaxl(fmaxl(v1.y, fmaxl(v2.y, v3.y)), 0), bitmap->dibHeader.bcHeight - 1);
-  const uint32_t minY = (uint32_t)fmaxl(fminl(v1.y, fminl(v2.y, v3.y)), 0);
-
-  for (uint32_t y = minY; y <= maxY; ++y) {
-    for (uint32_t x = minX; x <= maxX; ++x) {
-      if (VectorInsideTriangle2D(V(x, y, 0), v1, v2, v3)) {
-        Vector weight = VectorBarycentricCoordinateWeight(V(x, y, 0), v1, v2, v3);
-        Real depth = v1.z * weight.x + v2.z * weight.y + v3.z * weight.z;
-        if (zbuffer == NULL || ZBufferTestAndUpdate(zbuffer, x, y, depth)) {
-          BitmapSetPixelColor(bitmap, x, bitmap->dibHeader.bcHeight - y - 1, color);
-        }
-      }
+typedef struct tagSolidShadingContext {
+  Bitmap *bitmap;
+  const RGBTRIPLE *color;
+} SolidShadingContext;
+
+FORCE_INLINE void _ShadeRowSolid(const void *context, uint32_t blockX, uint32_t y, uint32_t passed, const FragmentRow *fragments) {
+  const SolidShadingContext *solid = (const SolidShadingContext *)context;
+  UNUSED(fragments);
+  for (uint32_t lane = 0; lane < RASTERIZER_BLOCK_SIZE; ++lane) {
+    if (passed >> lane & 1) {
+      BitmapSetPixelColor(solid->bitmap, blockX + lane, solid->bitmap->dibHeader.bcHeight - y - 1, solid->color);
     }
   }
 }
 
-ZBuffer *ZBufferCreate(uint16_t imageWidth, uint16_t imageHeight) {
-  uint32_t bufferLength = imageWidth * imageHeight;
+void DrawTriangle(Bitmap *bitmap, const Vector v1, const Vector v2, const Vector v3, const RGBTRIPLE *color, ZBuffer *zbuffer) {
+  TriangleEdges edges;
+  if (!TriangleEdgesSetup(&edges, v1, v2, v3, bitmap->dibHeader.bcWidth, bitmap->dibHeader.bcHeight)) {
+    return;
+  }
+
+  const SolidShadingContext context = {bitmap, color};
+  TriangleEdgesTraverse(&edges, zbuffer, LessEqualDepthTest, _ShadeRowSolid, &context);
+}
+
+/**
+ * Bytes per pixel of a depth format
+ * @return 0 for an unknown format
+ */
+uint32_t ZBufferDepthSize(const DepthFormat format) {
+  switch (format) {
+  case RealDepthFormat:
+    return sizeof(Real);
+  case Float32DepthFormat:
+  case ReversedFloat32DepthFormat:
+    return sizeof(float);
+  case Unorm24DepthFormat:
+    return sizeof(uint32_t);
+  case Unorm16DepthFormat:
+    return sizeof(uint16_t);
+  default:
+    return 0;
+  }
+}
+
+ZBuffer *ZBufferCreate(uint16_t imageWidth, uint16_t imageHeight, DepthFormat format) {
+  const uint32_t depthSize = ZBufferDepthSize(format);
+  if (depthSize == 0) {
+#ifndef NDEBUG
+    fprintf(stderr, "%s: Unknown depth format.\n", __FUNCTION_NAME__);
+#endif
+    return NULL;
+  }
   ZBuffer *zbuffer = (ZBuffer *)calloc(1, sizeof(ZBuffer));
-  Real *depths = (Real *)calloc(bufferLength, sizeof(Real));
   zbuffer->imageWidth = imageWidth;
   zbuffer->imageHeight = imageHeight;
-  zbuffer->depths = depths;
-  for (uint32_t i = 0; i < bufferLength; ++i) {
-    zbuffer->depths[i] = DBL_MAX;
+  zbuffer->format = format;
+  uint32_t levelWidth = (imageWidth + RASTERIZER_BLOCK_SIZE - 1) / RASTERIZER_BLOCK_SIZE, levelHeight = (imageHeight + RASTERIZER_BLOCK_SIZE - 1) / RASTERIZER_BLOCK_SIZE;
+  // whole tiles, pixels beyond the image stay untouched
+  zbuffer->depths = malloc(((size_t)levelWidth * levelHeight * RASTERIZER_BLOCK_SIZE * RASTERIZER_BLOCK_SIZE + 1) * depthSize);
+  for (;;) {
+    const uint8_t level = zbuffer->levels++;
+    zbuffer->levelWidths[level] = levelWidth;
+    zbuffer->levelHeights[level] = levelHeight;
+    zbuffer->maxDepths[level] = (Real *)calloc(levelWidth * levelHeight > 0 ? levelWidth * levelHeight : 1, sizeof(Real));
+    if (level == 0) {
+      zbuffer->tileWrites = (uint64_t *)calloc(levelWidth * levelHeight > 0 ? levelWidth * levelHeight : 1, sizeof(uint64_t));
+      zbuffer->tileWriteMaxDepths = (Real *)calloc(levelWidth * levelHeight > 0 ? levelWidth * levelHeight : 1, sizeof(Real));
+    }
+    if (levelWidth <= 1 && levelHeight <= 1) {
+      break;
+    }
+    levelWidth = (levelWidth + 1) / 2;
+    levelHeight = (levelHeight + 1) / 2;
   }
+  ZBufferClear(zbuffer);
   return zbuffer;
 }
 
+/**
+ * Reset every pixel (and the hierarchical z) to untouched in place, so that a sequence of frames can reuse one z-buffer
+ */
+bool ZBufferClear(ZBuffer *zbuffer) {
+  if (zbuffer == NULL) {
+#ifndef NDEBUG
+    fprintf(stderr, "%s: trying to clear null pointer, ignored.\n", __FUNCTION_NAME__);
+#endif
+    return false;
+  }
+  _ZBufferStoreKey(zbuffer, 0, REAL_MAX);
+  const size_t tiles = (size_t)zbuffer->levelWidths[0] * zbuffer->levelHeights[0];
+  _FillRepeat(zbuffer->depths, ZBufferDepthSize(zbuffer->format), tiles * RASTERIZER_BLOCK_SIZE * RASTERIZER_BLOCK_SIZE);
+  for (uint8_t level = 0; level < zbuffer->levels; ++level) {
+    zbuffer->maxDepths[level][0] = REAL_MAX;
+    _FillRepeat(zbuffer->maxDepths[level], sizeof(Real), (size_t)zbuffer->levelWidths[level] * zbuffer->levelHeights[level]);
+  }
+  memset(zbuffer->tileWrites, 0, tiles * sizeof(uint64_t));
+  zbuffer->tileWriteMaxDepths[0] = -REAL_MAX;
+  _FillRepeat(zbuffer->tileWriteMaxDepths, sizeof(Real), tiles);
+  return true;
+}
+
+/**
+ * Depth key of a depth in the format of zbuffer, to compare with the hierarchical z
+ */
+Real ZBufferDepthKey(const ZBuffer *zbuffer, Real depth) { return _ZBufferDepthKey(zbuffer->format, depth); }
+
+/**
+ * Record pixels written into a tile of level 0 with a key not nearer than any of them.
+ * Pixels only get nearer after being written, so once the written pixels cover the tile (inside the image) their deepest key bounds the tile.
+ */
+void ZBufferMergeTileWrites(const ZBuffer *zbuffer, uint32_t tile, uint64_t written, Real maxKey) {
+  const uint32_t tileX = tile % zbuffer->levelWidths[0], tileY = tile / zbuffer->levelWidths[0];
+  const uint32_t columns = zbuffer->imageWidth - tileX * RASTERIZER_BLOCK_SIZE, rows = zbuffer->imageHeight - tileY * RASTERIZER_BLOCK_SIZE;
+  uint64_t full = UINT64_MAX;
+  if (columns < RASTERIZER_BLOCK_SIZE || rows < RASTERIZER_BLOCK_SIZE) {
+    const uint64_t row = columns < RASTERIZER_BLOCK_SIZE ? (1ULL << columns) - 1 : 0xff;
+    full = 0;
+    for (uint32_t y = 0; y < rows && y < RASTERIZER_BLOCK_SIZE; ++y) {
+      full |= row << (y * RASTERIZER_BLOCK_SIZE);
+    }
+  }
+  zbuffer->tileWrites[tile] |= written;
+  zbuffer->tileWriteMaxDepths[tile] = maxKey > zbuffer->tileWriteMaxDepths[tile] ? maxKey : zbuffer->tileWriteMaxDepths[tile];
+  if ((zbuffer->tileWrites[tile] & full) == full) {
+    Real *tileMaxDepth = &zbuffer->maxDepths[0][tile];
+    *tileMaxDepth = zbuffer->tileWriteMaxDepths[tile] < *tileMaxDepth ? zbuffer->tileWriteMaxDepths[tile] : *tileMaxDepth;
+    zbuffer->tileWrites[tile] = 0;
+    zbuffer->tileWriteMaxDepths[tile] = -REAL_MAX;
+  }
+}
+
+/**
+ * Rebuild the cells of the coarser levels above the pixels [minX, maxX] x [minY, maxY] from level 0
+ */
+void ZBufferUpdateHierarchy(const ZBuffer *zbuffer, uint32_t minX, uint32_t minY, uint32_t maxX, uint32_t maxY) {
+  for (uint8_t level = 1; level < zbuffer->levels; ++level) {
+    const Real *finer = zbuffer->maxDepths[level - 1];
+    const uint32_t finerWidth = zbuffer->levelWidths[level - 1], finerHeight = zbuffer->levelHeights[level - 1];
+    const uint32_t shift = level + RASTERIZER_BLOCK_SHIFT;
+    const uint32_t maxCellX = (maxX >> shift) < zbuffer->levelWidths[level] ? maxX >> shift : zbuffer->levelWidths[level] - 1;
+    const uint32_t maxCellY = (maxY >> shift) < zbuffer->levelHeights[level] ? maxY >> shift : zbuffer->levelHeights[level] - 1;
+    for (uint32_t y = minY >> shift; y <= maxCellY; ++y) {
+      for (uint32_t x = minX >> shift; x <= maxCellX; ++x) {
+        const uint32_t x0 = x * 2, y0 = y * 2, x1 = x0 + 1 < finerWidth ? x0 + 1 : x0, y1 = y0 + 1 < finerHeight ? y0 + 1 : y0;
+        const Real cells[4] = {finer[x0 + finerWidth * y0], finer[x1 + finerWidth * y0], finer[x0 + finerWidth * y1], finer[x1 + finerWidth * y1]};
+        Real maxDepth = cells[0];
+        for (int i = 1; i < 4; ++i) {
+          maxDepth = cells[i] > maxDepth ? cells[i] : maxDepth;
+        }
+        zbuffer->maxDepths[level][x + zbuffer->levelWidths[level] * y] = maxDepth;
+      }
+    }
+  }
+}
+
+/**
+ * Check if a fragment at depth or deeper would fail the depth test on every pixel of [minX, maxX] x [minY, maxY] (clamped to the image).
+ * The box is looked up at the finest level where it spans at most 2 x 2 cells.
+ * @return true if the box is hidden (or outside the image), false if some of it may be visible
+ */
+bool ZBufferBoxOccluded(const ZBuffer *zbuffer, uint32_t minX, uint32_t minY, uint32_t maxX, uint32_t maxY, Real depth) {
+  maxX = maxX < zbuffer->imageWidth ? maxX : (uint32_t)zbuffer->imageWidth - 1;
+  maxY = maxY < zbuffer->imageHeight ? maxY : (uint32_t)zbuffer->imageHeight - 1;
+  if (minX > maxX || minY > maxY) {
+    return true;
+  }
+  uint8_t level = 0;
+  uint32_t shift = RASTERIZER_BLOCK_SHIFT;
+  while (level + 1 < zbuffer->levels && ((maxX >> shift) - (minX >> shift) > 1 || (maxY >> shift) - (minY >> shift) > 1)) {
+    ++level;
+    ++shift;
+  }
+  const Real key = _ZBufferDepthKey(zbuffer->format, depth);
+  for (uint32_t y = minY >> shift; y <= maxY >> shift; ++y) {
+    for (uint32_t x = minX >> shift; x <= maxX >> shift; ++x) {
+      if (!(key > zbuffer->maxDepths[level][x + zbuffer->levelWidths[level] * y])) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
 Real ZBufferGetDepth(const ZBuffer *zbuffer, uint16_t x, uint16_t y) {
   if (zbuffer->imageWidth <= x || zbuffer->imageHeight <= y) {
 #ifndef NDEBUG
     fprintf(stderr, "%s: Invalid depth indices (x:%d<%d, y:%d<%d)\n", __FUNCTION_NAME__, x, zbuffer->imageWidth, y, zbuffer->imageHeight);
 #endif
-    return DBL_MIN;
+    return REAL_MIN;
   }
-  Real depth;
-  depth = zbuffer->depths[x + zbuffer->imageHeight * y];
-  return depth;
+  return _ZBufferKeyDepth(zbuffer->format, _ZBufferLoadKey(zbuffer, ZBufferPixelIndex(zbuffer, x, y)));
+}
+
+void _ZBufferMergePixelWrite(const ZBuffer *zbuffer, uint16_t x, uint16_t y, Real key) {
+  const uint32_t tile = (x >> RASTERIZER_BLOCK_SHIFT) + zbuffer->levelWidths[0] * (y >> RASTERIZER_BLOCK_SHIFT);
+  ZBufferMergeTileWrites(zbuffer, tile, 1ULL << ((y % RASTERIZER_BLOCK_SIZE) * RASTERIZER_BLOCK_SIZE + x % RASTERIZER_BLOCK_SIZE), key);
 }
 
 bool ZBufferSetDepth(const ZBuffer *zbuffer, uint16_t x, uint16_t y, Real depth) {
@@ -113,7 +757,15 @@ bool ZBufferSetDepth(const ZBuffer *zbuffer, uint16_t x, uint16_t y, Real depth)
 #endif
     return false;
   }
-  zbuffer->depths[x + zbuffer->imageHeight * y] = depth;
+  const Real key = _ZBufferDepthKey(zbuffer->format, depth);
+  _ZBufferStoreKey(zbuffer, ZBufferPixelIndex(zbuffer, x, y), key);
+  // the pixel may get deeper, keep every level conservative
+  _ZBufferMergePixelWrite(zbuffer, x, y, key);
+  for (uint8_t level = 0; level < zbuffer->levels; ++level) {
+    const uint32_t shift = level + RASTERIZER_BLOCK_SHIFT;
+    Real *maxDepth = &zbuffer->maxDepths[level][(x >> shift) + zbuffer->levelWidths[level] * (y >> shift)];
+    *maxDepth = FMAX(*maxDepth, key);
+  }
   return true;
 }
 
@@ -126,14 +778,14 @@ bool ZBufferTestAndUpdate(ZBuffer *zbuffer, uint16_t x, uint16_t y, Real depth)
 #endif
     return false;
   }
-  Real currentDepth = ZBufferGetDepth(zbuffer, x, y);
-  if (currentDepth < depth) {
+  if (!_ZBufferTest(zbuffer, LessEqualDepthTest, ZBufferPixelIndex(zbuffer, x, y), depth)) {
 #ifndef NDEBUG
-    fprintf(stderr, "%s: Deeper than current depth (%d, %d) = %Lf < %Lf\n", __FUNCTION_NAME__, x, y, currentDepth, depth);
+    fprintf(stderr, "%s: Deeper than current depth (%d, %d) = " REAL_FORMAT " < " REAL_FORMAT "\n", __FUNCTION_NAME__, x, y, ZBufferGetDepth(zbuffer, x, y), depth);
 #endif
     return false;
   }
-  return ZBufferSetDepth(zbuffer, x, y, depth);
+  _ZBufferMergePixelWrite(zbuffer, x, y, _ZBufferDepthKey(zbuffer->format, depth));
+  return true;
 }
 
 bool ZBufferExportToImage(const ZBuffer *zbuffer, Bitmap *bitmap) {
@@ -147,11 +799,12 @@ bool ZBufferExportToImage(const ZBuffer *zbuffer, Bitmap *bitmap) {
 #endif
     return false;
   }
-  Real maxDepth = DBL_MIN;
+  Real maxDepth = REAL_MIN;
 
-  for (uint32_t i = 0; i < imageWidth * imageHeight; ++i) {
-    const Real depth = zbuffer->depths[i];
-    if (depth != DBL_MAX && depth > maxDepth) {
+  // pixels beyond the image are untouched
+  for (uint32_t i = 0; i < zbuffer->levelWidths[0] * zbuffer->levelHeights[0] * RASTERIZER_BLOCK_SIZE * RASTERIZER_BLOCK_SIZE; ++i) {
+    const Real depth = _ZBufferKeyDepth(zbuffer->format, _ZBufferLoadKey(zbuffer, i));
+    if (depth != REAL_MAX && depth > maxDepth) {
       maxDepth = depth;
     }
   }
@@ -161,7 +814,7 @@ bool ZBufferExportToImage(const ZBuffer *zbuffer, Bitmap *bitmap) {
       const Real depth = ZBufferGetDepth(zbuffer, x, y);
       if (depth < 0) { // Negative depth. maybe bug
         BitmapSetPixelColor(bitmap, x, bitmapHeight - y - 1, BMP_COLOR(0, 0, 255));
-      } else if (depth == DBL_MAX) { // untouched pixel
+      } else if (depth == REAL_MAX) { // untouched pixel
         BitmapSetPixelColor(bitmap, x, bitmapHeight - y - 1, BMP_COLOR(255, 0, 0));
       } else {
         BitmapSetPixelColor(bitmap, x, bitmapHeight - y - 1, BMP_GRAY_SCALE(255 - (255 * depth) / maxDepth));
@@ -179,6 +832,11 @@ bool ZBufferDestroy(ZBuffer *zbuffer) {
 #endif
     return false;
   }
+  for (uint8_t level = 0; level < zbuffer->levels; ++level) {
+    free(zbuffer->maxDepths[level]);
+  }
+  free(zbuffer->tileWriteMaxDepths);
+  free(zbuffer->tileWrites);
   free(zbuffer->depths);
   free(zbuffer);
   return true;
@@ -7,26 +7,207 @@
 #include "polygon.h"
 #include "transformer.h"
 
+/*
+ * Storage of the z-buffer. Depth is 0 at the near plane and 1 at the far plane.
+ * RealDepthFormat keeps depths at full precision, Float32DepthFormat rounds them to float.
+ * Unorm24DepthFormat and Unorm16DepthFormat quantize [0, 1] to 24-bit (stored in 32 bits) and 16-bit integers, uniformly.
+ * ReversedFloat32DepthFormat stores 1 - depth in a float, which is the most precise far from the camera.
+ */
+typedef enum { RealDepthFormat, Float32DepthFormat, Unorm24DepthFormat, Unorm16DepthFormat, ReversedFloat32DepthFormat } DepthFormat;
+
+#define ZBUFFER_MAX_LEVELS 14 // enough to reduce 65535 x 65535 pixels to one cell
+
+/*
+ * Hierarchical z: level 0 holds the deepest depth key of each RASTERIZER_BLOCK_SIZE x RASTERIZER_BLOCK_SIZE tile, level i + 1 the deepest of 2 x 2 cells of level i, up to a single cell.
+ * Keys are the depths as rounded by the format (REAL_MAX for untouched pixels), so a fragment nearer than a cell may pass the depth test somewhere in it and a farther one cannot.
+ * Every level is conservative: a cell is never nearer than the pixels it covers.
+ * Level 0 is kept up to date without reading pixels back: each tile collects the pixels written since its last update and their deepest key,
+ * once every pixel of the tile has been written that key bounds the whole tile. Coarser levels are rebuilt from level 0 by ZBufferUpdateHierarchy.
+ */
 typedef struct tagZBuffer {
   uint16_t imageWidth;
   uint16_t imageHeight;
-  Real *depths;
+  DepthFormat format;
+  void *depths; // Real, float, uint32_t or uint16_t per pixel depending on format, stored in tiles (see ZBufferPixelIndex)
+  uint8_t levels;
+  uint32_t levelWidths[ZBUFFER_MAX_LEVELS];
+  uint32_t levelHeights[ZBUFFER_MAX_LEVELS];
+  Real *maxDepths[ZBUFFER_MAX_LEVELS]; // deepest key per cell of each level, row-major
+  uint64_t *tileWrites;                // pixels of each tile of level 0 written since its last update, bit (y % 8) * 8 + x % 8
+  Real *tileWriteMaxDepths;            // deepest key written into each tile of level 0 since its last update
 } ZBuffer;
 
+/*
+ * Triangles are rasterized with integer edge functions on vertices snapped to a fixed-point grid of RASTERIZER_SUBPIXEL_BITS fractional bits (28.4 by default).
+ * Pixels are sampled at their centers and pixels lying exactly on an edge follow the top-left rule, so triangles sharing an edge never overlap or leave cracks.
+ * Vertices farther than RASTERIZER_MAX_COORDINATE pixels from the image origin are rejected, which keeps the per-pixel edge values in 32-bit integers.
+ */
+#ifndef RASTERIZER_SUBPIXEL_BITS
+#define RASTERIZER_SUBPIXEL_BITS 4
+#endif
+#if RASTERIZER_SUBPIXEL_BITS < 1 || RASTERIZER_SUBPIXEL_BITS > 6
+#error "RASTERIZER_SUBPIXEL_BITS must be between 1 and 6"
+#endif
+#define RASTERIZER_SUBPIXEL_SCALE (1 << RASTERIZER_SUBPIXEL_BITS)
+#define RASTERIZER_MAX_COORDINATE (1 << (25 - 2 * RASTERIZER_SUBPIXEL_BITS))
+#define RASTERIZER_BLOCK_SIZE 8 // pixels are visited in blocks of RASTERIZER_BLOCK_SIZE x RASTERIZER_BLOCK_SIZE
+#define RASTERIZER_BLOCK_SHIFT 3 // log2(RASTERIZER_BLOCK_SIZE)
+
+/**
+ * Index into depths of pixel (x, y).
+ * Depths are stored in the RASTERIZER_BLOCK_SIZE x RASTERIZER_BLOCK_SIZE tiles of level 0 of the hierarchical z, each tile row by row,
+ * so a block of the rasterizer reads and writes one contiguous tile and a block row is RASTERIZER_BLOCK_SIZE contiguous depths.
+ */
+FORCE_INLINE uint32_t ZBufferPixelIndex(const ZBuffer *zbuffer, uint32_t x, uint32_t y) {
+  const uint32_t tile = (x >> RASTERIZER_BLOCK_SHIFT) + zbuffer->levelWidths[0] * (y >> RASTERIZER_BLOCK_SHIFT);
+  return (tile << 2 * RASTERIZER_BLOCK_SHIFT) + (y % RASTERIZER_BLOCK_SIZE) * RASTERIZER_BLOCK_SIZE + x % RASTERIZER_BLOCK_SIZE;
+}
+
+/*
+ * Triangles are clipped in clip space against the near plane only.
+ * The other planes use a guard band: triangles partially off screen are rasterized as they are and the pixel loop is bounded by the image,
+ * only vertices beyond RASTERIZER_GUARD_BAND pixels (too far to be snapped) make the triangle clipped against the guard band edges.
+ */
+#define RASTERIZER_GUARD_BAND (RASTERIZER_MAX_COORDINATE / 2)
+#define RASTERIZER_CLIP_TRIANGLES 6 // near plane and four guard band planes add at most one vertex each: 8 vertices, 6 triangles
+#define RASTERIZER_OUTCODE_CLIP 0x1f // outcode bits of the near plane and the four guard band planes
+
+/**
+ * Edge equations of a triangle in image space.
+ * Edge i is the edge opposite to vertex i, so edge value i divided by the triangle area is the barycentric weight of vertex i.
+ * Edge values are oriented to be positive inside regardless of the winding.
+ */
+typedef struct tagTriangleEdges {
+  uint32_t minX, maxX, minY, maxY; // bounding box clamped to image
+  int64_t edgeOrigin[3];           // edge values at the center of pixel (0, 0)
+  int32_t edgeStepX[3];            // edge values increment per pixel
+  int32_t edgeStepY[3];            // edge values increment per row
+  int32_t edgeBias[3];             // 0 for top-left edges, 1 for the others: a pixel is inside when every edge value >= bias
+  Real inverseArea;
+  Vector depths;      // depth of each vertex
+  Real nearestDepth;  // lower bound of the interpolated depths, rounding included
+  Real farthestDepth; // upper bound of the interpolated depths, rounding included
+  bool compact;      // edge values of covered pixels fit in 32-bit integers (twice the area is below 2^31 subpixels)
+} TriangleEdges;
+
+/**
+ * Barycentric weights and depths of the pixels of one block row, indexed by x - blockX
+ */
+typedef struct tagFragmentRow {
+  Real weights[3][RASTERIZER_BLOCK_SIZE];
+  Real depths[RASTERIZER_BLOCK_SIZE];
+} FragmentRow;
+
+/*
+ * Pixel kernels run on SSE4.1 or AVX2 when built with RENDER_SIMD and supported by the CPU, the best one is selected at startup.
+ * Coverage is vectorized for every Real type, depth test and interpolation need Real to be float.
+ */
+typedef enum { ScalarRasterizerKernel, SSE41RasterizerKernel, AVX2RasterizerKernel } RasterizerKernelType;
+
+/*
+ * LessEqualDepthTest passes fragments not deeper than the z-buffer and stores their depth.
+ * EqualDepthTest passes fragments exactly at the stored depth and leaves the z-buffer untouched, to shade only the visible fragments after a depth-only pass.
+ */
+typedef enum { LessEqualDepthTest, EqualDepthTest } DepthTestType;
+
+#if defined(RENDER_SIMD) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define RASTERIZER_SIMD
+#endif
+
 Vector NDCPos2ImagePos(const Camera *camera, Vector projectionVec);
 Vector ImagePos2NDCPos(const Camera *camera, Vector imageVec);
 Vector WorldPos2NDCPos(const Camera *camera, Vector worldVec);
+Vector ClipPos2NDCPos(Vec4 clipVec);
 Vector NDCPos2WorldPos(const Camera *camera, Vector ndcVec, Real depth);
 
 Triangle rasterize(const Camera *camera, Triangle triangle);
+uint32_t RasterizerClipOutcode(const Camera *camera, Vec4 clip);
+uint32_t RasterizerClipTriangle(const Camera *camera, Triangle triangle, Triangle pieces[RASTERIZER_CLIP_TRIANGLES]);
+
+bool TriangleEdgesSetup(TriangleEdges *edges, Vector v1, Vector v2, Vector v3, uint16_t imageWidth, uint16_t imageHeight);
+bool TriangleEdgesClip(TriangleEdges *edges, uint32_t minX, uint32_t minY, uint32_t maxX, uint32_t maxY);
+uint64_t TriangleEdgesBlockCoverage(const TriangleEdges *edges, uint32_t blockX, uint32_t blockY);
+Vector TriangleEdgesWeight(const TriangleEdges *edges, uint32_t x, uint32_t y);
+uint32_t TriangleEdgesDepthTestRow(const TriangleEdges *edges, ZBuffer *zbuffer, DepthTestType depthTest, uint32_t blockX, uint32_t y, uint32_t mask, FragmentRow *fragments);
+void FragmentRowInterpolate(const FragmentRow *fragments, uint32_t mask, Vector a, Vector b, Vector c, Vector *values);
+
+Real ZBufferDepthKey(const ZBuffer *zbuffer, Real depth);
+void ZBufferMergeTileWrites(const ZBuffer *zbuffer, uint32_t tile, uint64_t written, Real maxKey);
+bool ZBufferBoxOccluded(const ZBuffer *zbuffer, uint32_t minX, uint32_t minY, uint32_t maxX, uint32_t maxY, Real depth);
+
+/**
+ * Visit a triangle block row by block row: coverage and depth test, then shade(context, blockX, y, passed, fragments) for the pixels (blockX + lane, y) which passed.
+ * This is the only pixel loop of the rasterizer. It is inlined into its callers so that a constant shade is inlined as well, giving one specialized loop per shader.
+ * The hierarchical z rejects the whole triangle, or blocks of it, lying behind every pixel they cover. Blocks which stored depths report them to their tile, bounded by the farthest vertex.
+ * @return number of shaded pixels
+ */
+FORCE_INLINE uint64_t TriangleEdgesTraverse(const TriangleEdges *edges, ZBuffer *zbuffer, DepthTestType depthTest, void shade(const void *, uint32_t, uint32_t, uint32_t, const FragmentRow *),
+                                            const void *context) {
+  Real nearestKey = 0, farthestKey = 0;
+  if (zbuffer != NULL) {
+    if (ZBufferBoxOccluded(zbuffer, edges->minX, edges->minY, edges->maxX, edges->maxY, edges->nearestDepth)) {
+      return 0;
+    }
+    nearestKey = ZBufferDepthKey(zbuffer, edges->nearestDepth);
+    farthestKey = ZBufferDepthKey(zbuffer, edges->farthestDepth);
+  }
+  uint64_t shaded = 0;
+  for (uint32_t blockY = edges->minY - edges->minY % RASTERIZER_BLOCK_SIZE; blockY <= edges->maxY; blockY += RASTERIZER_BLOCK_SIZE) {
+    for (uint32_t blockX = edges->minX - edges->minX % RASTERIZER_BLOCK_SIZE; blockX <= edges->maxX; blockX += RASTERIZER_BLOCK_SIZE) {
+      const uint32_t tile = blockX / RASTERIZER_BLOCK_SIZE + (zbuffer != NULL ? zbuffer->levelWidths[0] : 0) * (blockY / RASTERIZER_BLOCK_SIZE);
+      if (zbuffer != NULL && nearestKey > zbuffer->maxDepths[0][tile]) {
+        continue;
+      }
+      const uint64_t coverage = TriangleEdgesBlockCoverage(edges, blockX, blockY);
+      uint64_t written = 0;
+      for (uint32_t row = 0; row < RASTERIZER_BLOCK_SIZE; ++row) {
+        const uint32_t covered = (uint32_t)(coverage >> (row * RASTERIZER_BLOCK_SIZE)) & 0xff;
+        if (!covered) {
+          continue;
+        }
+        FragmentRow fragments;
+        const uint32_t passed = TriangleEdgesDepthTestRow(edges, zbuffer, depthTest, blockX, blockY + row, covered, &fragments);
+        if (!passed) {
+          continue;
+        }
+        shade(context, blockX, blockY + row, passed, &fragments);
+        shaded += (uint64_t)POPCOUNT(passed);
+        written |= (uint64_t)passed << (row * RASTERIZER_BLOCK_SIZE);
+      }
+      if (written && zbuffer != NULL && depthTest == LessEqualDepthTest) {
+        ZBufferMergeTileWrites(zbuffer, tile, written, farthestKey);
+      }
+    }
+  }
+  return shaded;
+}
+
+bool RasterizerKernelSupported(RasterizerKernelType kernel);
+bool RasterizerSetKernel(RasterizerKernelType kernel);
+RasterizerKernelType RasterizerGetKernel();
+
+#ifdef RASTERIZER_SIMD
+// ISA specific kernels behind the functions above, do not call them directly
+uint64_t _BlockCoverageSSE41(const int32_t value[3], const int32_t stepX[3], const int32_t stepY[3]);
+uint64_t _BlockCoverageAVX2(const int32_t value[3], const int32_t stepX[3], const int32_t stepY[3]);
+#ifdef RENDER_REAL_FLOAT
+uint32_t _DepthTestRowSSE41(const TriangleEdges *edges, ZBuffer *zbuffer, DepthTestType depthTest, uint32_t blockX, uint32_t y, uint32_t mask, FragmentRow *fragments);
+uint32_t _DepthTestRowAVX2(const TriangleEdges *edges, ZBuffer *zbuffer, DepthTestType depthTest, uint32_t blockX, uint32_t y, uint32_t mask, FragmentRow *fragments);
+void _FragmentRowInterpolateSSE41(const FragmentRow *fragments, Vector a, Vector b, Vector c, Vector *values);
+void _FragmentRowInterpolateAVX2(const FragmentRow *fragments, Vector a, Vector b, Vector c, Vector *values);
+#endif
+#endif
 
 void DrawLine(Bitmap *bitmap, Vector v1, Vector v2, const RGBTRIPLE *color);
 void DrawTriangle(Bitmap *bitmap, Vector v1, Vector v2, Vector v3, const RGBTRIPLE *color, ZBuffer *zbuffer);
 
-ZBuffer *ZBufferCreate(uint16_t imageWidth, uint16_t imageHeight);
+ZBuffer *ZBufferCreate(uint16_t imageWidth, uint16_t imageHeight, DepthFormat format);
+bool ZBufferClear(ZBuffer *zbuffer);
+uint32_t ZBufferDepthSize(DepthFormat format);
 Real ZBufferGetDepth(const ZBuffer *zbuffer, uint16_t x, uint16_t y);
 bool ZBufferSetDepth(const ZBuffer *zbuffer, uint16_t x, uint16_t y, Real depth);
 bool ZBufferTestAndUpdate(ZBuffer *zbuffer, uint16_t x, uint16_t y, Real depth);
+void ZBufferUpdateHierarchy(const ZBuffer *zbuffer, uint32_t minX, uint32_t minY, uint32_t maxX, uint32_t maxY);
 bool ZBufferExportToImage(const ZBuffer *zbuffer, Bitmap *bitmap);
 bool ZBufferDestroy(ZBuffer *zbuffer);
 
@@ -0,0 +1,158 @@
+#include "rasterizer.h"
+
+/*
+ * SSE4.1 / AVX2 kernels of the rasterizer, one pixel per lane (SSE4.1 processes a block row as two halves).
+ * They are compiled with target attributes and only called by rasterizer.c after checking the CPU, so the rest of the build keeps its target.
+ */
+
+#ifdef RASTERIZER_SIMD
+#include <immintrin.h>
+
+__attribute__((target("sse4.1"))) uint64_t _BlockCoverageSSE41(const int32_t value[3], const int32_t stepX[3], const int32_t stepY[3]) {
+  const __m128i lanes = _mm_setr_epi32(0, 1, 2, 3), half = _mm_set1_epi32(4);
+  __m128i left[3], right[3], step[3];
+  for (int i = 0; i < 3; ++i) {
+    left[i] = _mm_add_epi32(_mm_set1_epi32(value[i]), _mm_mullo_epi32(lanes, _mm_set1_epi32(stepX[i])));
+    right[i] = _mm_add_epi32(left[i], _mm_mullo_epi32(half, _mm_set1_epi32(stepX[i])));
+    step[i] = _mm_set1_epi32(stepY[i]);
+  }
+  uint64_t coverage = 0;
+  for (uint32_t row = 0; row < RASTERIZER_BLOCK_SIZE; ++row) {
+    const int outsideLeft = _mm_movemask_ps(_mm_castsi128_ps(_mm_or_si128(left[0], _mm_or_si128(left[1], left[2]))));
+    const int outsideRight = _mm_movemask_ps(_mm_castsi128_ps(_mm_or_si128(right[0], _mm_or_si128(right[1], right[2]))));
+    coverage |= (uint64_t)(~(outsideLeft | outsideRight << 4) & 0xff) << (row * RASTERIZER_BLOCK_SIZE);
+    for (int i = 0; i < 3; ++i) {
+      left[i] = _mm_add_epi32(left[i], step[i]);
+      right[i] = _mm_add_epi32(right[i], step[i]);
+    }
+  }
+  return coverage;
+}
+
+__attribute__((target("avx2"))) uint64_t _BlockCoverageAVX2(const int32_t value[3], const int32_t stepX[3], const int32_t stepY[3]) {
+  const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+  __m256i edge[3], step[3];
+  for (int i = 0; i < 3; ++i) {
+    edge[i] = _mm256_add_epi32(_mm256_set1_epi32(value[i]), _mm256_mullo_epi32(lanes, _mm256_set1_epi32(stepX[i])));
+    step[i] = _mm256_set1_epi32(stepY[i]);
+  }
+  uint64_t coverage = 0;
+  for (uint32_t row = 0; row < RASTERIZER_BLOCK_SIZE; ++row) {
+    const int outside = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_or_si256(edge[0], _mm256_or_si256(edge[1], edge[2]))));
+    coverage |= (uint64_t)(~outside & 0xff) << (row * RASTERIZER_BLOCK_SIZE);
+    for (int i = 0; i < 3; ++i) {
+      edge[i] = _mm256_add_epi32(edge[i], step[i]);
+    }
+  }
+  return coverage;
+}
+
+#ifdef RENDER_REAL_FLOAT
+/**
+ * Edge value at pixel (blockX, y) truncated to 32 bits.
+ * Lanes are stepped from it with wrapping additions, which gives exact values on covered pixels of compact triangles.
+ */
+int32_t _RowEdgeValue(const TriangleEdges *edges, int i, uint32_t blockX, uint32_t y) {
+  return (int32_t)(uint32_t)(edges->edgeOrigin[i] + (int64_t)edges->edgeStepX[i] * blockX + (int64_t)edges->edgeStepY[i] * y);
+}
+
+__attribute__((target("sse4.1"))) uint32_t _DepthTestRowSSE41(const TriangleEdges *edges, ZBuffer *zbuffer, DepthTestType depthTest, uint32_t blockX, uint32_t y, uint32_t mask,
+                                                               FragmentRow *fragments) {
+  const __m128i lanes = _mm_setr_epi32(0, 1, 2, 3), bits = _mm_setr_epi32(1, 2, 4, 8);
+  const __m128 inverseArea = _mm_set1_ps(edges->inverseArea);
+  const __m128 z[3] = {_mm_set1_ps(edges->depths.x), _mm_set1_ps(edges->depths.y), _mm_set1_ps(edges->depths.z)};
+  const bool reversed = zbuffer != NULL && zbuffer->format == ReversedFloat32DepthFormat;
+  uint32_t passed = 0;
+  for (uint32_t half = 0; half < RASTERIZER_BLOCK_SIZE; half += 4) {
+    __m128 weight[3];
+    for (int i = 0; i < 3; ++i) {
+      const __m128i value = _mm_add_epi32(_mm_set1_epi32(_RowEdgeValue(edges, i, blockX + half, y)), _mm_mullo_epi32(lanes, _mm_set1_epi32(edges->edgeStepX[i])));
+      weight[i] = _mm_mul_ps(_mm_cvtepi32_ps(value), inverseArea);
+      _mm_storeu_ps(&fragments->weights[i][half], weight[i]);
+    }
+    const __m128 depth = _mm_add_ps(_mm_add_ps(_mm_mul_ps(weight[0], z[0]), _mm_mul_ps(weight[1], z[1])), _mm_mul_ps(weight[2], z[2]));
+    _mm_storeu_ps(&fragments->depths[half], depth);
+
+    const uint32_t selected = mask >> half & 0xf;
+    if (zbuffer == NULL) {
+      passed |= selected << half;
+      continue;
+    }
+    float *depths = &((float *)zbuffer->depths)[ZBufferPixelIndex(zbuffer, blockX + half, y)];
+    const __m128 current = _mm_loadu_ps(depths);
+    const __m128 stored = reversed ? _mm_sub_ps(_mm_set1_ps(1), depth) : depth;
+    if (depthTest == EqualDepthTest) {
+      passed |= ((uint32_t)_mm_movemask_ps(_mm_cmpeq_ps(current, stored)) & selected) << half;
+      continue;
+    }
+    // pass unless current is nearer, which is current < depth (or current > 1 - depth if reversed)
+    const uint32_t test = (uint32_t)_mm_movemask_ps(reversed ? _mm_cmpngt_ps(current, stored) : _mm_cmpnlt_ps(current, stored)) & selected;
+    const __m128 update = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(_mm_set1_epi32((int)test), bits), bits));
+    _mm_storeu_ps(depths, _mm_blendv_ps(current, stored, update));
+    passed |= test << half;
+  }
+  return passed;
+}
+
+__attribute__((target("avx2"))) uint32_t _DepthTestRowAVX2(const TriangleEdges *edges, ZBuffer *zbuffer, DepthTestType depthTest, uint32_t blockX, uint32_t y, uint32_t mask, FragmentRow *fragments) {
+  const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), bits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+  const __m256 inverseArea = _mm256_set1_ps(edges->inverseArea);
+  __m256 weight[3];
+  for (int i = 0; i < 3; ++i) {
+    const __m256i value = _mm256_add_epi32(_mm256_set1_epi32(_RowEdgeValue(edges, i, blockX, y)), _mm256_mullo_epi32(lanes, _mm256_set1_epi32(edges->edgeStepX[i])));
+    weight[i] = _mm256_mul_ps(_mm256_cvtepi32_ps(value), inverseArea);
+    _mm256_storeu_ps(fragments->weights[i], weight[i]);
+  }
+  const __m256 depth = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(weight[0], _mm256_set1_ps(edges->depths.x)), _mm256_mul_ps(weight[1], _mm256_set1_ps(edges->depths.y))),
+                                     _mm256_mul_ps(weight[2], _mm256_set1_ps(edges->depths.z)));
+  _mm256_storeu_ps(fragments->depths, depth);
+  if (zbuffer == NULL) {
+    return mask;
+  }
+
+  const bool reversed = zbuffer->format == ReversedFloat32DepthFormat;
+  float *depths = &((float *)zbuffer->depths)[ZBufferPixelIndex(zbuffer, blockX, y)];
+  const __m256 current = _mm256_loadu_ps(depths);
+  const __m256 stored = reversed ? _mm256_sub_ps(_mm256_set1_ps(1), depth) : depth;
+  if (depthTest == EqualDepthTest) {
+    return (uint32_t)_mm256_movemask_ps(_mm256_cmp_ps(current, stored, _CMP_EQ_OQ)) & mask;
+  }
+  // pass unless current is nearer, which is current < depth (or current > 1 - depth if reversed)
+  const uint32_t passed = (uint32_t)_mm256_movemask_ps(reversed ? _mm256_cmp_ps(current, stored, _CMP_NGT_UQ) : _mm256_cmp_ps(current, stored, _CMP_NLT_UQ)) & mask;
+  const __m256 update = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32((int)passed), bits), bits));
+  _mm256_storeu_ps(depths, _mm256_blendv_ps(current, stored, update));
+  return passed;
+}
+
+__attribute__((target("sse4.1"))) void _FragmentRowInterpolateSSE41(const FragmentRow *fragments, const Vector a, const Vector b, const Vector c, Vector *values) {
+  const float components[3][3] = {{a.x, b.x, c.x}, {a.y, b.y, c.y}, {a.z, b.z, c.z}};
+  float interpolated[3][RASTERIZER_BLOCK_SIZE];
+  for (uint32_t half = 0; half < RASTERIZER_BLOCK_SIZE; half += 4) {
+    const __m128 w0 = _mm_loadu_ps(&fragments->weights[0][half]), w1 = _mm_loadu_ps(&fragments->weights[1][half]), w2 = _mm_loadu_ps(&fragments->weights[2][half]);
+    for (int i = 0; i < 3; ++i) {
+      const __m128 value =
+          _mm_add_ps(_mm_mul_ps(_mm_set1_ps(components[i][0]), w0), _mm_add_ps(_mm_mul_ps(_mm_set1_ps(components[i][1]), w1), _mm_mul_ps(_mm_set1_ps(components[i][2]), w2)));
+      _mm_storeu_ps(&interpolated[i][half], value);
+    }
+  }
+  for (uint32_t lane = 0; lane < RASTERIZER_BLOCK_SIZE; ++lane) {
+    values[lane] = V(interpolated[0][lane], interpolated[1][lane], interpolated[2][lane]);
+  }
+}
+
+__attribute__((target("avx2"))) void _FragmentRowInterpolateAVX2(const FragmentRow *fragments, const Vector a, const Vector b, const Vector c, Vector *values) {
+  const float components[3][3] = {{a.x, b.x, c.x}, {a.y, b.y, c.y}, {a.z, b.z, c.z}};
+  const __m256 w0 = _mm256_loadu_ps(fragments->weights[0]), w1 = _mm256_loadu_ps(fragments->weights[1]), w2 = _mm256_loadu_ps(fragments->weights[2]);
+  float interpolated[3][RASTERIZER_BLOCK_SIZE];
+  for (int i = 0; i < 3; ++i) {
+    const __m256 value = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(components[i][0]), w0),
+                                       _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(components[i][1]), w1), _mm256_mul_ps(_mm256_set1_ps(components[i][2]), w2)));
+    _mm256_storeu_ps(interpolated[i], value);
+  }
+  for (uint32_t lane = 0; lane < RASTERIZER_BLOCK_SIZE; ++lane) {
+    values[lane] = V(interpolated[0][lane], interpolated[1][lane], interpolated[2][lane]);
+  }
+}
+#endif // RENDER_REAL_FLOAT
+
+#endif // RASTERIZER_SIMD
@@ -0,0 +1,575 @@
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rasterizer.h"
+#include "world.h"
+
+#define WIDTH 61
+#define HEIGHT 43
+
+uint8_t counts[HEIGHT][WIDTH];
+
+void CountRow(const void *context, uint32_t blockX, uint32_t y, uint32_t passed, const FragmentRow *fragments) {
+  UNUSED(context);
+  UNUSED(fragments);
+  for (uint32_t lane = 0; lane < RASTERIZER_BLOCK_SIZE; ++lane) {
+    counts[y][blockX + lane] += passed >> lane & 1;
+  }
+}
+
+void Rasterize(const Vector v1, const Vector v2, const Vector v3) {
+  TriangleEdges edges;
+  if (!TriangleEdgesSetup(&edges, v1, v2, v3, WIDTH, HEIGHT)) {
+    return;
+  }
+  for (uint32_t blockY = edges.minY - edges.minY % RASTERIZER_BLOCK_SIZE; blockY <= edges.maxY; blockY += RASTERIZER_BLOCK_SIZE) {
+    for (uint32_t blockX = edges.minX - edges.minX % RASTERIZER_BLOCK_SIZE; blockX <= edges.maxX; blockX += RASTERIZER_BLOCK_SIZE) {
+      uint64_t coverage = TriangleEdgesBlockCoverage(&edges, blockX, blockY);
+      for (uint32_t i = 0; coverage != 0; ++i, coverage >>= 1) {
+        if (coverage & 1) {
+          const uint32_t x = blockX + i % RASTERIZER_BLOCK_SIZE, y = blockY + i / RASTERIZER_BLOCK_SIZE;
+          const Vector weight = TriangleEdgesWeight(&edges, x, y);
+          assert(weight.x >= 0 && weight.y >= 0 && weight.z >= 0);
+          ++counts[y][x];
+        }
+      }
+    }
+  }
+}
+
+/**
+ * Square of n x n cells of side size / n in the xy plane, centered at the origin and facing +z
+ */
+Polygon *CreateGrid(uint32_t n, float size) {
+  STLTriangle *triangles = calloc(2 * n * n, sizeof(STLTriangle));
+  for (uint32_t y = 0; y < n; ++y) {
+    for (uint32_t x = 0; x < n; ++x) {
+      const float x0 = size * ((float)x / n - 0.5f), x1 = size * ((float)(x + 1) / n - 0.5f), y0 = size * ((float)y / n - 0.5f), y1 = size * ((float)(y + 1) / n - 0.5f);
+      const STLTriangle faces[2] = {{{0, 0, 1}, {{x0, y0, 0}, {x1, y0, 0}, {x0, y1, 0}}, 0}, {{0, 0, 1}, {{x1, y0, 0}, {x1, y1, 0}, {x0, y1, 0}}, 0}};
+      memcpy(&triangles[(y * n + x) * 2], faces, sizeof(faces));
+    }
+  }
+  Polygon *polygon = PolygonCreateFromSTL(triangles, 2 * n * n);
+  free(triangles);
+  PolygonCalculateVertexNormals(polygon);
+  PolygonCalculateBoundingSphere(polygon);
+  return polygon;
+}
+
+int main() {
+  const RasterizerKernelType selected = RasterizerGetKernel();
+  for (RasterizerKernelType kernel = ScalarRasterizerKernel; kernel <= AVX2RasterizerKernel; ++kernel) { // jittered grid over the image, alternating winding: each kernel draws every pixel once
+    if (!RasterizerKernelSupported(kernel)) {
+      continue;
+    }
+    RasterizerSetKernel(kernel);
+    Vector grid[9][9];
+    for (int j = 0; j < 9; ++j) {
+      for (int i = 0; i < 9; ++i) {
+        grid[j][i] = V(-5 + i * 9 + (i % 3) * (Real)0.37, -5 + j * 7 - (j % 2) * (Real)0.61, 0);
+      }
+    }
+    memset(counts, 0, sizeof(counts));
+    for (int j = 0; j < 8; ++j) {
+      for (int i = 0; i < 8; ++i) {
+        if ((i + j) % 2) {
+          Rasterize(grid[j][i], grid[j][i + 1], grid[j + 1][i + 1]);
+          Rasterize(grid[j + 1][i + 1], grid[j + 1][i], grid[j][i]);
+        } else {
+          Rasterize(grid[j][i], grid[j + 1][i], grid[j][i + 1]);
+          Rasterize(grid[j][i + 1], grid[j + 1][i], grid[j + 1][i + 1]);
+        }
+      }
+    }
+    for (int y = 0; y < HEIGHT; ++y) {
+      for (int x = 0; x < WIDTH; ++x) {
+        assert(counts[y][x] == 1);
+      }
+    }
+  }
+  for (RasterizerKernelType kernel = ScalarRasterizerKernel; kernel <= AVX2RasterizerKernel; ++kernel) { // a fan whose edges pass exactly through pixel centers, drawn the same by every kernel
+    if (!RasterizerKernelSupported(kernel)) {
+      continue;
+    }
+    RasterizerSetKernel(kernel);
+    const Vector center = V(20.5, 20.5, 0);
+    const Vector rim[8] = {V(0.5, 0.5, 0), V(20.5, 0.5, 0), V(40.5, 0.5, 0), V(40.5, 20.5, 0), V(40.5, 40.5, 0), V(20.5, 40.5, 0), V(0.5, 40.5, 0), V(0.5, 20.5, 0)};
+    memset(counts, 0, sizeof(counts));
+    for (int i = 0; i < 8; ++i) {
+      Rasterize(center, rim[i], rim[(i + 1) % 8]);
+    }
+    for (int y = 0; y < HEIGHT; ++y) {
+      for (int x = 0; x < WIDTH; ++x) {
+        assert(counts[y][x] == (x < 40 && y < 40 ? 1 : 0)); // top-left rule owns the left and top borders only
+      }
+    }
+  }
+  RasterizerSetKernel(selected);
+  { // degenerate and out of range triangles are rejected
+    TriangleEdges edges;
+    assert(!TriangleEdgesSetup(&edges, V(1, 1, 0), V(5, 5, 0), V(9, 9, 0), WIDTH, HEIGHT));
+    assert(!TriangleEdgesSetup(&edges, V(1, 1, 0), V(5, 1, 0), V(RASTERIZER_MAX_COORDINATE, 9, 0), WIDTH, HEIGHT));
+    assert(!TriangleEdgesSetup(&edges, V(-9, -9, 0), V(-1, -9, 0), V(-1, -1, 0), WIDTH, HEIGHT));
+    assert(TriangleEdgesSetup(&edges, V(1, 1, 0), V(5, 1, 0), V(1, 5, 0), WIDTH, HEIGHT));
+  }
+  for (DepthFormat format = RealDepthFormat; format <= ReversedFloat32DepthFormat; ++format) { // z-buffer formats keep the order of depths and round trip untouched pixels
+    ZBuffer *zbuffer = ZBufferCreate(2, 1, format);
+    assert(ZBufferGetDepth(zbuffer, 0, 0) == REAL_MAX);
+    const bool updated = ZBufferTestAndUpdate(zbuffer, 0, 0, 0.5) && ZBufferTestAndUpdate(zbuffer, 0, 0, 0.25) && !ZBufferTestAndUpdate(zbuffer, 0, 0, 0.75);
+    assert(updated);
+    UNUSED(updated);
+    assert(FABS(ZBufferGetDepth(zbuffer, 0, 0) - (Real)0.25) < 1e-4 && ZBufferGetDepth(zbuffer, 1, 0) == REAL_MAX);
+    const bool cleared = ZBufferClear(zbuffer) && ZBufferTestAndUpdate(zbuffer, 1, 0, 0.75);
+    assert(cleared && ZBufferGetDepth(zbuffer, 0, 0) == REAL_MAX);
+    UNUSED(cleared);
+    ZBufferDestroy(zbuffer);
+  }
+  assert(ZBufferCreate(1, 1, (DepthFormat)-1) == NULL);
+  for (DepthFormat format = RealDepthFormat; format <= ReversedFloat32DepthFormat; ++format) { // depth prepass: the equal test passes exactly the fragments left by the depth-only pass
+    uint8_t expectedCounts[HEIGHT][WIDTH];
+    Real expectedDepths[HEIGHT][WIDTH];
+    uint64_t expectedFragments = 0;
+    for (RasterizerKernelType kernel = ScalarRasterizerKernel; kernel <= AVX2RasterizerKernel; ++kernel) { // every kernel covers the same pixels as the scalar one, depths differ by rounding only
+      if (!RasterizerKernelSupported(kernel)) {
+        continue;
+      }
+      RasterizerSetKernel(kernel);
+      ZBuffer *zbuffer = ZBufferCreate(WIDTH, HEIGHT, format);
+      TriangleEdges front, back;
+      const bool visible =
+          TriangleEdgesSetup(&front, V(3, 3, 0.1), V(40, 5, 0.2), V(10, 38, 0.3), WIDTH, HEIGHT) && TriangleEdgesSetup(&back, V(0, 0, 0.25), V(60, 0, 0.25), V(30, 42, 0.25), WIDTH, HEIGHT);
+      assert(visible);
+      UNUSED(visible);
+      memset(counts, 0, sizeof(counts));
+      const uint64_t fragments = TriangleEdgesTraverse(&back, zbuffer, LessEqualDepthTest, CountRow, NULL) + TriangleEdgesTraverse(&front, zbuffer, LessEqualDepthTest, CountRow, NULL);
+      memset(counts, 0, sizeof(counts));
+      const uint64_t shaded = TriangleEdgesTraverse(&back, zbuffer, EqualDepthTest, CountRow, NULL) + TriangleEdgesTraverse(&front, zbuffer, EqualDepthTest, CountRow, NULL);
+      uint64_t covered = 0;
+      for (int y = 0; y < HEIGHT; ++y) {
+        for (int x = 0; x < WIDTH; ++x) {
+          assert(counts[y][x] == (ZBufferGetDepth(zbuffer, x, y) != REAL_MAX ? 1 : 0));
+          covered += counts[y][x];
+        }
+      }
+      assert(shaded == covered && shaded < fragments);
+      if (kernel == ScalarRasterizerKernel) {
+        memcpy(expectedCounts, counts, sizeof(counts));
+        for (int y = 0; y < HEIGHT; ++y) {
+          for (int x = 0; x < WIDTH; ++x) {
+            expectedDepths[y][x] = ZBufferGetDepth(zbuffer, x, y);
+          }
+        }
+        expectedFragments = fragments;
+      }
+      assert(fragments == expectedFragments && memcmp(counts, expectedCounts, sizeof(counts)) == 0);
+      for (int y = 0; y < HEIGHT; ++y) {
+        for (int x = 0; x < WIDTH; ++x) {
+          const Real depth = ZBufferGetDepth(zbuffer, x, y);
+          assert(depth == expectedDepths[y][x] || FABS(depth - expectedDepths[y][x]) <= (Real)6e-8);
+          UNUSED(depth);
+        }
+      }
+      ZBufferDestroy(zbuffer);
+    }
+    UNUSED(expectedDepths);
+    UNUSED(expectedFragments);
+  }
+  RasterizerSetKernel(selected);
+  { // hierarchical z: once updated, a triangle covering the image hides anything behind it, a deeper pixel set afterwards is visible again
+    ZBuffer *zbuffer = ZBufferCreate(WIDTH, HEIGHT, Float32DepthFormat);
+    assert(!ZBufferBoxOccluded(zbuffer, 0, 0, WIDTH - 1, HEIGHT - 1, 0.9));
+    TriangleEdges front, back;
+    const bool visible =
+        TriangleEdgesSetup(&front, V(-100, -100, 0.2), V(300, -100, 0.2), V(-100, 300, 0.2), WIDTH, HEIGHT) && TriangleEdgesSetup(&back, V(5, 5, 0.5), V(50, 5, 0.5), V(5, 40, 0.5), WIDTH, HEIGHT);
+    assert(visible);
+    UNUSED(visible);
+    const uint64_t frontShaded = TriangleEdgesTraverse(&front, zbuffer, LessEqualDepthTest, CountRow, NULL);
+    assert(frontShaded == WIDTH * HEIGHT && !ZBufferBoxOccluded(zbuffer, 0, 0, WIDTH - 1, HEIGHT - 1, 0.5));
+    UNUSED(frontShaded);
+    ZBufferUpdateHierarchy(zbuffer, 0, 0, WIDTH - 1, HEIGHT - 1);
+    assert(ZBufferBoxOccluded(zbuffer, 0, 0, WIDTH - 1, HEIGHT - 1, 0.5) && ZBufferBoxOccluded(zbuffer, 10, 10, 20, 20, 0.21) && !ZBufferBoxOccluded(zbuffer, 10, 10, 20, 20, 0.2));
+    const uint64_t backShaded = TriangleEdgesTraverse(&back, zbuffer, LessEqualDepthTest, CountRow, NULL);
+    assert(backShaded == 0);
+    UNUSED(backShaded);
+    ZBufferSetDepth(zbuffer, 30, 20, 0.8);
+    assert(!ZBufferBoxOccluded(zbuffer, 28, 18, 33, 22, 0.5) && ZBufferBoxOccluded(zbuffer, 0, 0, 7, 7, 0.5) && ZBufferBoxOccluded(zbuffer, WIDTH, 0, WIDTH + 10, 5, 0.5));
+    ZBufferClear(zbuffer);
+    assert(!ZBufferBoxOccluded(zbuffer, 0, 0, WIDTH - 1, HEIGHT - 1, 0.9) && ZBufferGetDepth(zbuffer, 30, 20) == REAL_MAX);
+    const uint64_t clearedShaded = TriangleEdgesTraverse(&back, zbuffer, LessEqualDepthTest, CountRow, NULL);
+    assert(clearedShaded > 0);
+    UNUSED(clearedShaded);
+    ZBufferDestroy(zbuffer);
+  }
+  { // a cleared bitmap is filled with the color, tiles are resolved into padded bottom-up rows when written
+    Bitmap *bitmap = BitmapNewImage(WIDTH, HEIGHT);
+    BitmapSetPixelColor(bitmap, 3, 4, BMP_COLOR(1, 2, 3));
+    BitmapClear(bitmap, BMP_COLOR(10, 20, 30));
+    for (int y = 0; y < HEIGHT; ++y) {
+      for (int x = 0; x < WIDTH; ++x) {
+        RGBTRIPLE pixel;
+        const bool inside = BitmapGetPixelColor(bitmap, x, y, &pixel);
+        assert(inside && pixel.rgbtRed == 10 && pixel.rgbtGreen == 20 && pixel.rgbtBlue == 30);
+        UNUSED(inside);
+      }
+    }
+    BitmapClear(bitmap, NULL);
+    for (int y = 0; y < HEIGHT; ++y) {
+      for (int x = 0; x < WIDTH; ++x) {
+        BitmapSetPixelColor(bitmap, x, y, BMP_COLOR(x, y, x ^ y));
+      }
+    }
+    const char *filename = "rasterizer_test.bmp";
+    BitmapWriteFile(bitmap, filename);
+    FILE *fp = fopen(filename, "rb");
+    const uint32_t rowSize = (sizeof(RGBTRIPLE) * WIDTH + 3) / 4 * 4;
+    const size_t fileSize = sizeof(BITMAPFILEHEADER) + sizeof(BITMAPCOREHEADER) + rowSize * HEIGHT;
+    uint8_t *file = (uint8_t *)malloc(fileSize);
+    const bool complete = fread(file, 1, fileSize, fp) == fileSize && fgetc(fp) == EOF;
+    assert(complete);
+    UNUSED(complete);
+    fclose(fp);
+    remove(filename);
+    for (int y = 0; y < HEIGHT; ++y) {
+      const uint8_t *row = &file[sizeof(BITMAPFILEHEADER) + sizeof(BITMAPCOREHEADER) + rowSize * (HEIGHT - y - 1)];
+      for (int x = 0; x < WIDTH; ++x) {
+        assert(row[3 * x] == (x ^ y) && row[3 * x + 1] == y && row[3 * x + 2] == x);
+      }
+    }
+    free(file);
+    BitmapDestroy(bitmap);
+  }
+  { // a floor extending behind the camera is clipped against the near plane and the guard band: watertight below the horizon, nothing above
+    Camera *camera = CameraPerspectiveProjection(V0, V(0, 0, 1), V(0, 1, 0), WIDTH, HEIGHT, 0.1, 1000, 90); // center of projection at the origin, looking down -z
+    const Vector floor[4] = {V(-1e4, -1, 1e2), V(1e4, -1, 1e2), V(1e4, -1, -1e4), V(-1e4, -1, -1e4)};
+    const Triangle triangles[2] = {{V0, {floor[0], floor[1], floor[2]}, {V0, V0, V0}}, {V0, {floor[2], floor[3], floor[0]}, {V0, V0, V0}}};
+    memset(counts, 0, sizeof(counts));
+    for (int i = 0; i < 2; ++i) {
+      Triangle pieces[RASTERIZER_CLIP_TRIANGLES];
+      const uint32_t pieceCount = RasterizerClipTriangle(camera, triangles[i], pieces);
+      assert(pieceCount > 1);
+      for (uint32_t j = 0; j < pieceCount; ++j) {
+        const Triangle piece = rasterize(camera, pieces[j]);
+        for (int k = 0; k < 3; ++k) {
+          assert(-Mat4TransformPoint(&camera->world2ndc, pieces[j].vertexes[k]).w > camera->near / 2); // in front of the camera, up to rounding
+        }
+        Rasterize(piece.vertexes[0], piece.vertexes[1], piece.vertexes[2]);
+      }
+    }
+    for (int y = 0; y < HEIGHT; ++y) {
+      for (int x = 0; x < WIDTH; ++x) {
+        assert(counts[y][x] == (y < HEIGHT / 2 ? 1 : 0));
+      }
+    }
+
+    Triangle pieces[RASTERIZER_CLIP_TRIANGLES];
+    const Triangle behind = {V0, {V(-1, -1, 1), V(1, -1, 1), V(0, 1, 1)}, {V0, V0, V0}};
+    const Triangle inside = {V0, {V(-1, -1, -5), V(1, -1, -5), V(0, 1, -5)}, {V0, V0, V0}};
+    assert(RasterizerClipTriangle(camera, behind, pieces) == 0);
+    assert(RasterizerClipTriangle(camera, inside, pieces) == 1 && memcmp(&pieces[0], &inside, sizeof(Triangle)) == 0);
+    CameraDestroy(camera);
+  }
+  { // the tiled backend draws the same image as the serial one, with and without depth prepass, on an image of several partial tiles
+    const uint16_t width = 3 * RENDER_TILE_SIZE - 37, height = 2 * RENDER_TILE_SIZE - 21;
+    Camera *camera = CameraPerspectiveProjection(V0, V(0, 0, 1), V(0, 1, 0), width, height, 0.1, 1000, 70);
+    Polygon *wallPolygon = CreateGrid(16, 6), *floorPolygon = CreateGrid(64, 400);
+    const Material wallMaterial = (Material){V(0.8, 0.2, 0.1), 1, 1, 1, 30, false}, floorMaterial = (Material){V(0.2, 0.4, 0.8), 1, 1, 1, 30, true};
+    // a tilted wall in front of a floor which crosses the near plane, so that triangles span tiles and are clipped
+    Thing *wall = ThingCreate(wallPolygon, TransformerCreate(V(0.5, 0.3, -6), V(0.3, 0.5, 0.1), V(1, 1, 1)), &wallMaterial);
+    Thing *floor = ThingCreate(floorPolygon, TransformerCreate(V(0, -1, 0), V(RADIAN(90), 0, 0), V(1, 1, 1)), &floorMaterial);
+    Light light = LightCreatePointLight(V(1, 1, 1), V(1, 1, 1), V(1, 2, 3));
+    Scene *scene = SceneCreateEmpty();
+    SceneSetCamera(scene, camera);
+    SceneAppendLight(scene, &light);
+    SceneAppendThing(scene, wall);
+    SceneAppendThing(scene, floor);
+
+    Bitmap *bitmaps[4];
+    ZBuffer *zbuffers[4];
+    for (int i = 0; i < 4; ++i) {
+      bitmaps[i] = BitmapNewImage(width, height);
+      zbuffers[i] = ZBufferCreate(width, height, Float32DepthFormat);
+    }
+    for (ShadingType shading = NullShading; shading <= PhongShading; ++shading) {
+      for (int i = 0; i < 4; ++i) { // serial, tiled, serial with prepass, tiled with prepass
+        BitmapClear(bitmaps[i], NULL);
+        ZBufferClear(zbuffers[i]);
+        SceneSetRenderBackend(scene, i % 2 ? TiledRenderBackend : SerialRenderBackend);
+        SceneSetDepthPrepass(scene, i >= 2);
+        SceneRender(scene, bitmaps[i], zbuffers[i], WorldRender, shading, BlinnPhongReflectionModel);
+      }
+      uint64_t covered = 0;
+      for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+          RGBTRIPLE expected, pixel;
+          BitmapGetPixelColor(bitmaps[0], x, y, &expected);
+          covered += ZBufferGetDepth(zbuffers[0], x, y) != REAL_MAX;
+          for (int i = 1; i < 4; ++i) {
+            BitmapGetPixelColor(bitmaps[i], x, y, &pixel);
+            assert(memcmp(&pixel, &expected, sizeof(RGBTRIPLE)) == 0 && ZBufferGetDepth(zbuffers[i], x, y) == ZBufferGetDepth(zbuffers[0], x, y));
+          }
+        }
+      }
+      assert(covered > (uint64_t)width * height / 2 && covered < (uint64_t)width * height);
+      UNUSED(covered);
+      for (RasterizerKernelType kernel = ScalarRasterizerKernel; kernel <= AVX2RasterizerKernel; ++kernel) { // every kernel shades the same colors, depths differ by rounding only
+        if (kernel == selected || !RasterizerKernelSupported(kernel)) {
+          continue;
+        }
+        RasterizerSetKernel(kernel);
+        BitmapClear(bitmaps[1], NULL);
+        ZBufferClear(zbuffers[1]);
+        SceneSetRenderBackend(scene, SerialRenderBackend);
+        SceneSetDepthPrepass(scene, false);
+        SceneRender(scene, bitmaps[1], zbuffers[1], WorldRender, shading, BlinnPhongReflectionModel);
+        for (int y = 0; y < height; ++y) {
+          for (int x = 0; x < width; ++x) {
+            RGBTRIPLE expected, pixel;
+            BitmapGetPixelColor(bitmaps[0], x, y, &expected);
+            BitmapGetPixelColor(bitmaps[1], x, y, &pixel);
+            const Real depth = ZBufferGetDepth(zbuffers[1], x, y), expectedDepth = ZBufferGetDepth(zbuffers[0], x, y);
+            assert(memcmp(&pixel, &expected, sizeof(RGBTRIPLE)) == 0 && (depth == expectedDepth || FABS(depth - expectedDepth) <= (Real)6e-8));
+            UNUSED(depth);
+            UNUSED(expectedDepth);
+          }
+        }
+      }
+      RasterizerSetKernel(selected);
+    }
+
+    for (int i = 0; i < 4; ++i) {
+      BitmapDestroy(bitmaps[i]);
+      ZBufferDestroy(zbuffers[i]);
+    }
+    TransformerDestroy(wall->transformer);
+    TransformerDestroy(floor->transformer);
+    ThingDestroy(wall);
+    ThingDestroy(floor);
+    SceneDestroy(scene);
+    CameraDestroy(camera);
+    PolygonDestroy(wallPolygon);
+    PolygonDestroy(floorPolygon);
+  }
+  { // culling through the BVHs draws the same image, picking finds what is drawn at the pixel
+    Camera *camera = CameraPerspectiveProjection(V0, V(0, 0, 1), V(0, 1, 0), WIDTH, HEIGHT, 0.1, 1000, 90);
+    Polygon *wallPolygon = CreateGrid(16, 6), *floorPolygon = CreateGrid(64, 40);
+    const Material wallMaterial = (Material){V(0.8, 0.2, 0.1), 1, 1, 1, 30, true}, floorMaterial = (Material){V(0.2, 0.4, 0.8), 1, 1, 1, 30, true};
+    Thing *wall = ThingCreate(wallPolygon, TransformerCreate(V(0, 0, -5), V0, V(1, 1, 1)), &wallMaterial);
+    Thing *back = ThingCreate(floorPolygon, TransformerCreate(V(0, 0, -10), V0, V(1, 1, 1)), &floorMaterial);
+    Thing *away = ThingCreate(wallPolygon, TransformerCreate(V(1000, 0, -5), V0, V(1, 1, 1)), &wallMaterial);
+    Light light = LightCreatePointLight(V(1, 1, 1), V(1, 1, 1), V(1, 2, 3));
+    Scene *scene = SceneCreateEmpty();
+    SceneSetCamera(scene, camera);
+    SceneAppendLight(scene, &light);
+    SceneAppendThing(scene, wall);
+    SceneAppendThing(scene, back);
+    SceneAppendThing(scene, away);
+
+    Bitmap *bitmaps[2] = {BitmapNewImage(WIDTH, HEIGHT), BitmapNewImage(WIDTH, HEIGHT)};
+    ZBuffer *zbuffers[2] = {ZBufferCreate(WIDTH, HEIGHT, RealDepthFormat), ZBufferCreate(WIDTH, HEIGHT, RealDepthFormat)};
+    RenderStatistics statistics[2];
+    for (int pass = 0; pass < 2; ++pass) {
+      if (pass == 1) {
+        const bool built = PolygonBuildBVH(wallPolygon) && PolygonBuildBVH(floorPolygon) && SceneBuildBVH(scene);
+        assert(built);
+        UNUSED(built);
+      }
+      SceneSetStatistics(scene, &statistics[pass]);
+      SceneRender(scene, bitmaps[pass], zbuffers[pass], WorldRender, FlatShading, PhongReflectionModel);
+    }
+    assert(statistics[0].thingsCulled == 1 && statistics[1].thingsCulled == 1 && statistics[0].trianglesOccluded == 0);
+    assert(statistics[1].trianglesFrustumCulled > statistics[0].trianglesFrustumCulled && statistics[1].trianglesOccluded > 0);
+    for (int y = 0; y < HEIGHT; ++y) {
+      for (int x = 0; x < WIDTH; ++x) {
+        RGBTRIPLE pixels[2];
+        BitmapGetPixelColor(bitmaps[0], x, y, &pixels[0]);
+        BitmapGetPixelColor(bitmaps[1], x, y, &pixels[1]);
+        assert(memcmp(&pixels[0], &pixels[1], sizeof(RGBTRIPLE)) == 0 && ZBufferGetDepth(zbuffers[0], x, y) == ZBufferGetDepth(zbuffers[1], x, y));
+
+        // the floor is behind every pixel, the wall in front of some
+        SceneHit hit;
+        const bool found = ScenePick(scene, x, y, &hit);
+        assert(found && hit.thingIndex <= 1 && FABS(hit.position.z - (hit.thingIndex == 0 ? -5 : -10)) < 1e-4);
+        const Vector image = NDCPos2ImagePos(camera, WorldPos2NDCPos(camera, hit.position));
+        assert(FABS(image.x - (Real)(x + 0.5)) < 1e-3 && FABS(image.y - (Real)(y + 0.5)) < 1e-3 && FABS(image.z - ZBufferGetDepth(zbuffers[1], x, y)) < 1e-5);
+        UNUSED(found);
+      }
+    }
+    SceneHit hit;
+    const bool behind = SceneRaycast(scene, V0, V(0, 0, 1), &hit), missed = SceneRaycast(scene, V(0, 0, -7), V(1, 0, 0), &hit);
+    const bool picked = SceneRaycast(scene, V(1000, 1, 0), V(0, 0, -1), &hit);
+    assert(!behind && !missed && picked && hit.thingIndex == 2 && FABS(hit.distance - 5) < 1e-4);
+    UNUSED(behind);
+    UNUSED(missed);
+    UNUSED(picked);
+
+    // a thing moved in front of the wall after SceneBuildBVH is drawn and picked, not culled by its stale box
+    away->transformer->location = V(0, 0, -4);
+    TransformerUpdateTransformationMatrix(away->transformer);
+    SceneRender(scene, bitmaps[1], zbuffers[1], WorldRender, FlatShading, PhongReflectionModel);
+    const bool moved = ScenePick(scene, WIDTH / 2, HEIGHT / 2, &hit) && hit.thingIndex == 2 && FABS(hit.position.z + 4) < 1e-4;
+    const bool left = !SceneRaycast(scene, V(1000, 1, 0), V(0, 0, -1), &hit);
+    assert(moved && left && statistics[1].thingsCulled == 0);
+    assert(FABS(NDCPos2ImagePos(camera, WorldPos2NDCPos(camera, V(0, 0, -4))).z - ZBufferGetDepth(zbuffers[1], WIDTH / 2, HEIGHT / 2)) < 1e-5);
+    UNUSED(moved);
+    UNUSED(left);
+
+    for (int i = 0; i < 2; ++i) {
+      BitmapDestroy(bitmaps[i]);
+      ZBufferDestroy(zbuffers[i]);
+    }
+    Thing *things[3] = {wall, back, away};
+    for (int i = 0; i < 3; ++i) {
+      TransformerDestroy(things[i]->transformer);
+      ThingDestroy(things[i]);
+    }
+    SceneDestroy(scene);
+    CameraDestroy(camera);
+    PolygonDestroy(wallPolygon);
+    PolygonDestroy(floorPolygon);
+  }
+  { // instances of a polygon render like one polygon holding their triangles, those out of view cost nothing
+    Camera *camera = CameraPerspectiveProjection(V0, V(0, 0, 1), V(0, 1, 0), WIDTH, HEIGHT, 0.1, 1000, 90);
+    Polygon *part = CreateGrid(8, 1);
+    const Material material = (Material){V(0.3, 0.6, 0.2), 1, 1, 1, 30, false};
+    Light light = LightCreatePointLight(V(1, 1, 1), V(1, 1, 1), V(1, 2, 3));
+    Scene *scenes[2] = {SceneCreateEmpty(), SceneCreateEmpty()};
+    enum { columns = 7, rows = 5, hiddenInstances = 100, instanceCount = columns * rows + hiddenInstances };
+    Transformer *transformers[instanceCount];
+    Thing *instances[instanceCount];
+    STLTriangle *merged = calloc(columns * rows * part->triangle, sizeof(STLTriangle));
+    uint64_t mergedCount = 0;
+    for (int scene = 0; scene < 2; ++scene) {
+      SceneSetCamera(scenes[scene], camera);
+      SceneAppendLight(scenes[scene], &light);
+    }
+    for (int i = 0; i < instanceCount; ++i) {
+      const bool inView = i < columns * rows;
+      const Vector location = inView ? V((i % columns) * 1.5 - 4.5, (i / columns) * 1.5 - 3, -6) : V(1000 + i, 0, -6);
+      const Vector scale = V(i == 3 ? -1 : 1, 1, 1); // one mirrored instance, its faces turn away from the camera
+      transformers[i] = TransformerCreate(location, V0, scale);
+      instances[i] = ThingCreate(part, transformers[i], &material);
+      SceneAppendThing(scenes[0], instances[i]);
+      for (uint64_t t = 0; inView && t < part->triangle; ++t, ++mergedCount) {
+        const Triangle triangle = PolygonGetTriangle(part, t);
+        merged[mergedCount].surfaceNormal[2] = 1;
+        for (int k = 0; k < 3; ++k) {
+          const Vector v = triangle.vertexes[k];
+          const float vertex[3] = {(float)(v.x * scale.x + location.x), (float)(v.y + location.y), (float)(v.z + location.z)};
+          memcpy(merged[mergedCount].vertexes[k], vertex, sizeof(vertex));
+        }
+      }
+    }
+    Polygon *mergedPolygon = PolygonCreateFromSTL(merged, mergedCount);
+    PolygonCalculateVertexNormals(mergedPolygon);
+    PolygonCalculateBoundingSphere(mergedPolygon);
+    free(merged);
+    Transformer *identity = TransformerCreate(V0, V0, V(1, 1, 1));
+    Thing *mergedThing = ThingCreate(mergedPolygon, identity, &material);
+    SceneAppendThing(scenes[1], mergedThing);
+
+    Bitmap *bitmaps[2] = {BitmapNewImage(WIDTH, HEIGHT), BitmapNewImage(WIDTH, HEIGHT)};
+    ZBuffer *zbuffers[2] = {ZBufferCreate(WIDTH, HEIGHT, RealDepthFormat), ZBufferCreate(WIDTH, HEIGHT, RealDepthFormat)};
+    RenderStatistics statistics[2];
+    for (int scene = 0; scene < 2; ++scene) {
+      SceneSetStatistics(scenes[scene], &statistics[scene]);
+      SceneRender(scenes[scene], bitmaps[scene], zbuffers[scene], WorldRender, PhongShading, BlinnPhongReflectionModel);
+    }
+    assert(statistics[0].thingsCulled == hiddenInstances && statistics[0].trianglesFrustumCulled == hiddenInstances * part->triangle);
+    assert(statistics[0].trianglesRasterized == statistics[1].trianglesRasterized && statistics[0].trianglesRasterized > 0);
+    assert(statistics[0].vertexesShaded == statistics[1].vertexesShaded && statistics[0].fragmentsShaded == statistics[1].fragmentsShaded);
+    for (int y = 0; y < HEIGHT; ++y) {
+      for (int x = 0; x < WIDTH; ++x) {
+        RGBTRIPLE pixels[2];
+        BitmapGetPixelColor(bitmaps[0], x, y, &pixels[0]);
+        BitmapGetPixelColor(bitmaps[1], x, y, &pixels[1]);
+        assert(memcmp(&pixels[0], &pixels[1], sizeof(RGBTRIPLE)) == 0 && ZBufferGetDepth(zbuffers[0], x, y) == ZBufferGetDepth(zbuffers[1], x, y));
+      }
+    }
+
+    for (int i = 0; i < 2; ++i) {
+      BitmapDestroy(bitmaps[i]);
+      ZBufferDestroy(zbuffers[i]);
+      SceneDestroy(scenes[i]);
+    }
+    for (int i = 0; i < instanceCount; ++i) {
+      ThingDestroy(instances[i]);
+      TransformerDestroy(transformers[i]);
+    }
+    ThingDestroy(mergedThing);
+    TransformerDestroy(identity);
+    CameraDestroy(camera);
+    PolygonDestroy(mergedPolygon);
+    PolygonDestroy(part);
+  }
+  { // levels of detail: none drawn at threshold 0, coarser ones as the thing moves away, the coarsest at any distance for a huge threshold
+    // within a quarter of a pixel, the thing filling the view needs a finer level than the same thing 2 pixels wide
+    Camera *camera = CameraPerspectiveProjection(V0, V(0, 0, 1), V(0, 1, 0), WIDTH, HEIGHT, 0.1, 1000, 90);
+    Polygon *polygon = CreateGrid(24, 4);
+    for (uint64_t v = 0; v < polygon->vertex; ++v) {
+      const float *position = &polygon->positions[v * 3];
+      polygon->positions[v * 3 + 2] = 0.6f * sinf(position[0] * 2) * cosf(position[1] * 2);
+    }
+    PolygonCalculateVertexNormals(polygon);
+    PolygonCalculateBoundingSphere(polygon);
+    const Material material = (Material){V(0.3, 0.6, 0.2), 1, 1, 1, 30, true};
+    Light light = LightCreatePointLight(V(1, 1, 1), V(1, 1, 1), V(1, 2, 3));
+    Transformer *near = TransformerCreate(V(0, 0, -3), V0, V(1, 1, 1)), *far = TransformerCreate(V(0, 0, -60), V0, V(1, 1, 1));
+    Thing *thing = ThingCreate(polygon, near, &material);
+    Scene *scene = SceneCreateEmpty();
+    RenderStatistics statistics;
+    SceneSetCamera(scene, camera);
+    SceneAppendLight(scene, &light);
+    SceneAppendThing(scene, thing);
+    SceneSetStatistics(scene, &statistics);
+    Bitmap *bitmaps[2] = {BitmapNewImage(WIDTH, HEIGHT), BitmapNewImage(WIDTH, HEIGHT)};
+    ZBuffer *zbuffer = ZBufferCreate(WIDTH, HEIGHT, RealDepthFormat);
+    SceneRender(scene, bitmaps[0], zbuffer, WorldRender, GouraudShading, PhongReflectionModel);
+
+    const bool built = PolygonBuildLOD(polygon, 8, 0.5);
+    assert(built && polygon->lod != NULL);
+    UNUSED(built);
+    const Polygon *coarsest = PolygonSelectLOD(polygon, REAL_MAX);
+    ZBufferClear(zbuffer);
+    SceneRender(scene, bitmaps[1], zbuffer, WorldRender, GouraudShading, PhongReflectionModel);
+    assert(statistics.trianglesSimplified == 0);
+    for (int y = 0; y < HEIGHT; ++y) {
+      for (int x = 0; x < WIDTH; ++x) {
+        RGBTRIPLE pixels[2];
+        BitmapGetPixelColor(bitmaps[0], x, y, &pixels[0]);
+        BitmapGetPixelColor(bitmaps[1], x, y, &pixels[1]);
+        assert(memcmp(&pixels[0], &pixels[1], sizeof(RGBTRIPLE)) == 0);
+      }
+    }
+
+    uint64_t simplified[2];
+    SceneSetLODThreshold(scene, 0.25);
+    for (int i = 0; i < 2; ++i) {
+      thing->transformer = i == 0 ? near : far;
+      ZBufferClear(zbuffer);
+      SceneRender(scene, bitmaps[1], zbuffer, WorldRender, GouraudShading, PhongReflectionModel);
+      simplified[i] = statistics.trianglesSimplified;
+    }
+    assert(simplified[0] > 0 && simplified[0] < simplified[1] && simplified[1] == polygon->triangle - coarsest->triangle);
+    SceneSetLODThreshold(scene, 1e9);
+    thing->transformer = near;
+    ZBufferClear(zbuffer);
+    SceneRender(scene, bitmaps[1], zbuffer, WorldRender, GouraudShading, PhongReflectionModel);
+    assert(statistics.trianglesSimplified == polygon->triangle - coarsest->triangle && statistics.trianglesRasterized > 0);
+    UNUSED(simplified);
+    UNUSED(coarsest);
+
+    BitmapDestroy(bitmaps[0]);
+    BitmapDestroy(bitmaps[1]);
+    ZBufferDestroy(zbuffer);
+    SceneDestroy(scene);
+    ThingDestroy(thing);
+    TransformerDestroy(near);
+    TransformerDestroy(far);
+    CameraDestroy(camera);
+    PolygonDestroy(polygon);
+  }
+  return 0;
+}
@@ -8,57 +8,38 @@
 bool TransformerUpdateTransformationMatrix(Transformer *transformer) {
   // translate
   Real _translate[][4] = {{1, 0, 0, transformer->location.x}, {0, 1, 0, transformer->location.y}, {0, 0, 1, transformer->location.z}, {0, 0, 0, 1}};
-  Matrix *translate = MatrixFromArray(4, 4, _translate);
+  Mat4 translate = Mat4FromArray(_translate);
 
   // scale
   Real _scale[][4] = {{transformer->scale.x, 0, 0, 0}, {0, transformer->scale.y, 0, 0}, {0, 0, transformer->scale.z, 0}, {0, 0, 0, 1}};
-  Matrix *scale = MatrixFromArray(4, 4, _scale);
+  Mat4 scale = Mat4FromArray(_scale);
 
   // rotate X axis
   Real _rotateX[][4] = {
-      {1, 0, 0, 0}, {0, cosl((transformer->rotation.x)), -sinl((transformer->rotation.x)), 0}, {0, sinl((transformer->rotation.x)), cosl((transformer->rotation.x)), 0}, {0, 0, 0, 1}};
-  Matrix *rotateX = MatrixFromArray(4, 4, _rotateX);
+      {1, 0, 0, 0}, {0, COS((transformer->rotation.x)), -SIN((transformer->rotation.x)), 0}, {0, SIN((transformer->rotation.x)), COS((transformer->rotation.x)), 0}, {0, 0, 0, 1}};
+  Mat4 rotateX = Mat4FromArray(_rotateX);
 
   // rotate Y axis
-  Real _rotateY[][4] = {{cosl(transformer->rotation.y), 0, sinl(transformer->rotation.y), 0}, {0, 1, 0, 0}, {-sinl(transformer->rotation.y), 0, cosl(transformer->rotation.y), 0}, {0, 0, 0, 1}};
-  Matrix *rotateY = MatrixFromArray(4, 4, _rotateY);
+  Real _rotateY[][4] = {{COS(transformer->rotation.y), 0, SIN(transformer->rotation.y), 0}, {0, 1, 0, 0}, {-SIN(transformer->rotation.y), 0, COS(transformer->rotation.y), 0}, {0, 0, 0, 1}};
+  Mat4 rotateY = Mat4FromArray(_rotateY);
 
   // rotate Z axis
-  Real _rotateZ[][4] = {{cosl(transformer->rotation.z), -sinl(transformer->rotation.z), 0, 0}, {sinl(transformer->rotation.z), cosl(transformer->rotation.z), 0, 0}, {0, 0, 1, 0}, {0, 0, 0, 1}};
-  Matrix *rotateZ = MatrixFromArray(4, 4, _rotateZ);
+  Real _rotateZ[][4] = {{COS(transformer->rotation.z), -SIN(transformer->rotation.z), 0, 0}, {SIN(transformer->rotation.z), COS(transformer->rotation.z), 0, 0}, {0, 0, 1, 0}, {0, 0, 0, 1}};
+  Mat4 rotateZ = Mat4FromArray(_rotateZ);
 
-  Matrix *_a = MatrixMultiplication(translate, scale);
-  Matrix *_b = MatrixMultiplication(_a, rotateX);
-  Matrix *_c = MatrixMultiplication(_b, rotateY);
-  Matrix *_d = MatrixMultiplication(_c, rotateZ);
-
-  if (transformer->matrix != NULL) {
-    MatrixDestroy(transformer->matrix);
-  }
-  transformer->matrix = _d;
-
-  if (transformer->inverseMatrix != NULL) {
-    MatrixDestroy(transformer->inverseMatrix);
-  }
-  transformer->inverseMatrix = MatrixInverse(_d);
-
-  MatrixDestroy(_c);
-  MatrixDestroy(_b);
-  MatrixDestroy(_a);
-
-  MatrixDestroy(rotateZ);
-  MatrixDestroy(rotateY);
-  MatrixDestroy(rotateX);
-
-  MatrixDestroy(scale);
-  MatrixDestroy(translate);
+  Mat4 _a = Mat4Multiplication(&translate, &scale);
+  Mat4 _b = Mat4Multiplication(&_a, &rotateX);
+  Mat4 _c = Mat4Multiplication(&_b, &rotateY);
+  transformer->matrix = Mat4Multiplication(&_c, &rotateZ);
+  transformer->inverseMatrix = Mat4Inverse(&transformer->matrix);
+  transformer->normalMatrix = Mat4Transpose(&transformer->inverseMatrix);
 
   return true;
 }
 
 Transformer *TransformerCreate(const Vector location, const Vector rotation, const Vector scale) {
   Transformer *t = (Transformer *)calloc(1, sizeof(Transformer));
-  *t = (Transformer){location, rotation, scale, NULL, NULL};
+  *t = (Transformer){location, rotation, scale, Mat4Identity(), Mat4Identity(), Mat4Identity()};
   TransformerUpdateTransformationMatrix(t);
   return t;
 }
@@ -70,22 +51,17 @@ bool TransformerDestroy(Transformer *transformer) {
 #endif
     return false;
   }
-  MatrixDestroy(transformer->matrix);
-  MatrixDestroy(transformer->inverseMatrix);
   free(transformer);
   return true;
 }
 
 Vector TransformerTransformPoint(const Transformer *transformer, const Vector point) {
-  Real _prevPoint[][1] = {{point.x}, {point.y}, {point.z}, {1}};
-  Matrix *prevPoint = MatrixFromArray(4, 1, _prevPoint);
-  Matrix *translatedPoint = MatrixMultiplication(transformer->matrix, prevPoint);
-  Vector np = V(MatrixGetElement(translatedPoint, 0, 0), MatrixGetElement(translatedPoint, 1, 0), MatrixGetElement(translatedPoint, 2, 0));
-  MatrixDestroy(translatedPoint);
-  MatrixDestroy(prevPoint);
-  return np;
+  Vec4 np = Mat4TransformPoint(&transformer->matrix, point);
+  return V(np.x, np.y, np.z);
 }
 
+Vector TransformerTransformNormal(const Transformer *transformer, const Vector normal) { return VectorL2Normalization(Mat4TransformDirection(&transformer->normalMatrix, normal)); }
+
 Triangle TransformerTransformTriangle(const Transformer *transformer, const Triangle triangle) {
   if (transformer == NULL) {
 #ifndef NDEBUG
@@ -98,18 +74,25 @@ Triangle TransformerTransformTriangle(const Transformer *transformer, const Tria
   new.vertexes[1] = TransformerTransformPoint(transformer, new.vertexes[1]);
   new.vertexes[2] = TransformerTransformPoint(transformer, new.vertexes[2]);
   new.surfaceNormal = VectorTriangleNormal(new.vertexes[0], new.vertexes[1], new.vertexes[2]);
-  new.vertexNormals[0] = VectorL2Normalization(TransformerTransformPoint(transformer, new.vertexNormals[0]));
-  new.vertexNormals[1] = VectorL2Normalization(TransformerTransformPoint(transformer, new.vertexNormals[1]));
-  new.vertexNormals[2] = VectorL2Normalization(TransformerTransformPoint(transformer, new.vertexNormals[2]));
+  new.vertexNormals[0] = TransformerTransformNormal(transformer, new.vertexNormals[0]);
+  new.vertexNormals[1] = TransformerTransformNormal(transformer, new.vertexNormals[1]);
+  new.vertexNormals[2] = TransformerTransformNormal(transformer, new.vertexNormals[2]);
   return new;
 }
 
 Vector TransformerDetransform(const Transformer *transformer, const Vector point) {
-  Real _translatedPoint[][1] = {{point.x}, {point.y}, {point.z}, {1}};
-  Matrix *translatedPoint = MatrixFromArray(4, 1, _translatedPoint);
-  Matrix *prevPoint = MatrixMultiplication(transformer->inverseMatrix, translatedPoint);
-  Vector np = V(MatrixGetElement(prevPoint, 0, 0), MatrixGetElement(prevPoint, 1, 0), MatrixGetElement(prevPoint, 2, 0));
-  MatrixDestroy(prevPoint);
-  MatrixDestroy(translatedPoint);
-  return np;
+  Vec4 np = Mat4TransformPoint(&transformer->inverseMatrix, point);
+  return V(np.x, np.y, np.z);
+}
+
+/**
+ * Largest factor by which the transformation stretches a length, used to transform bounding spheres
+ */
+Real TransformerMaximumScale(const Transformer *transformer) {
+  const Real *m = transformer->matrix.m;
+  Real scale = 0;
+  for (int column = 0; column < 3; ++column) {
+    scale = FMAX(scale, SQRT(m[column] * m[column] + m[4 + column] * m[4 + column] + m[8 + column] * m[8 + column]));
+  }
+  return scale;
 }
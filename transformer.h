@@ -8,15 +8,18 @@ typedef struct tagTransformer {
   Vector location;
   Vector rotation; // radian
   Vector scale;
-  Matrix *matrix;
-  Matrix *inverseMatrix;
+  Mat4 matrix;
+  Mat4 inverseMatrix;
+  Mat4 normalMatrix; // transpose of inverseMatrix, keeps normal vectors perpendicular under non-uniform scale
 } Transformer;
 
 Transformer *TransformerCreate(Vector location, Vector rotation, Vector scale);
 bool TransformerDestroy(Transformer *transformer);
 bool TransformerUpdateTransformationMatrix(Transformer *transformer);
 Vector TransformerTransformPoint(const Transformer *transformer, Vector point);
+Vector TransformerTransformNormal(const Transformer *transformer, Vector normal);
 Triangle TransformerTransformTriangle(const Transformer *transformer, Triangle triangle);
 Vector TransformerDetransform(const Transformer *transformer, Vector point);
+Real TransformerMaximumScale(const Transformer *transformer);
 
 #endif // RENDER_TRANSFORMER_H
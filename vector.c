@@ -4,11 +4,11 @@
 
 #include "vector.h"
 
-void VectorPrint(const Vector v) { printf("{{%Lf},{%Lf},{%Lf}}\n", v.x, v.y, v.z); }
+void VectorPrint(const Vector v) { printf("{{" REAL_FORMAT "},{" REAL_FORMAT "},{" REAL_FORMAT "}}\n", v.x, v.y, v.z); }
 
 bool VectorCompare(const Vector v1, const Vector v2) { return v1.x == v2.x && v1.y == v2.y && v1.z == v2.z; }
 
-bool VectorCompareLoose(const Vector v1, const Vector v2, Real error) { return fabsl(v1.x - v2.x) < error && fabsl(v1.y - v2.y) < error && fabsl(v1.z - v2.z) < error; }
+bool VectorCompareLoose(const Vector v1, const Vector v2, Real error) { return FABS(v1.x - v2.x) < error && FABS(v1.y - v2.y) < error && FABS(v1.z - v2.z) < error; }
 
 Vector VectorNegative(const Vector v) { return (Vector){-v.x, -v.y, -v.z}; }
 
@@ -28,14 +28,14 @@ Vector VectorCrossProduct(const Vector v1, const Vector v2) { return (Vector){-v
 
 Real VectorDotProduct(const Vector v1, const Vector v2) { return v1.x * v2.x + v1.y * v2.y + v1.z * v2.z; }
 
-Real VectorEuclideanNorm(const Vector v) { return sqrtl(v.x * v.x + v.y * v.y + v.z * v.z); }
+Real VectorEuclideanNorm(const Vector v) { return SQRT(v.x * v.x + v.y * v.y + v.z * v.z); }
 
 Vector VectorL2Normalization(const Vector v) {
   Real norm = VectorEuclideanNorm(v);
-  return VectorScalarDivision(v, norm == 0 ? LDBL_MAX : norm);
+  return VectorScalarDivision(v, norm == 0 ? REAL_MAX : norm);
 }
 
-Real VectorEuclideanDistance(const Vector v1, const Vector v2) { return sqrtl((v2.x - v1.x) * (v2.x - v1.x) + (v2.y - v1.y) * (v2.y - v1.y) + (v2.z - v1.z) * (v2.z - v1.z)); }
+Real VectorEuclideanDistance(const Vector v1, const Vector v2) { return SQRT((v2.x - v1.x) * (v2.x - v1.x) + (v2.y - v1.y) * (v2.y - v1.y) + (v2.z - v1.z) * (v2.z - v1.z)); }
 
 bool VectorInsideTriangle2D(const Vector v, const Vector v1, const Vector v2, const Vector v3) {
   int8_t sign = v1.x * v2.y + v1.y * v3.x + v2.x * v3.y < v1.y * v2.x + v2.y * v3.x + v1.x * v3.y ? -1 : 1;
@@ -38,7 +38,7 @@ Vector LightGetPosition(const Light light) {
   case PointLight:
     return light.position;
   case DirectionalLight:
-    return VectorScalarMultiplication(light.direction, LDBL_MAX);
+    return VectorScalarMultiplication(light.direction, REAL_MAX);
   default:
 #ifndef NDEBUG
     fprintf(stderr, "%s: Invalid light type (%d)\n", __FUNCTION_NAME__, light.type);
@@ -72,6 +72,10 @@ Scene *SceneCreateEmpty() {
 }
 
 bool SceneDestroy(Scene *scene) {
+  if (scene->bvh != NULL) {
+    BVHDestroy(scene->bvh);
+  }
+  free(scene->bvhMatrices);
   free(scene->things);
   free(scene->lights);
   free(scene);
@@ -83,6 +87,36 @@ bool SceneSetCamera(Scene *scene, Camera *camera) {
   return true;
 }
 
+bool SceneSetRenderBackend(Scene *scene, RenderBackendType backend) {
+  scene->backend = backend;
+  return true;
+}
+
+bool SceneSetDepthPrepass(Scene *scene, bool depthPrepass) {
+  scene->depthPrepass = depthPrepass;
+  return true;
+}
+
+bool SceneSetStatistics(Scene *scene, RenderStatistics *statistics) {
+  scene->statistics = statistics;
+  return true;
+}
+
+/**
+ * Draw levels of detail of the polygons (PolygonBuildLOD) by the size of the things on screen: the coarsest level whose error, projected at the distance of the thing, stays within pixels.
+ * @param scene
+ * @param pixels largest error on screen, 0 (default) draws the full polygons
+ * @return
+ */
+bool SceneSetLODThreshold(Scene *scene, Real pixels) {
+  if (!(pixels >= 0)) {
+    fprintf(stderr, "%s: negative threshold\n", __FUNCTION_NAME__);
+    return false;
+  }
+  scene->lodThreshold = pixels;
+  return true;
+}
+
 bool SceneAppendThing(Scene *scene, Thing *thing) {
   // TODO: extract duplicated codes to dynamic array allocator
   uint64_t thingCount = scene->thing;
@@ -121,76 +155,144 @@ bool SceneAppendLight(Scene *scene, Light *light) {
   return true;
 }
 
-// TODO: merge with DrawTriangle
-void _DrawTriangleFlat(Bitmap *bitmap, const Vector v1, const Vector v2, const Vector v3, Color color, ZBuffer *zbuffer) {
-  const uint32_t maxX = (uint32_t)fminl(fmaxl(fmaxl(v1.x, fmaxl(v2.x, v3.x)), 0), bitmap->dibHeader.bcWidth - 1);
-  const uint32_t minX = (uint32_t)fmaxl(fminl(v1.x, fminl(v2.x, v3.x)), 0);
-  const uint32_t maxY = (uint32_t)fminl(fmaxl(fmaxl(v1.y, fmaxl(v2.y, v3.y)), 0), bitmap->dibHeader.bcHeight - 1);
-  const uint32_t minY = (uint32_t)fmaxl(fminl(v1.y, fminl(v2.y, v3.y)), 0);
-
-  for (uint32_t y = minY; y <= maxY; ++y) {
-    for (uint32_t x = minX; x <= maxX; ++x) {
-      if (VectorInsideTriangle2D(V(x, y, 0), v1, v2, v3)) {
-        Vector weight = VectorBarycentricCoordinateWeight(V(x, y, 0), v1, v2, v3);
-        Real depth = v1.z * weight.x + v2.z * weight.y + v3.z * weight.z;
-        if (zbuffer == NULL || ZBufferTestAndUpdate(zbuffer, x, y, depth)) {
-          BitmapSetPixelColor(bitmap, x, bitmap->dibHeader.bcHeight - y - 1, BMP_COLOR(color.x * 255, color.y * 255, color.z * 255));
-        }
-      }
-    }
+/**
+ * Box of a thing in world space, from the box of its polygon (the root of its BVH, else around its bounding sphere)
+ */
+void _SceneThingBox(const Thing *thing, float box[6]) {
+  const Polygon *polygon = thing->polygon;
+  Vector corners[2];
+  if (polygon->bvh != NULL && polygon->bvh->primitive > 0) {
+    const BVHNode *root = &polygon->bvh->nodes[0];
+    corners[0] = V(root->min[0], root->min[1], root->min[2]);
+    corners[1] = V(root->max[0], root->max[1], root->max[2]);
+  } else {
+    corners[0] = VectorScalarSubtraction(polygon->boundingCenter, polygon->boundingRadius);
+    corners[1] = VectorScalarAddition(polygon->boundingCenter, polygon->boundingRadius);
+  }
+  Vector min = V(REAL_MAX, REAL_MAX, REAL_MAX), max = V(-REAL_MAX, -REAL_MAX, -REAL_MAX);
+  for (int corner = 0; corner < 8; ++corner) {
+    const Vector v = TransformerTransformPoint(thing->transformer, V(corners[corner & 1].x, corners[corner >> 1 & 1].y, corners[corner >> 2].z));
+    min = V(FMIN(min.x, v.x), FMIN(min.y, v.y), FMIN(min.z, v.z));
+    max = V(FMAX(max.x, v.x), FMAX(max.y, v.y), FMAX(max.z, v.z));
   }
+  BVHBoxFromReal(min, max, box);
 }
 
-// TODO: merge with DrawTriangle
-void _DrawTriangleGouraud(Bitmap *bitmap, const Vector v1, const Vector v2, const Vector v3, Color c1, Color c2, Color c3, ZBuffer *zbuffer) {
-  const uint32_t maxX = (uint32_t)fminl(fmaxl(fmaxl(v1.x, fmaxl(v2.x, v3.x)), 0), bitmap->dibHeader.bcWidth - 1);
-  const uint32_t minX = (uint32_t)fmaxl(fminl(v1.x, fminl(v2.x, v3.x)), 0);
-  const uint32_t maxY = (uint32_t)fminl(fmaxl(fmaxl(v1.y, fmaxl(v2.y, v3.y)), 0), bitmap->dibHeader.bcHeight - 1);
-  const uint32_t minY = (uint32_t)fmaxl(fminl(v1.y, fminl(v2.y, v3.y)), 0);
-
-  for (uint32_t y = minY; y <= maxY; ++y) {
-    for (uint32_t x = minX; x <= maxX; ++x) {
-      if (VectorInsideTriangle2D(V(x, y, 0), v1, v2, v3)) {
-        Vector weight = VectorBarycentricCoordinateWeight(V(x, y, 0), v1, v2, v3);
-        Real depth = v1.z * weight.x + v2.z * weight.y + v3.z * weight.z;
-        Color color = VectorAddition(VectorScalarMultiplication(c1, weight.x), VectorAddition(VectorScalarMultiplication(c2, weight.y), VectorScalarMultiplication(c3, weight.z)));
-        if (zbuffer == NULL || ZBufferTestAndUpdate(zbuffer, x, y, depth)) {
-          BitmapSetPixelColor(bitmap, x, bitmap->dibHeader.bcHeight - y - 1, BMP_COLOR(color.x * 255, color.y * 255, color.z * 255));
-        }
-      }
-    }
+/**
+ * Build (or rebuild) the BVH of the things of the scene from their boxes in world space.
+ * WorldRender culls things with it and SceneRaycast queries it, things appended or moved afterwards are tested apart by their bounding sphere and polygon.
+ * Call again after moving things, or after building the BVH of their polygons for tighter boxes.
+ * @param scene
+ * @return
+ */
+bool SceneBuildBVH(Scene *scene) {
+  if (scene->thing > UINT32_MAX) {
+    fprintf(stderr, "%s: too many things (%llu)\n", __FUNCTION_NAME__, (unsigned long long)scene->thing);
+    return false;
+  }
+  float *boxes = (float *)malloc((scene->thing > 0 ? scene->thing : 1) * 6 * sizeof(float));
+  for (uint64_t thingIndex = 0; thingIndex < scene->thing; ++thingIndex) {
+    _SceneThingBox(scene->things[thingIndex], &boxes[thingIndex * 6]);
   }
+  BVH *bvh = BVHCreate(boxes, (uint32_t)scene->thing);
+  free(boxes);
+  if (bvh == NULL) {
+    return false;
+  }
+  if (scene->bvh != NULL) {
+    BVHDestroy(scene->bvh);
+  }
+  scene->bvh = bvh;
+  free(scene->bvhMatrices);
+  scene->bvhMatrices = (Mat4 *)malloc((scene->thing > 0 ? scene->thing : 1) * sizeof(Mat4));
+  for (uint64_t thingIndex = 0; thingIndex < scene->thing; ++thingIndex) {
+    scene->bvhMatrices[thingIndex] = scene->things[thingIndex]->transformer->matrix;
+  }
+  return true;
 }
 
-// TODO: merge with DrawTriangle
-void _DrawTrianglePhong(Bitmap *bitmap, const Triangle *triangleNDC, const Triangle *triangleWorld, ZBuffer *zbuffer, const Scene *scene, const Thing *thing,
-                        Color reflectionModel(const Scene *, const Thing *, const Vector, const Vector)) {
-  const Vector v1 = triangleNDC->vertexes[0], v2 = triangleNDC->vertexes[1], v3 = triangleNDC->vertexes[2];
+/**
+ * Whether the BVH of the scene holds the box of the thing where it is: the thing was there at SceneBuildBVH and has not moved since
+ */
+FORCE_INLINE bool _SceneThingInBVH(const Scene *scene, uint64_t thingIndex) {
+  return scene->bvh != NULL && thingIndex < scene->bvh->primitive && Mat4Compare(&scene->things[thingIndex]->transformer->matrix, &scene->bvhMatrices[thingIndex]);
+}
 
-  const uint32_t maxX = (uint32_t)fminl(fmaxl(fmaxl(v1.x, fmaxl(v2.x, v3.x)), 0), bitmap->dibHeader.bcWidth - 1);
-  const uint32_t minX = (uint32_t)fmaxl(fminl(v1.x, fminl(v2.x, v3.x)), 0);
-  const uint32_t maxY = (uint32_t)fminl(fmaxl(fmaxl(v1.y, fmaxl(v2.y, v3.y)), 0), bitmap->dibHeader.bcHeight - 1);
-  const uint32_t minY = (uint32_t)fmaxl(fminl(v1.y, fminl(v2.y, v3.y)), 0);
+typedef struct tagSceneRayContext {
+  const Scene *scene;
+  uint64_t *triangleIndex;
+} SceneRayContext;
 
-  for (uint32_t y = minY; y <= maxY; ++y) {
-    for (uint32_t x = minX; x <= maxX; ++x) {
-      if (VectorInsideTriangle2D(V(x, y, 0), v1, v2, v3)) {
-        Vector weight = VectorBarycentricCoordinateWeight(V(x, y, 0), v1, v2, v3);
-        Real depth = v1.z * weight.x + v2.z * weight.y + v3.z * weight.z;
-        Vector weightedSurfacePosition =
-            VectorAddition(VectorScalarMultiplication(triangleWorld->vertexes[0], weight.x),
-                           VectorAddition(VectorScalarMultiplication(triangleWorld->vertexes[1], weight.y), VectorScalarMultiplication(triangleWorld->vertexes[2], weight.z)));
-        Vector weightedVertexNormal =
-            VectorAddition(VectorScalarMultiplication(triangleWorld->vertexNormals[0], weight.x),
-                           VectorAddition(VectorScalarMultiplication(triangleWorld->vertexNormals[1], weight.y), VectorScalarMultiplication(triangleWorld->vertexNormals[2], weight.z)));
-        Color color = reflectionModel(scene, thing, weightedSurfacePosition, weightedVertexNormal);
+/**
+ * Intersect the ray with a thing in its object space, where the ray keeps its parameter
+ */
+bool _SceneRayThing(const void *context, uint32_t thingIndex, Vector origin, Vector direction, Real *distance) {
+  const SceneRayContext *rayContext = (const SceneRayContext *)context;
+  const Thing *thing = rayContext->scene->things[thingIndex];
+  return PolygonRaycast(thing->polygon, TransformerDetransform(thing->transformer, origin), Mat4TransformDirection(&thing->transformer->inverseMatrix, direction), distance,
+                        rayContext->triangleIndex);
+}
 
-        if (zbuffer == NULL || ZBufferTestAndUpdate(zbuffer, x, y, depth)) {
-          BitmapSetPixelColor(bitmap, x, bitmap->dibHeader.bcHeight - y - 1, BMP_COLOR(color.x * 255, color.y * 255, color.z * 255));
-        }
-      }
+/**
+ * Intersect the ray with a thing found through the BVH of the scene, things moved since SceneBuildBVH are tested apart
+ */
+bool _SceneRayBVHThing(const void *context, uint32_t thingIndex, Vector origin, Vector direction, Real *distance) {
+  return _SceneThingInBVH(((const SceneRayContext *)context)->scene, thingIndex) && _SceneRayThing(context, thingIndex, origin, direction, distance);
+}
+
+/**
+ * Find the nearest triangle hit by the ray origin + t * direction (t >= 0) in world space, through the BVH of the scene and of the polygons where they are built.
+ * Both sides of the triangles are hit, whatever the material, and the full polygons are tested whatever level of detail is drawn.
+ * @param scene
+ * @param origin
+ * @param direction need not be normalized, hit->distance is measured in its length
+ * @param hit [out]
+ * @return true if a triangle is hit
+ */
+bool SceneRaycast(const Scene *scene, Vector origin, Vector direction, SceneHit *hit) {
+  uint64_t triangleIndex = 0;
+  const SceneRayContext context = {scene, &triangleIndex};
+  Real distance = REAL_MAX;
+  bool found = false;
+  uint64_t thingIndex = 0;
+  uint32_t primitive;
+  const bool built = scene->bvh != NULL && scene->bvh->primitive <= scene->thing;
+  if (built && BVHRaycast(scene->bvh, origin, direction, _SceneRayBVHThing, &context, &distance, &primitive)) {
+    found = true;
+    hit->thingIndex = primitive;
+    hit->triangleIndex = triangleIndex;
+  }
+  // things appended or moved after SceneBuildBVH
+  for (thingIndex = 0; thingIndex < scene->thing; ++thingIndex) {
+    if ((!built || !_SceneThingInBVH(scene, thingIndex)) && _SceneRayThing(&context, (uint32_t)thingIndex, origin, direction, &distance)) {
+      found = true;
+      hit->thingIndex = thingIndex;
+      hit->triangleIndex = triangleIndex;
     }
   }
+  if (found) {
+    hit->distance = distance;
+    hit->position = VectorAddition(origin, VectorScalarMultiplication(direction, distance));
+  }
+  return found;
+}
+
+/**
+ * Find the nearest triangle seen through the center of a pixel, in image space as rasterized (ZBufferGetDepth coordinates).
+ * @param scene
+ * @param x
+ * @param y
+ * @param hit [out]
+ * @return true if a triangle is hit
+ */
+bool ScenePick(const Scene *scene, uint32_t x, uint32_t y, SceneHit *hit) {
+  const Camera *camera = scene->camera;
+  const Vector ndc = ImagePos2NDCPos(camera, V((Real)x + 0.5, (Real)y + 0.5, 0));
+  // WorldPos2NDCPos divides x and y by -w, so the clip position (x, y, z, -1) is on the ray through the pixel for any z; it is behind the center of projection if the world w is negative
+  const Vec4 point = Mat4TransformVec4(&camera->ndc2world, (Vec4){ndc.x, ndc.y, 0, -1});
+  const Vector origin = CameraGetCenterOfProjection(camera);
+  const Vector direction = VectorSubtraction(V(point.x / point.w, point.y / point.w, point.z / point.w), origin);
+  return SceneRaycast(scene, origin, point.w > 0 ? direction : VectorNegative(direction), hit);
 }
 
 bool _SceneRenderWireframe(const Scene *scene, Bitmap *bitmap, bool normals) {
@@ -199,7 +301,7 @@ bool _SceneRenderWireframe(const Scene *scene, Bitmap *bitmap, bool normals) {
 
     // draw wireframe
     for (uint64_t triangleIndex = 0; triangleIndex < thing->polygon->triangle; ++triangleIndex) {
-      Triangle triangle = thing->polygon->triangles[triangleIndex];
+      Triangle triangle = PolygonGetTriangle(thing->polygon, triangleIndex);
       Triangle triangleWorld = TransformerTransformTriangle(thing->transformer, triangle);
       Triangle triangleNDC = rasterize(scene->camera, triangleWorld);
 
@@ -213,7 +315,7 @@ bool _SceneRenderWireframe(const Scene *scene, Bitmap *bitmap, bool normals) {
       continue;
     }
     for (uint64_t triangleIndex = 0; triangleIndex < thing->polygon->triangle; ++triangleIndex) {
-      Triangle triangle = thing->polygon->triangles[triangleIndex];
+      Triangle triangle = PolygonGetTriangle(thing->polygon, triangleIndex);
       Triangle triangleWorld = TransformerTransformTriangle(thing->transformer, triangle);
 
       // draw surface normal vectors
@@ -232,115 +334,865 @@ bool _SceneRenderWireframe(const Scene *scene, Bitmap *bitmap, bool normals) {
   return true;
 }
 
-bool _SceneRenderFlat(const Scene *scene, Bitmap *bitmap, ZBuffer *zbuffer, Color reflectionModel(const Scene *, const Thing *, const Vector, const Vector)) {
-  for (uint64_t thingIndex = 0; thingIndex < scene->thing; ++thingIndex) {
-    Thing *thing = scene->things[thingIndex];
+FORCE_INLINE Color _PhongReflectionModel(const Scene *scene, const Thing *thing, const Vector surfacePosition, const Vector normal) {
+  Color illumination = VectorScalarMultiplication(V(0.1, 0.1, 0.1), thing->material->ambient);
+  for (uint64_t lightIndex = 0; lightIndex < scene->light; ++lightIndex) {
+    const Light *light = scene->lights[lightIndex];
 
-    for (uint64_t triangleIndex = 0; triangleIndex < thing->polygon->triangle; ++triangleIndex) {
-      Triangle triangle = thing->polygon->triangles[triangleIndex];
-      Triangle triangleWorld = TransformerTransformTriangle(thing->transformer, triangle);
-      Triangle triangleNDC = rasterize(scene->camera, triangleWorld);
+    const Real corr = FMAX(VectorDotProduct(LightGetDirection(*light, surfacePosition), normal), 0); // negative value must be ignored
+    const Vector R_m = VectorSubtraction(VectorScalarMultiplication(normal, 2 * corr), normal);
+
+    Color diffuse = VectorScalarMultiplication(light->diffuse, FMAX(thing->material->diffuse * corr, 0));
+    Color specular =
+        VectorScalarMultiplication(light->specular, thing->material->specular * FMAX(POW(VectorDotProduct(R_m, CameraGetDirection(scene->camera, surfacePosition)), thing->material->shininess), 0));
+
+    illumination = VectorAddition(illumination, VectorAddition(diffuse, specular));
+  }
+
+  illumination = VectorConfine(illumination, 0, 1); // limit range [0-1]
+
+  return V(illumination.x * thing->material->color.x, illumination.y * thing->material->color.y, illumination.z * thing->material->color.z);
+}
+
+FORCE_INLINE Color _BlinnPhongReflectionModel(const Scene *scene, const Thing *thing, const Vector surfacePosition, const Vector normal) {
+  Color illumination = VectorScalarMultiplication(V(0.1, 0.1, 0.1), thing->material->ambient);
+  for (uint64_t lightIndex = 0; lightIndex < scene->light; ++lightIndex) {
+    const Light *light = scene->lights[lightIndex];
+
+    const Real corr = FMAX(VectorDotProduct(LightGetDirection(*light, surfacePosition), normal), 0); // negative value must be ignored
+    const Vector H = VectorL2Normalization(VectorAddition(LightGetDirection(*light, surfacePosition), CameraGetDirection(scene->camera, surfacePosition)));
+
+    Color diffuse = VectorScalarMultiplication(light->diffuse, FMAX(thing->material->diffuse * corr, 0));
+    Color specular = VectorScalarMultiplication(light->specular, thing->material->specular * FMAX(POW(VectorDotProduct(normal, H), thing->material->shininess), 0));
+
+    illumination = VectorAddition(illumination, VectorAddition(diffuse, specular));
+  }
+
+  illumination = VectorConfine(illumination, 0, 1); // limit range [0 - 1]
+
+  return V(illumination.x * thing->material->color.x, illumination.y * thing->material->color.y, illumination.z * thing->material->color.z);
+}
+
+FORCE_INLINE Color _NullReflectionModel(const Scene *scene, const Thing *thing, const Vector surfacePosition, const Vector normal) {
+  UNUSED(scene);
+  UNUSED(surfacePosition);
+  UNUSED(normal);
+  return thing->material->color;
+}
+
+FORCE_INLINE Color _ReflectionModel(ReflectionModelType reflectionModelType, const Scene *scene, const Thing *thing, const Vector surfacePosition, const Vector normal) {
+  switch (reflectionModelType) {
+  case PhongReflectionModel:
+    return _PhongReflectionModel(scene, thing, surfacePosition, normal);
+  case BlinnPhongReflectionModel:
+    return _BlinnPhongReflectionModel(scene, thing, surfacePosition, normal);
+  default:
+    return _NullReflectionModel(scene, thing, surfacePosition, normal);
+  }
+}
+
+/**
+ * Triangle which passed the geometry stage, set up for rasterization with everything its shading needs
+ */
+typedef struct tagRenderTriangle {
+  bool visible; // false if the triangle does not cover the image
+  TriangleEdges edges;
+  Color colors[3]; // [Flat/Null shading] colors[0] is the triangle color, [Gouraud shading] vertex colors
+  Triangle world;  // [Phong shading] triangle in world space
+  const Thing *thing;
+} RenderTriangle;
 
-      Color color = reflectionModel(scene, thing, VectorTriangleCenterOfGravity(triangleWorld.vertexes[0], triangleWorld.vertexes[1], triangleWorld.vertexes[2]), triangleWorld.surfaceNormal);
+typedef struct tagShadingContext {
+  Bitmap *bitmap;
+  const Scene *scene;
+  const RenderTriangle *renderTriangle;
+} ShadingContext;
 
-      _DrawTriangleFlat(bitmap, triangleNDC.vertexes[0], triangleNDC.vertexes[1], triangleNDC.vertexes[2], color, zbuffer);
+/**
+ * Shade the pixels (blockX + lane, y) of a block row which passed the depth test.
+ * Called with constant shading and reflection model types only, so each specialization keeps just its own branch.
+ */
+FORCE_INLINE void _ShadeRow(const ShadingContext *context, uint32_t blockX, uint32_t y, uint32_t passed, const FragmentRow *fragments, ShadingType shadingType,
+                            ReflectionModelType reflectionModelType) {
+  const RenderTriangle *renderTriangle = context->renderTriangle;
+  const uint16_t bitmapY = context->bitmap->dibHeader.bcHeight - y - 1;
+  Color colors[RASTERIZER_BLOCK_SIZE];
+  switch (shadingType) {
+  case NullShading:
+  case FlatShading:
+    for (uint32_t lane = 0; lane < RASTERIZER_BLOCK_SIZE; ++lane) {
+      colors[lane] = renderTriangle->colors[0];
+    }
+    break;
+  case GouraudShading:
+    FragmentRowInterpolate(fragments, passed, renderTriangle->colors[0], renderTriangle->colors[1], renderTriangle->colors[2], colors);
+    break;
+  case PhongShading: {
+    const Triangle *triangleWorld = &renderTriangle->world;
+    Vector weightedSurfacePositions[RASTERIZER_BLOCK_SIZE], weightedVertexNormals[RASTERIZER_BLOCK_SIZE];
+    FragmentRowInterpolate(fragments, passed, triangleWorld->vertexes[0], triangleWorld->vertexes[1], triangleWorld->vertexes[2], weightedSurfacePositions);
+    FragmentRowInterpolate(fragments, passed, triangleWorld->vertexNormals[0], triangleWorld->vertexNormals[1], triangleWorld->vertexNormals[2], weightedVertexNormals);
+    for (uint32_t lane = 0; lane < RASTERIZER_BLOCK_SIZE; ++lane) {
+      colors[lane] = passed >> lane & 1 ? _ReflectionModel(reflectionModelType, context->scene, renderTriangle->thing, weightedSurfacePositions[lane], weightedVertexNormals[lane]) : V0;
+    }
+    break;
+  }
+  }
+  for (uint32_t lane = 0; lane < RASTERIZER_BLOCK_SIZE; ++lane) {
+    if (passed >> lane & 1) {
+      BitmapSetPixelColor(context->bitmap, blockX + lane, bitmapY, BMP_COLOR(colors[lane].x * 255, colors[lane].y * 255, colors[lane].z * 255));
     }
   }
-  return true;
 }
 
-bool _SceneRenderGouraud(const Scene *scene, Bitmap *bitmap, ZBuffer *zbuffer, Color reflectionModel(const Scene *, const Thing *, const Vector, const Vector)) {
-  for (uint64_t thingIndex = 0; thingIndex < scene->thing; ++thingIndex) {
-    Thing *thing = scene->things[thingIndex];
+typedef uint64_t (*DrawTriangleFunction)(Bitmap *, ZBuffer *, DepthTestType, const Scene *, const RenderTriangle *, const TriangleEdges *);
 
-    for (uint64_t triangleIndex = 0; triangleIndex < thing->polygon->triangle; ++triangleIndex) {
-      Triangle triangle = thing->polygon->triangles[triangleIndex];
-      Triangle triangleWorld = TransformerTransformTriangle(thing->transformer, triangle);
-      Triangle triangleNDC = rasterize(scene->camera, triangleWorld);
+/*
+ * One draw function per (ShadingType, ReflectionModelType), each one a copy of TriangleEdgesTraverse with its _ShadeRow inlined.
+ * _drawTriangles is indexed by the enum values.
+ */
+#define DEFINE_DRAW_TRIANGLE(shadingType, reflectionModelType)                                                                                                                                         \
+  FORCE_INLINE void _ShadeRow##shadingType##reflectionModelType(const void *context, uint32_t blockX, uint32_t y, uint32_t passed, const FragmentRow *fragments) {                                  \
+    _ShadeRow((const ShadingContext *)context, blockX, y, passed, fragments, shadingType, reflectionModelType);                                                                                       \
+  }                                                                                                                                                                                                  \
+  uint64_t _DrawTriangle##shadingType##reflectionModelType(Bitmap *bitmap, ZBuffer *zbuffer, DepthTestType depthTest, const Scene *scene, const RenderTriangle *renderTriangle,                \
+                                                            const TriangleEdges *edges) {                                                                                                          \
+    const ShadingContext context = {bitmap, scene, renderTriangle};                                                                                                                                 \
+    return TriangleEdgesTraverse(edges, zbuffer, depthTest, _ShadeRow##shadingType##reflectionModelType, &context);                                                                                \
+  }
+#define DEFINE_DRAW_TRIANGLES(shadingType)                                                                                                                                                             \
+  DEFINE_DRAW_TRIANGLE(shadingType, NullReflectionModel)                                                                                                                                               \
+  DEFINE_DRAW_TRIANGLE(shadingType, PhongReflectionModel)                                                                                                                                              \
+  DEFINE_DRAW_TRIANGLE(shadingType, BlinnPhongReflectionModel)
+#define DRAW_TRIANGLES(shadingType)                                                                                                                                                                    \
+  { _DrawTriangle##shadingType##NullReflectionModel, _DrawTriangle##shadingType##PhongReflectionModel, _DrawTriangle##shadingType##BlinnPhongReflectionModel }
 
-      // NOTE: Reflection model uses position in world space
-      Color c1 = reflectionModel(scene, thing, triangleWorld.vertexes[0], triangleWorld.vertexNormals[0]);
-      Color c2 = reflectionModel(scene, thing, triangleWorld.vertexes[1], triangleWorld.vertexNormals[1]);
-      Color c3 = reflectionModel(scene, thing, triangleWorld.vertexes[2], triangleWorld.vertexNormals[2]);
+DEFINE_DRAW_TRIANGLES(NullShading)
+DEFINE_DRAW_TRIANGLES(FlatShading)
+DEFINE_DRAW_TRIANGLES(GouraudShading)
+DEFINE_DRAW_TRIANGLES(PhongShading)
 
-      _DrawTriangleGouraud(bitmap, triangleNDC.vertexes[0], triangleNDC.vertexes[1], triangleNDC.vertexes[2], c1, c2, c3, zbuffer);
+const DrawTriangleFunction _drawTriangles[4][3] = {DRAW_TRIANGLES(NullShading), DRAW_TRIANGLES(FlatShading), DRAW_TRIANGLES(GouraudShading), DRAW_TRIANGLES(PhongShading)};
+
+FORCE_INLINE void _ShadeRowDepthOnly(const void *context, uint32_t blockX, uint32_t y, uint32_t passed, const FragmentRow *fragments) {
+  UNUSED(context);
+  UNUSED(blockX);
+  UNUSED(y);
+  UNUSED(passed);
+  UNUSED(fragments);
+}
+
+/**
+ * Depth-only pass of the depth prepass: fill the z-buffer without shading
+ */
+void _DrawTriangleDepthOnly(ZBuffer *zbuffer, const TriangleEdges *edges) { TriangleEdgesTraverse(edges, zbuffer, LessEqualDepthTest, _ShadeRowDepthOnly, NULL); }
+
+/*
+ * Vertex after the vertex stage: transformed, projected and, with Gouraud shading, lit.
+ * The vertex cache holds one per vertex of a polygon (Polygon.indices), pieces of clipped triangles get theirs on the fly.
+ */
+typedef struct tagShadedVertex {
+  Vector world;       // position in world space
+  Vector worldNormal; // vertex normal in world space
+  Vector image;       // position in image space, as rasterize
+  Color color;        // [Gouraud shading] reflected color
+  uint32_t outcode;   // RasterizerClipOutcode
+} ShadedVertex;
+
+/**
+ * Project vertex->world to the image and light it, from its world space position and normal
+ */
+void _SceneShadeVertex(const Scene *scene, ShadingType shadingType, ReflectionModelType reflectionModelType, const Thing *thing, ShadedVertex *vertex) {
+  const Vec4 clip = Mat4TransformPoint(&scene->camera->world2ndc, vertex->world);
+  vertex->image = NDCPos2ImagePos(scene->camera, ClipPos2NDCPos(clip));
+  vertex->outcode = RasterizerClipOutcode(scene->camera, clip);
+  if (shadingType == GouraudShading) {
+    // NOTE: Reflection model uses position in world space
+    vertex->color = _ReflectionModel(reflectionModelType, scene, thing, vertex->world, vertex->worldNormal);
+  }
+}
+
+/**
+ * Set up one triangle (or clipped piece of the triangle triangleWorld) from its shaded vertexes for rasterization and light it.
+ * Flat shading lights the whole triangle so that its pieces share one color.
+ * @return false if the piece covers no pixel
+ */
+bool _SceneSetupTriangle(const Scene *scene, const Bitmap *bitmap, ShadingType shadingType, ReflectionModelType reflectionModelType, const Thing *thing, const Vector triangleWorld[3],
+                         const ShadedVertex *vertexes[3], RenderTriangle *renderTriangle) {
+  renderTriangle->visible =
+      TriangleEdgesSetup(&renderTriangle->edges, vertexes[0]->image, vertexes[1]->image, vertexes[2]->image, bitmap->dibHeader.bcWidth, bitmap->dibHeader.bcHeight);
+  if (!renderTriangle->visible) {
+    return false;
+  }
+  renderTriangle->thing = thing;
+
+  switch (shadingType) {
+  case NullShading:
+  case FlatShading:
+    renderTriangle->colors[0] = _ReflectionModel(reflectionModelType, scene, thing, VectorTriangleCenterOfGravity(triangleWorld[0], triangleWorld[1], triangleWorld[2]),
+                                                 VectorTriangleNormal(triangleWorld[0], triangleWorld[1], triangleWorld[2]));
+    break;
+  case GouraudShading:
+    for (int vertexIndex = 0; vertexIndex < 3; ++vertexIndex) {
+      renderTriangle->colors[vertexIndex] = vertexes[vertexIndex]->color;
     }
+    break;
+  case PhongShading:
+    renderTriangle->world = (Triangle){VectorTriangleNormal(triangleWorld[0], triangleWorld[1], triangleWorld[2]),
+                                       {vertexes[0]->world, vertexes[1]->world, vertexes[2]->world},
+                                       {vertexes[0]->worldNormal, vertexes[1]->worldNormal, vertexes[2]->worldNormal}};
+    break;
   }
   return true;
 }
 
-bool _SceneRenderPhong(const Scene *scene, Bitmap *bitmap, ZBuffer *zbuffer, Color reflectionModel(const Scene *, const Thing *, const Vector, const Vector)) {
-  for (uint64_t thingIndex = 0; thingIndex < scene->thing; ++thingIndex) {
-    Thing *thing = scene->things[thingIndex];
+/**
+ * Shade the vertexes of a clipped piece and set it up
+ */
+bool _SceneSetupPiece(const Scene *scene, const Bitmap *bitmap, ShadingType shadingType, ReflectionModelType reflectionModelType, const Thing *thing, const Triangle *triangleWorld,
+                      const Triangle *piece, RenderTriangle *renderTriangle) {
+  ShadedVertex shaded[3];
+  const ShadedVertex *vertexes[3] = {&shaded[0], &shaded[1], &shaded[2]};
+  for (int vertexIndex = 0; vertexIndex < 3; ++vertexIndex) {
+    shaded[vertexIndex].world = piece->vertexes[vertexIndex];
+    shaded[vertexIndex].worldNormal = piece->vertexNormals[vertexIndex];
+    _SceneShadeVertex(scene, shadingType, reflectionModelType, thing, &shaded[vertexIndex]);
+  }
+  return _SceneSetupTriangle(scene, bitmap, shadingType, reflectionModelType, thing, triangleWorld->vertexes, vertexes, renderTriangle);
+}
 
-    for (uint64_t triangleIndex = 0; triangleIndex < thing->polygon->triangle; ++triangleIndex) {
-      Triangle triangle = thing->polygon->triangles[triangleIndex];
-      Triangle triangleWorld = TransformerTransformTriangle(thing->transformer, triangle);
-      Triangle triangleNDC = rasterize(scene->camera, triangleWorld);
+/**
+ * Mark the primitives of the BVH nodes which are not entirely outside one side of the clip volume (RasterizerClipOutcode), toClip maps the space of the BVH to clip space.
+ * A node is tested by the outcodes of the corners of its box, enlarged so that rounding can't cull a visible primitive, and the subtree of a node entirely inside is accepted as a whole.
+ * Every primitive of a culled node would be rejected by the outcodes of its vertexes, so the image does not change.
+ * @return number of primitives culled
+ */
+uint64_t _SceneCullBVH(const Camera *camera, const BVH *bvh, const Mat4 *toClip, uint8_t *visible) {
+  memset(visible, 0, bvh->primitive);
+  if (bvh->primitive == 0) {
+    return 0;
+  }
+  uint64_t culled = 0;
+  uint32_t stack[BVH_STACK_SIZE], stackSize = 0;
+  stack[stackSize++] = 0;
+  while (stackSize > 0) {
+    const uint32_t nodeIndex = stack[--stackSize];
+    const BVHNode *node = &bvh->nodes[nodeIndex];
+    Real corners[2][3];
+    for (int axis = 0; axis < 3; ++axis) {
+      const Real margin = (node->max[axis] - node->min[axis]) * (Real)1e-4 + FMAX(FABS(node->min[axis]), FABS(node->max[axis])) * (Real)1e-4;
+      corners[0][axis] = node->min[axis] - margin;
+      corners[1][axis] = node->max[axis] + margin;
+    }
+    uint32_t outsideAll = ~0u, outsideAny = 0;
+    for (int corner = 0; corner < 8; ++corner) {
+      const uint32_t outside = RasterizerClipOutcode(camera, Mat4TransformPoint(toClip, V(corners[corner & 1][0], corners[corner >> 1 & 1][1], corners[corner >> 2][2])));
+      outsideAll &= outside;
+      outsideAny |= outside;
+    }
+    uint32_t first, count;
+    BVHNodePrimitives(bvh, nodeIndex, &first, &count);
+    if (outsideAll != 0) {
+      culled += count;
+    } else if (outsideAny == 0 || node->count > 0) {
+      for (uint32_t i = first; i < first + count; ++i) {
+        visible[bvh->primitives[i]] = 1;
+      }
+    } else {
+      stack[stackSize++] = node->first + 1;
+      stack[stackSize++] = node->first;
+    }
+  }
+  return culled;
+}
+
+#define SCENE_INSTANCE_TRIANGLES 4096 // things with fewer triangles are shared out between the threads, larger ones are processed by all threads
+#define SCENE_PARALLEL_THINGS 1024    // things tested for culling by all threads
+
+/*
+ * A thing is an instance of its polygon: the polygon data (vertexes, normals, bounds, BVH) is shared, the per-frame work of an instance is set up once from its transformer
+ */
+typedef struct tagSceneInstance {
+  bool visible;           // not culled by the scene BVH and the bounding sphere
+  const Polygon *polygon; // level of detail drawn, the polygon of the thing or one of its simplified levels
+  Vector eye;             // center of projection in object space, for the facing test
+  Real orientation;       // -1 if the transformation mirrors, which flips the winding
+  uint64_t offset;        // first render triangle of the thing
+} SceneInstance;
+
+/*
+ * Buffers of the geometry stage for one polygon at a time
+ */
+typedef struct tagGeometryScratch {
+  uint8_t *frontFaces;       // per triangle
+  uint8_t *usedVertexes;     // per vertex
+  ShadedVertex *vertexCache; // per vertex
+} GeometryScratch;
+
+bool _GeometryScratchCreate(GeometryScratch *scratch, uint64_t triangle, uint64_t vertex) {
+  scratch->frontFaces = (uint8_t *)malloc(triangle > 0 ? triangle : 1);
+  scratch->usedVertexes = (uint8_t *)malloc(vertex > 0 ? vertex : 1);
+  scratch->vertexCache = (ShadedVertex *)malloc((vertex > 0 ? vertex : 1) * sizeof(ShadedVertex));
+  return scratch->frontFaces != NULL && scratch->usedVertexes != NULL && scratch->vertexCache != NULL;
+}
+
+void _GeometryScratchDestroy(GeometryScratch *scratch) {
+  free(scratch->vertexCache);
+  free(scratch->usedVertexes);
+  free(scratch->frontFaces);
+}
+
+/**
+ * Cull, transform, clip, set up and light the triangles of one visible thing into triangles, in the order of its polygon.
+ * parallel spreads the loops over all threads; otherwise they run on the calling thread, which may be one of the threads sharing out small things.
+ */
+void _SceneThingGeometry(const Scene *scene, const Bitmap *bitmap, ShadingType shadingType, ReflectionModelType reflectionModelType, const Thing *thing, const SceneInstance *instance,
+                         bool parallel, GeometryScratch *scratch, RenderTriangle *triangles, uint8_t *extraPieces, RenderStatistics *statistics) {
+#ifndef _OPENMP
+  UNUSED(parallel);
+#endif
+  const Polygon *polygon = instance->polygon;
+  const int64_t triangleCount = (int64_t)polygon->triangle;
+  uint8_t *frontFaces = scratch->frontFaces;
 
-      _DrawTrianglePhong(bitmap, &triangleNDC, &triangleWorld, zbuffer, scene, thing, reflectionModel);
+  uint64_t frustumCulled = 0;
+  if (polygon->bvh != NULL && polygon->bvh->primitive == polygon->triangle) {
+    const Mat4 toClip = Mat4Multiplication(&scene->camera->world2ndc, &thing->transformer->matrix);
+    frustumCulled = _SceneCullBVH(scene->camera, polygon->bvh, &toClip, frontFaces);
+  } else {
+    memset(frontFaces, 1, triangleCount);
+  }
+
+  // a mirroring transformation flips the winding, so the facing test is done against the camera position in object space
+  const bool backfaceCulling = !thing->material->doubleSided;
+  uint64_t backfaceCulled = 0;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) reduction(+ : backfaceCulled) if (parallel)
+#endif
+  for (int64_t triangleIndex = 0; triangleIndex < triangleCount; ++triangleIndex) {
+    if (!frontFaces[triangleIndex]) {
+      continue;
     }
+    const uint32_t *indices = &polygon->indices[triangleIndex * 3];
+    const Vector v0 = PolygonGetPosition(polygon, indices[0]), v1 = PolygonGetPosition(polygon, indices[1]), v2 = PolygonGetPosition(polygon, indices[2]);
+    const Vector normal = VectorCrossProduct(VectorSubtraction(v1, v0), VectorSubtraction(v2, v0));
+    frontFaces[triangleIndex] = !backfaceCulling || VectorDotProduct(normal, VectorSubtraction(instance->eye, v0)) * instance->orientation > 0;
+    backfaceCulled += !frontFaces[triangleIndex];
   }
-  return true;
+
+  // vertex cache: shade the vertexes used by front faces
+  // vertex normals are only interpolated by Gouraud and Phong shading
+  const uint32_t *vertexIndices = polygon->indices;
+  const bool vertexNormals = shadingType == GouraudShading || shadingType == PhongShading;
+  uint8_t *usedVertexes = scratch->usedVertexes;
+  ShadedVertex *vertexCache = scratch->vertexCache;
+  uint64_t vertexesShaded = 0;
+  memset(usedVertexes, 0, polygon->vertex);
+  for (int64_t triangleIndex = 0; triangleIndex < triangleCount; ++triangleIndex) {
+    if (frontFaces[triangleIndex]) {
+      usedVertexes[vertexIndices[triangleIndex * 3]] = usedVertexes[vertexIndices[triangleIndex * 3 + 1]] = usedVertexes[vertexIndices[triangleIndex * 3 + 2]] = 1;
+    }
+  }
+  const int64_t vertexCount = (int64_t)polygon->vertex;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) reduction(+ : vertexesShaded) if (parallel)
+#endif
+  for (int64_t vertexIndex = 0; vertexIndex < vertexCount; ++vertexIndex) {
+    if (!usedVertexes[vertexIndex]) {
+      continue;
+    }
+    ShadedVertex *vertex = &vertexCache[vertexIndex];
+    vertex->world = TransformerTransformPoint(thing->transformer, PolygonGetPosition(polygon, (uint32_t)vertexIndex));
+    vertex->worldNormal = vertexNormals ? TransformerTransformNormal(thing->transformer, PolygonGetNormal(polygon, (uint32_t)vertexIndex)) : V0;
+    _SceneShadeVertex(scene, shadingType, reflectionModelType, thing, vertex);
+    ++vertexesShaded;
+  }
+
+  uint64_t split = 0, extra = 0, rasterized = 0, piecesShaded = 0;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) reduction(+ : split, extra, rasterized, piecesShaded) if (parallel)
+#endif
+  for (int64_t triangleIndex = 0; triangleIndex < triangleCount; ++triangleIndex) {
+    if (!frontFaces[triangleIndex]) {
+      continue;
+    }
+    const ShadedVertex *vertexes[3] = {&vertexCache[vertexIndices[triangleIndex * 3]], &vertexCache[vertexIndices[triangleIndex * 3 + 1]],
+                                       &vertexCache[vertexIndices[triangleIndex * 3 + 2]]};
+    if ((vertexes[0]->outcode & vertexes[1]->outcode & vertexes[2]->outcode) != 0) {
+      continue;
+    }
+    if (((vertexes[0]->outcode | vertexes[1]->outcode | vertexes[2]->outcode) & RASTERIZER_OUTCODE_CLIP) == 0) {
+      const Vector triangleWorld[3] = {vertexes[0]->world, vertexes[1]->world, vertexes[2]->world};
+      rasterized += _SceneSetupTriangle(scene, bitmap, shadingType, reflectionModelType, thing, triangleWorld, vertexes, &triangles[triangleIndex]);
+      continue;
+    }
+
+    Triangle triangleWorld = TransformerTransformTriangle(thing->transformer, PolygonGetTriangle(polygon, (uint64_t)triangleIndex));
+    Triangle pieces[RASTERIZER_CLIP_TRIANGLES];
+    const uint32_t pieceCount = RasterizerClipTriangle(scene->camera, triangleWorld, pieces);
+    if (pieceCount == 0) {
+      continue;
+    }
+    if (pieceCount > 1) {
+      extraPieces[triangleIndex] = (uint8_t)(pieceCount - 1);
+      ++split;
+      extra += pieceCount - 1;
+    }
+    rasterized += _SceneSetupPiece(scene, bitmap, shadingType, reflectionModelType, thing, &triangleWorld, &pieces[0], &triangles[triangleIndex]);
+    piecesShaded += 3;
+  }
+  statistics->trianglesFrustumCulled += frustumCulled;
+  statistics->trianglesBackfaceCulled += backfaceCulled;
+  statistics->trianglesSplit += split;
+  statistics->trianglesRasterized += rasterized;
+  statistics->vertexesShaded += vertexesShaded + piecesShaded;
 }
 
-Color _PhongReflectionModel(const Scene *scene, const Thing *thing, const Vector surfacePosition, const Vector normal) {
-  Color illumination = VectorScalarMultiplication(V(0.1, 0.1, 0.1), thing->material->ambient);
-  for (uint64_t lightIndex = 0; lightIndex < scene->light; ++lightIndex) {
-    const Light *light = scene->lights[lightIndex];
+/**
+ * Geometry stage: cull, transform, clip, set up and light the triangles of every thing in scene order.
+ * Things outside the view frustum are skipped as a whole by the scene BVH (SceneBuildBVH) and their bounding sphere, triangles by the BVH of their polygon (PolygonBuildBVH).
+ * Render triangles are only allocated for the things left, so many instances of a polygon cost by the instances in view rather than by the triangles of the scene.
+ * With a LOD threshold (SceneSetLODThreshold), each thing draws the coarsest level of detail of its polygon whose error, scaled by the projected radius of its bounding sphere, stays within it.
+ * Back faces are rejected in object space, before any transformation, unless the material is double-sided.
+ * Polygons go through a vertex cache: each vertex used by a front face is transformed, projected and lit once, and triangles needing no clipping are assembled from it.
+ * Things of fewer than SCENE_INSTANCE_TRIANGLES triangles are shared out between the threads, larger ones are processed by all threads in turn.
+ * The first piece of a clipped triangle takes the place of the triangle, the other pieces are appended after all things.
+ * @param thingInstances [out] level of detail and first render triangle of each thing, then the offset of the first extra piece (scene->thing + 1 entries), must be freed by caller
+ * @return array of count triangles, must be freed by caller
+ */
+RenderTriangle *_SceneGeometry(const Scene *scene, const Bitmap *bitmap, ShadingType shadingType, ReflectionModelType reflectionModelType, SceneInstance **thingInstances, uint64_t *count,
+                               RenderStatistics *statistics) {
+  const int64_t thingCount = (int64_t)scene->thing;
+  uint64_t total = 0;
+  for (int64_t thingIndex = 0; thingIndex < thingCount; ++thingIndex) {
+    total += scene->things[thingIndex]->polygon->triangle;
+  }
+  *statistics = (RenderStatistics){.things = scene->thing, .triangles = total};
 
-    const Real corr = fmaxl(VectorDotProduct(LightGetDirection(*light, surfacePosition), normal), 0); // negative value must be ignored
-    const Vector R_m = VectorSubtraction(VectorScalarMultiplication(normal, 2 * corr), normal);
+  // things appended or moved after SceneBuildBVH are only tested by their bounding sphere
+  uint8_t *visibleThings = NULL;
+  if (scene->bvh != NULL) {
+    visibleThings = (uint8_t *)malloc(scene->bvh->primitive > 0 ? scene->bvh->primitive : 1);
+    _SceneCullBVH(scene->camera, scene->bvh, &scene->camera->world2ndc, visibleThings);
+  }
+  SceneInstance *instances = *thingInstances = (SceneInstance *)malloc((thingCount + 1) * sizeof(SceneInstance));
+  const Vector centerOfProjection = CameraGetCenterOfProjection(scene->camera);
+  const Real focalLength = scene->camera->image_height * 0.5 / TAN(scene->camera->fov * 0.5 * M_PI / 180); // pixels per unit of tangent
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) if (thingCount > SCENE_PARALLEL_THINGS)
+#endif
+  for (int64_t thingIndex = 0; thingIndex < thingCount; ++thingIndex) {
+    const Thing *thing = scene->things[thingIndex];
+    const Polygon *polygon = thing->polygon;
+    SceneInstance *instance = &instances[thingIndex];
+    const Vector center = TransformerTransformPoint(thing->transformer, polygon->boundingCenter);
+    const Real radius = polygon->boundingRadius * TransformerMaximumScale(thing->transformer);
+    instance->polygon = polygon;
+    instance->visible = (visibleThings == NULL || !_SceneThingInBVH(scene, (uint64_t)thingIndex) || visibleThings[thingIndex]) && CameraSphereInFrustum(scene->camera, center, radius);
+    if (!instance->visible) {
+      continue;
+    }
+    instance->eye = TransformerDetransform(thing->transformer, centerOfProjection);
+    instance->orientation = Mat4Determinant(&thing->transformer->matrix) < 0 ? -1 : 1;
+    // the sphere subtends radius / sqrt(distance^2 - radius^2) in tangent, a level drawn at its error relative to the radius is off by that fraction of the projected radius
+    const Real distance = VectorEuclideanDistance(center, centerOfProjection);
+    if (scene->lodThreshold > 0 && polygon->lod != NULL && distance > radius) {
+      const Real projectedRadius = focalLength * radius / SQRT(distance * distance - radius * radius);
+      instance->polygon = PolygonSelectLOD(polygon, scene->lodThreshold * polygon->boundingRadius / projectedRadius);
+    }
+  }
+  free(visibleThings);
 
-    Color diffuse = VectorScalarMultiplication(light->diffuse, fmaxl(thing->material->diffuse * corr, 0));
-    Color specular =
-        VectorScalarMultiplication(light->specular, thing->material->specular * fmaxl(powl(VectorDotProduct(R_m, CameraGetDirection(scene->camera, surfacePosition)), thing->material->shininess), 0));
+  uint64_t visibleTotal = 0, maxTriangles = 0, maxVertexes = 0, maxSmallTriangles = 0, maxSmallVertexes = 0;
+  int64_t small = 0;
+  for (int64_t thingIndex = 0; thingIndex < thingCount; ++thingIndex) {
+    SceneInstance *instance = &instances[thingIndex];
+    const Polygon *polygon = instance->polygon;
+    instance->offset = visibleTotal;
+    if (!instance->visible) {
+      ++statistics->thingsCulled;
+      statistics->trianglesFrustumCulled += polygon->triangle;
+      continue;
+    }
+    statistics->trianglesSimplified += scene->things[thingIndex]->polygon->triangle - polygon->triangle;
+    visibleTotal += polygon->triangle;
+    if (polygon->triangle < SCENE_INSTANCE_TRIANGLES) {
+      ++small;
+      maxSmallTriangles = polygon->triangle > maxSmallTriangles ? polygon->triangle : maxSmallTriangles;
+      maxSmallVertexes = polygon->vertex > maxSmallVertexes ? polygon->vertex : maxSmallVertexes;
+    } else {
+      maxTriangles = polygon->triangle > maxTriangles ? polygon->triangle : maxTriangles;
+      maxVertexes = polygon->vertex > maxVertexes ? polygon->vertex : maxVertexes;
+    }
+  }
+  instances[thingCount].offset = visibleTotal;
+  RenderTriangle *triangles = (RenderTriangle *)calloc(visibleTotal > 0 ? visibleTotal : 1, sizeof(RenderTriangle));
+  uint8_t *extraPieces = (uint8_t *)calloc(visibleTotal > 0 ? visibleTotal : 1, sizeof(uint8_t));
 
-    illumination = VectorAddition(illumination, VectorAddition(diffuse, specular));
+  // large things, one at a time
+  GeometryScratch scratch;
+  _GeometryScratchCreate(&scratch, maxTriangles, maxVertexes);
+  for (int64_t thingIndex = 0; thingIndex < thingCount; ++thingIndex) {
+    const SceneInstance *instance = &instances[thingIndex];
+    if (instance->visible && instance->polygon->triangle >= SCENE_INSTANCE_TRIANGLES) {
+      _SceneThingGeometry(scene, bitmap, shadingType, reflectionModelType, scene->things[thingIndex], instance, true, &scratch, &triangles[instance->offset],
+                          &extraPieces[instance->offset], statistics);
+    }
   }
+  _GeometryScratchDestroy(&scratch);
 
-  illumination = VectorConfine(illumination, 0, 1); // limit range [0-1]
+  // small things, one per thread
+#ifdef _OPENMP
+#pragma omp parallel if (small > 1)
+#endif
+  {
+    GeometryScratch localScratch;
+    RenderStatistics localStatistics = {0};
+    _GeometryScratchCreate(&localScratch, maxSmallTriangles, maxSmallVertexes);
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic, 16)
+#endif
+    for (int64_t thingIndex = 0; thingIndex < thingCount; ++thingIndex) {
+      const SceneInstance *instance = &instances[thingIndex];
+      if (instance->visible && instance->polygon->triangle < SCENE_INSTANCE_TRIANGLES) {
+        _SceneThingGeometry(scene, bitmap, shadingType, reflectionModelType, scene->things[thingIndex], instance, false, &localScratch, &triangles[instance->offset],
+                            &extraPieces[instance->offset], &localStatistics);
+      }
+    }
+    _GeometryScratchDestroy(&localScratch);
+#ifdef _OPENMP
+#pragma omp critical
+#endif
+    {
+      statistics->trianglesFrustumCulled += localStatistics.trianglesFrustumCulled;
+      statistics->trianglesBackfaceCulled += localStatistics.trianglesBackfaceCulled;
+      statistics->trianglesSplit += localStatistics.trianglesSplit;
+      statistics->trianglesRasterized += localStatistics.trianglesRasterized;
+      statistics->vertexesShaded += localStatistics.vertexesShaded;
+    }
+  }
 
-  return V(illumination.x * thing->material->color.x, illumination.y * thing->material->color.y, illumination.z * thing->material->color.z);
+  // pieces beyond the first are rare (triangles crossing the near plane or the guard band), so they are clipped again instead of being kept aside
+  uint64_t extraTotal = 0;
+  for (uint64_t triangleIndex = 0; triangleIndex < visibleTotal; ++triangleIndex) {
+    extraTotal += extraPieces[triangleIndex];
+  }
+  if (extraTotal > 0) {
+    triangles = (RenderTriangle *)realloc(triangles, sizeof(RenderTriangle) * (visibleTotal + extraTotal));
+    memset(&triangles[visibleTotal], 0, sizeof(RenderTriangle) * extraTotal);
+    uint64_t next = visibleTotal;
+    for (int64_t thingIndex = 0; thingIndex < thingCount; ++thingIndex) {
+      const Thing *thing = scene->things[thingIndex];
+      const SceneInstance *instance = &instances[thingIndex];
+      for (uint64_t triangleIndex = 0; instance->visible && triangleIndex < instance->polygon->triangle; ++triangleIndex) {
+        if (extraPieces[instance->offset + triangleIndex] == 0) {
+          continue;
+        }
+        Triangle triangleWorld = TransformerTransformTriangle(thing->transformer, PolygonGetTriangle(instance->polygon, triangleIndex));
+        Triangle pieces[RASTERIZER_CLIP_TRIANGLES];
+        const uint32_t pieceCount = RasterizerClipTriangle(scene->camera, triangleWorld, pieces);
+        for (uint32_t pieceIndex = 1; pieceIndex < pieceCount; ++pieceIndex) {
+          statistics->trianglesRasterized += _SceneSetupPiece(scene, bitmap, shadingType, reflectionModelType, thing, &triangleWorld, &pieces[pieceIndex], &triangles[next++]);
+          statistics->vertexesShaded += 3;
+        }
+      }
+    }
+  }
+  free(extraPieces);
+
+  *count = visibleTotal + extraTotal;
+  return triangles;
 }
 
-Color _BlinnPhongReflectionModel(const Scene *scene, const Thing *thing, const Vector surfacePosition, const Vector normal) {
-  Color illumination = VectorScalarMultiplication(V(0.1, 0.1, 0.1), thing->material->ambient);
-  for (uint64_t lightIndex = 0; lightIndex < scene->light; ++lightIndex) {
-    const Light *light = scene->lights[lightIndex];
+/**
+ * Find the run of triangles of one thing starting at first (triangles which are not visible belong to any run) and the screen box and nearest depth of its visible triangles.
+ * @return false if no triangle of the run is visible
+ */
+bool _SceneThingBounds(const RenderTriangle *triangles, uint64_t count, uint64_t first, uint64_t *last, TriangleEdges *bounds) {
+  const Thing *thing = NULL;
+  uint64_t index = first;
+  for (; index < count; ++index) {
+    const RenderTriangle *renderTriangle = &triangles[index];
+    if (!renderTriangle->visible) {
+      continue;
+    }
+    const TriangleEdges *edges = &renderTriangle->edges;
+    if (thing == NULL) {
+      thing = renderTriangle->thing;
+      *bounds = *edges;
+    } else if (renderTriangle->thing != thing) {
+      break;
+    }
+    bounds->minX = bounds->minX < edges->minX ? bounds->minX : edges->minX;
+    bounds->minY = bounds->minY < edges->minY ? bounds->minY : edges->minY;
+    bounds->maxX = bounds->maxX > edges->maxX ? bounds->maxX : edges->maxX;
+    bounds->maxY = bounds->maxY > edges->maxY ? bounds->maxY : edges->maxY;
+    bounds->nearestDepth = FMIN(bounds->nearestDepth, edges->nearestDepth);
+  }
+  *last = index;
+  return thing != NULL;
+}
 
-    const Real corr = fmaxl(VectorDotProduct(LightGetDirection(*light, surfacePosition), normal), 0); // negative value must be ignored
-    const Vector H = VectorL2Normalization(VectorAddition(LightGetDirection(*light, surfacePosition), CameraGetDirection(scene->camera, surfacePosition)));
+/*
+ * Screen box of the visible triangles below a BVH node, for hierarchical occlusion culling
+ */
+typedef struct tagNodeBounds {
+  uint32_t minX, minY, maxX, maxY;
+  Real nearestDepth;
+  uint64_t visible; // visible triangles below the node, the box is empty if 0
+} NodeBounds;
+
+/**
+ * Mark the triangles of the BVH nodes hidden by the hierarchical z.
+ * Node boxes are merged bottom-up from the screen boxes of the visible triangles (children are stored after their parent), then tested top-down.
+ * @param triangles render triangles of the polygon, in the order of its triangles
+ * @return number of visible triangles hidden
+ */
+uint64_t _SceneOccludeBVH(const ZBuffer *zbuffer, const BVH *bvh, const RenderTriangle *triangles, NodeBounds *bounds, uint8_t *hidden) {
+  memset(hidden, 0, bvh->primitive);
+  for (int64_t nodeIndex = (int64_t)bvh->node - 1; nodeIndex >= 0 && bvh->primitive > 0; --nodeIndex) {
+    const BVHNode *node = &bvh->nodes[nodeIndex];
+    NodeBounds *nodeBounds = &bounds[nodeIndex];
+    *nodeBounds = (NodeBounds){UINT32_MAX, UINT32_MAX, 0, 0, REAL_MAX, 0};
+    const uint32_t childCount = node->count > 0 ? node->count : 2;
+    for (uint32_t i = 0; i < childCount; ++i) {
+      NodeBounds child;
+      if (node->count > 0) {
+        const RenderTriangle *renderTriangle = &triangles[bvh->primitives[node->first + i]];
+        if (!renderTriangle->visible) {
+          continue;
+        }
+        const TriangleEdges *edges = &renderTriangle->edges;
+        child = (NodeBounds){edges->minX, edges->minY, edges->maxX, edges->maxY, edges->nearestDepth, 1};
+      } else {
+        child = bounds[node->first + i];
+        if (child.visible == 0) {
+          continue;
+        }
+      }
+      nodeBounds->minX = nodeBounds->minX < child.minX ? nodeBounds->minX : child.minX;
+      nodeBounds->minY = nodeBounds->minY < child.minY ? nodeBounds->minY : child.minY;
+      nodeBounds->maxX = nodeBounds->maxX > child.maxX ? nodeBounds->maxX : child.maxX;
+      nodeBounds->maxY = nodeBounds->maxY > child.maxY ? nodeBounds->maxY : child.maxY;
+      nodeBounds->nearestDepth = FMIN(nodeBounds->nearestDepth, child.nearestDepth);
+      nodeBounds->visible += child.visible;
+    }
+  }
 
-    Color diffuse = VectorScalarMultiplication(light->diffuse, fmaxl(thing->material->diffuse * corr, 0));
-    Color specular = VectorScalarMultiplication(light->specular, thing->material->specular * fmaxl(powl(VectorDotProduct(normal, H), thing->material->shininess), 0));
+  uint64_t occluded = 0;
+  uint32_t stack[BVH_STACK_SIZE], stackSize = 0;
+  stack[stackSize++] = 0;
+  while (stackSize > 0 && bvh->primitive > 0) {
+    const uint32_t nodeIndex = stack[--stackSize];
+    const NodeBounds *nodeBounds = &bounds[nodeIndex];
+    if (nodeBounds->visible == 0) {
+      continue;
+    }
+    if (ZBufferBoxOccluded(zbuffer, nodeBounds->minX, nodeBounds->minY, nodeBounds->maxX, nodeBounds->maxY, nodeBounds->nearestDepth)) {
+      uint32_t first, count;
+      BVHNodePrimitives(bvh, nodeIndex, &first, &count);
+      for (uint32_t i = first; i < first + count; ++i) {
+        hidden[bvh->primitives[i]] = 1;
+      }
+      occluded += nodeBounds->visible;
+    } else if (bvh->nodes[nodeIndex].count == 0) {
+      stack[stackSize++] = bvh->nodes[nodeIndex].first + 1;
+      stack[stackSize++] = bvh->nodes[nodeIndex].first;
+    }
+  }
+  return occluded;
+}
 
-    illumination = VectorAddition(illumination, VectorAddition(diffuse, specular));
+/**
+ * Draw the triangles [first, last) of one thing, skipping the thing if the hierarchical z (refreshed over its box) hides it as a whole, and the BVH nodes it hides if bvh is given.
+ * drawTriangle NULL runs the depth-only pass.
+ */
+void _SceneDrawRange(const Scene *scene, Bitmap *bitmap, ZBuffer *zbuffer, const RenderTriangle *triangles, uint64_t first, uint64_t last, const BVH *bvh, NodeBounds *nodeBounds,
+                     uint8_t *hidden, DepthTestType depthTest, DrawTriangleFunction drawTriangle, RenderStatistics *statistics) {
+  TriangleEdges bounds;
+  uint64_t end;
+  if (!_SceneThingBounds(triangles, last, first, &end, &bounds)) {
+    return;
+  }
+  if (zbuffer != NULL) {
+    ZBufferUpdateHierarchy(zbuffer, bounds.minX, bounds.minY, bounds.maxX, bounds.maxY);
+    if (ZBufferBoxOccluded(zbuffer, bounds.minX, bounds.minY, bounds.maxX, bounds.maxY, bounds.nearestDepth)) {
+      if (drawTriangle != NULL) {
+        ++statistics->thingsOccluded;
+      }
+      return;
+    }
+    if (bvh != NULL) {
+      const uint64_t occluded = _SceneOccludeBVH(zbuffer, bvh, &triangles[first], nodeBounds, hidden);
+      if (drawTriangle != NULL) {
+        statistics->trianglesOccluded += occluded;
+      }
+    }
+  }
+  for (uint64_t triangleIndex = first; triangleIndex < last; ++triangleIndex) {
+    if (!triangles[triangleIndex].visible || (bvh != NULL && zbuffer != NULL && hidden[triangleIndex - first])) {
+      continue;
+    }
+    if (drawTriangle == NULL) {
+      _DrawTriangleDepthOnly(zbuffer, &triangles[triangleIndex].edges);
+    } else {
+      statistics->fragmentsShaded += drawTriangle(bitmap, zbuffer, depthTest, scene, &triangles[triangleIndex], &triangles[triangleIndex].edges);
+    }
   }
+}
 
-  illumination = VectorConfine(illumination, 0, 1); // limit range [0 - 1]
+/**
+ * Draw triangles thing by thing in scene order, then the extra pieces of clipped triangles in runs of one thing (see _SceneGeometry).
+ * Things and BVH nodes hidden by the hierarchical z are skipped; the hierarchy only sees the things drawn before, so the image does not change.
+ * drawTriangle NULL runs the depth-only pass.
+ */
+void _SceneDrawThings(const Scene *scene, Bitmap *bitmap, ZBuffer *zbuffer, const RenderTriangle *triangles, const SceneInstance *instances, uint64_t count, DepthTestType depthTest,
+                      DrawTriangleFunction drawTriangle, RenderStatistics *statistics) {
+  uint64_t maxTriangles = 0, maxNodes = 0;
+  for (uint64_t thingIndex = 0; thingIndex < scene->thing; ++thingIndex) {
+    const Polygon *polygon = instances[thingIndex].polygon;
+    if (polygon->bvh != NULL && polygon->bvh->primitive == polygon->triangle) {
+      maxTriangles = polygon->triangle > maxTriangles ? polygon->triangle : maxTriangles;
+      maxNodes = polygon->bvh->node > maxNodes ? polygon->bvh->node : maxNodes;
+    }
+  }
+  uint8_t *hidden = (uint8_t *)malloc(maxTriangles > 0 ? maxTriangles : 1);
+  NodeBounds *nodeBounds = (NodeBounds *)malloc((maxNodes > 0 ? maxNodes : 1) * sizeof(NodeBounds));
 
-  return V(illumination.x * thing->material->color.x, illumination.y * thing->material->color.y, illumination.z * thing->material->color.z);
+  for (uint64_t thingIndex = 0; thingIndex < scene->thing; ++thingIndex) {
+    const Polygon *polygon = instances[thingIndex].polygon;
+    const BVH *bvh = polygon->bvh != NULL && polygon->bvh->primitive == polygon->triangle ? polygon->bvh : NULL;
+    _SceneDrawRange(scene, bitmap, zbuffer, triangles, instances[thingIndex].offset, instances[thingIndex + 1].offset, bvh, nodeBounds, hidden, depthTest, drawTriangle, statistics);
+  }
+  uint64_t first = instances[scene->thing].offset, last;
+  for (; first < count; first = last) {
+    TriangleEdges bounds;
+    if (!_SceneThingBounds(triangles, count, first, &last, &bounds)) {
+      continue;
+    }
+    _SceneDrawRange(scene, bitmap, zbuffer, triangles, first, last, NULL, nodeBounds, hidden, depthTest, drawTriangle, statistics);
+  }
+  free(nodeBounds);
+  free(hidden);
 }
 
-Color _NullReflectionModel(const Scene *scene, const Thing *thing, const Vector surfacePosition, const Vector normal) {
-  UNUSED(scene);
-  UNUSED(surfacePosition);
-  UNUSED(normal);
-  return thing->material->color;
+bool _SceneRasterizeSerial(const Scene *scene, Bitmap *bitmap, ZBuffer *zbuffer, const RenderTriangle *triangles, const SceneInstance *instances, uint64_t count, ShadingType shadingType,
+                           ReflectionModelType reflectionModelType, RenderStatistics *statistics) {
+  const bool depthPrepass = scene->depthPrepass && zbuffer != NULL;
+  if (depthPrepass) {
+    _SceneDrawThings(scene, bitmap, zbuffer, triangles, instances, count, LessEqualDepthTest, NULL, statistics);
+  }
+  _SceneDrawThings(scene, bitmap, zbuffer, triangles, instances, count, depthPrepass ? EqualDepthTest : LessEqualDepthTest, _drawTriangles[shadingType][reflectionModelType], statistics);
+  return true;
+}
+
+/**
+ * Bin triangles into RENDER_TILE_SIZE x RENDER_TILE_SIZE screen tiles and rasterize the tiles in parallel.
+ * Each tile only writes its own pixels and draws its triangles in scene order, so the output is identical to the serial backend.
+ */
+bool _SceneRasterizeTiled(const Scene *scene, Bitmap *bitmap, ZBuffer *zbuffer, const RenderTriangle *triangles, uint64_t count, ShadingType shadingType,
+                          ReflectionModelType reflectionModelType, RenderStatistics *statistics) {
+  const DrawTriangleFunction drawTriangle = _drawTriangles[shadingType][reflectionModelType];
+  const bool depthPrepass = scene->depthPrepass && zbuffer != NULL;
+  const DepthTestType depthTest = depthPrepass ? EqualDepthTest : LessEqualDepthTest;
+  const uint32_t width = bitmap->dibHeader.bcWidth, height = bitmap->dibHeader.bcHeight;
+  const uint32_t tilesX = (width + RENDER_TILE_SIZE - 1) / RENDER_TILE_SIZE, tilesY = (height + RENDER_TILE_SIZE - 1) / RENDER_TILE_SIZE;
+  const int64_t tileCount = (int64_t)tilesX * tilesY;
+
+  // count triangles per tile, then fill the bins in scene order
+  uint64_t *binOffsets = (uint64_t *)calloc(tileCount + 1, sizeof(uint64_t));
+  for (uint64_t triangleIndex = 0; triangleIndex < count; ++triangleIndex) {
+    const TriangleEdges *edges = &triangles[triangleIndex].edges;
+    if (!triangles[triangleIndex].visible) {
+      continue;
+    }
+    for (uint32_t tileY = edges->minY / RENDER_TILE_SIZE; tileY <= edges->maxY / RENDER_TILE_SIZE; ++tileY) {
+      for (uint32_t tileX = edges->minX / RENDER_TILE_SIZE; tileX <= edges->maxX / RENDER_TILE_SIZE; ++tileX) {
+        ++binOffsets[tileX + tilesX * tileY + 1];
+      }
+    }
+  }
+  for (int64_t tile = 0; tile < tileCount; ++tile) {
+    binOffsets[tile + 1] += binOffsets[tile];
+  }
+  uint64_t *bins = (uint64_t *)calloc(binOffsets[tileCount] > 0 ? binOffsets[tileCount] : 1, sizeof(uint64_t));
+  uint64_t *binSizes = (uint64_t *)calloc(tileCount, sizeof(uint64_t));
+  for (uint64_t triangleIndex = 0; triangleIndex < count; ++triangleIndex) {
+    const TriangleEdges *edges = &triangles[triangleIndex].edges;
+    if (!triangles[triangleIndex].visible) {
+      continue;
+    }
+    for (uint32_t tileY = edges->minY / RENDER_TILE_SIZE; tileY <= edges->maxY / RENDER_TILE_SIZE; ++tileY) {
+      for (uint32_t tileX = edges->minX / RENDER_TILE_SIZE; tileX <= edges->maxX / RENDER_TILE_SIZE; ++tileX) {
+        const uint32_t tile = tileX + tilesX * tileY;
+        bins[binOffsets[tile] + binSizes[tile]++] = triangleIndex;
+      }
+    }
+  }
+
+  // with a depth prepass, each tile runs both passes while its z-buffer rows are in cache
+  uint64_t fragmentsShaded = 0;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic) reduction(+ : fragmentsShaded)
+#endif
+  for (int64_t tile = 0; tile < tileCount; ++tile) {
+    const uint32_t minX = (uint32_t)(tile % tilesX) * RENDER_TILE_SIZE, minY = (uint32_t)(tile / tilesX) * RENDER_TILE_SIZE;
+    const uint32_t maxX = minX + RENDER_TILE_SIZE - 1, maxY = minY + RENDER_TILE_SIZE - 1;
+    if (depthPrepass) {
+      for (uint64_t binIndex = binOffsets[tile]; binIndex < binOffsets[tile + 1]; ++binIndex) {
+        TriangleEdges edges = triangles[bins[binIndex]].edges;
+        if (TriangleEdgesClip(&edges, minX, minY, maxX, maxY)) {
+          _DrawTriangleDepthOnly(zbuffer, &edges);
+        }
+      }
+    }
+    for (uint64_t binIndex = binOffsets[tile]; binIndex < binOffsets[tile + 1]; ++binIndex) {
+      const RenderTriangle *renderTriangle = &triangles[bins[binIndex]];
+      TriangleEdges edges = renderTriangle->edges;
+      if (TriangleEdgesClip(&edges, minX, minY, maxX, maxY)) {
+        fragmentsShaded += drawTriangle(bitmap, zbuffer, depthTest, scene, renderTriangle, &edges);
+      }
+    }
+  }
+  statistics->fragmentsShaded += fragmentsShaded;
+
+  free(binSizes);
+  free(bins);
+  free(binOffsets);
+  return true;
+}
+
+bool _SceneRenderWorld(const Scene *scene, Bitmap *bitmap, ZBuffer *zbuffer, ShadingType shadingType, ReflectionModelType reflectionModelType) {
+  uint64_t count;
+  SceneInstance *instances;
+  RenderStatistics statistics;
+  RenderTriangle *triangles = _SceneGeometry(scene, bitmap, shadingType, reflectionModelType, &instances, &count, &statistics);
+  bool result;
+  switch (scene->backend) {
+  case SerialRenderBackend:
+    result = _SceneRasterizeSerial(scene, bitmap, zbuffer, triangles, instances, count, shadingType, reflectionModelType, &statistics);
+    break;
+  case TiledRenderBackend:
+    result = _SceneRasterizeTiled(scene, bitmap, zbuffer, triangles, count, shadingType, reflectionModelType, &statistics);
+    break;
+  default:
+    fprintf(stderr, "%s: Unknown render backend.\n", __FUNCTION_NAME__);
+    result = false;
+    break;
+  }
+  free(instances);
+  free(triangles);
+  if (scene->statistics != NULL) {
+    *scene->statistics = statistics;
+  }
+  return result;
 }
 
 bool SceneRender(const Scene *scene, Bitmap *bitmap, ZBuffer *zbuffer, RenderType renderType, ShadingType shadingType, ReflectionModelType reflectionModelType) {
-  void *reflectionFunc = NULL;
   switch (reflectionModelType) {
   case NullReflectionModel:
-    reflectionFunc = _NullReflectionModel;
-    break;
   case PhongReflectionModel:
-    reflectionFunc = _PhongReflectionModel;
-    break;
   case BlinnPhongReflectionModel:
-    reflectionFunc = _BlinnPhongReflectionModel;
     break;
   default:
     fprintf(stderr, "%s: Unknown reflection model type.\n", __FUNCTION_NAME__);
@@ -355,13 +1207,11 @@ bool SceneRender(const Scene *scene, Bitmap *bitmap, ZBuffer *zbuffer, RenderTyp
   case WorldRender:
     switch (shadingType) {
     case NullShading:
-      return _SceneRenderFlat(scene, bitmap, zbuffer, _NullReflectionModel);
+      return _SceneRenderWorld(scene, bitmap, zbuffer, shadingType, NullReflectionModel);
     case FlatShading:
-      return _SceneRenderFlat(scene, bitmap, zbuffer, reflectionFunc);
     case GouraudShading:
-      return _SceneRenderGouraud(scene, bitmap, zbuffer, reflectionFunc);
     case PhongShading:
-      return _SceneRenderPhong(scene, bitmap, zbuffer, reflectionFunc);
+      return _SceneRenderWorld(scene, bitmap, zbuffer, shadingType, reflectionModelType);
     default:
       fprintf(stderr, "%s: Unknown shading type.\n", __FUNCTION_NAME__);
       return false;
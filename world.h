@@ -13,6 +13,9 @@ typedef enum { PointLight, DirectionalLight } LightType;
 typedef enum { NullReflectionModel, PhongReflectionModel, BlinnPhongReflectionModel } ReflectionModelType;
 typedef enum { NullShading, FlatShading, GouraudShading, PhongShading } ShadingType;
 typedef enum { WireframeRender, WireframeNormalsRender, WorldRender } RenderType;
+typedef enum { SerialRenderBackend, TiledRenderBackend } RenderBackendType;
+
+#define RENDER_TILE_SIZE 64 // [Tiled backend] tile width and height in pixels, a multiple of RASTERIZER_BLOCK_SIZE
 
 typedef struct tagLight {
   LightType type;
@@ -28,6 +31,7 @@ typedef struct tagMaterial {
   Real diffuse;   // k_d which is a diffuse reflection constant, the ratio of reflection of the diffuse term of incoming light (Lambertian reflectance)
   Real ambient;   // k_a which is an ambient reflection constant, the ratio of reflection of the ambient term present in all points in the scene rendered
   Real shininess; // alpha: which is a shininess constant for this material, which is larger for surfaces that are smoother and more mirror-like.
+  bool doubleSided; // draw back faces too, for open or inside-out meshes (back-face culling is applied when false)
 } Material;
 
 typedef struct tagThing {
@@ -36,14 +40,42 @@ typedef struct tagThing {
   Transformer *transformer;
 } Thing;
 
+typedef struct tagRenderStatistics {
+  uint64_t things;                  // things in the scene
+  uint64_t thingsCulled;            // things whose bounding sphere is outside the view frustum
+  uint64_t triangles;               // triangles in the scene
+  uint64_t trianglesSimplified;     // triangles of the things in view left out by drawing coarser levels of detail (SceneSetLODThreshold)
+  uint64_t trianglesFrustumCulled;  // triangles of culled things and of BVH nodes outside the view frustum
+  uint64_t trianglesBackfaceCulled; // triangles facing away from the camera
+  uint64_t trianglesSplit;          // triangles split into several pieces by near plane or guard band clipping
+  uint64_t trianglesRasterized;     // triangles and pieces set up for rasterization (the rest are clipped away, degenerate or off screen)
+  uint64_t vertexesShaded;          // vertexes transformed, projected and lit: once per unique vertex with the vertex cache, 3 per triangle or piece otherwise
+  uint64_t thingsOccluded;          // [Serial backend] things hidden as a whole by the hierarchical z
+  uint64_t trianglesOccluded;       // [Serial backend] visible triangles of BVH nodes hidden by the hierarchical z, in things drawn
+  uint64_t fragmentsShaded;         // pixels shaded, overdraw included (divide by the covered pixels for the overdraw factor)
+} RenderStatistics;
+
 typedef struct tagScene {
   Camera *camera;
   uint64_t thing; // number of things
   Thing **things;
   uint64_t light; // numbre of lights
   Light **lights;
+  RenderBackendType backend;    // how WorldRender rasterizes, serial by default
+  bool depthPrepass;            // [WorldRender] rasterize the depth of every triangle first, then shade only the visible fragments
+  RenderStatistics *statistics; // [optional] filled by every WorldRender
+  Real lodThreshold;            // [WorldRender] largest error in pixels of the levels of detail drawn (PolygonBuildLOD), 0 draws the full polygons
+  BVH *bvh;                     // [SceneBuildBVH] BVH of the things in world space
+  Mat4 *bvhMatrices;            // [SceneBuildBVH] transformation matrix of every thing in the BVH, things moved since are tested by their bounding sphere
 } Scene;
 
+typedef struct tagSceneHit {
+  uint64_t thingIndex;
+  uint64_t triangleIndex; // in the polygon of the thing
+  Real distance;          // along the ray direction, in its length
+  Vector position;        // world space
+} SceneHit;
+
 Light LightCreatePointLight(Color specular, Color diffuse, Vector position);
 Light LightCreateDirectionalLight(Color specular, Color diffuse, Vector direction);
 
@@ -56,8 +88,15 @@ bool ThingDestroy(Thing *thing);
 Scene *SceneCreateEmpty();
 bool SceneDestroy(Scene *scene);
 bool SceneSetCamera(Scene *scene, Camera *camera);
+bool SceneSetRenderBackend(Scene *scene, RenderBackendType backend);
+bool SceneSetDepthPrepass(Scene *scene, bool depthPrepass);
+bool SceneSetStatistics(Scene *scene, RenderStatistics *statistics);
+bool SceneSetLODThreshold(Scene *scene, Real pixels);
 bool SceneAppendThing(Scene *scene, Thing *thing);
 bool SceneAppendLight(Scene *scene, Light *light);
+bool SceneBuildBVH(Scene *scene);
+bool SceneRaycast(const Scene *scene, Vector origin, Vector direction, SceneHit *hit);
+bool ScenePick(const Scene *scene, uint32_t x, uint32_t y, SceneHit *hit);
 bool SceneRender(const Scene *scene, Bitmap *bitmap, ZBuffer *zbuffer, RenderType renderType, ShadingType shadingType, ReflectionModelType reflectionModelType);
 
 #endif // RENDER_WORLD_H